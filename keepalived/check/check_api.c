@@ -25,6 +25,7 @@
 #include <dlfcn.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include <arpa/inet.h>
 
 #include "check_api.h"
@@ -53,6 +54,7 @@
 #endif
 #include "track_file.h"
 #include "check_parser.h"
+#include "timer.h"
 
 
 /* Global vars */
@@ -61,14 +63,70 @@ bool do_checker_debug;
 #endif
 checker_t *current_checker;
 
+/* checker_max_in_flight - checks running, and checkers waiting to start */
+static unsigned checks_in_flight;
+static LIST_HEAD_INITIALIZE(checks_waiting);
+static unsigned checks_waiting_num;
+static unsigned checks_in_flight_peak;
+static unsigned checks_waiting_peak;
+static uint64_t checks_waited;
+static uint64_t checks_wait_total;	/* usecs */
+static unsigned long checks_wait_max;
+
+/* TCP connections made by checkers, by how they are closed */
+static uint64_t tcp_conns_rst;
+static uint64_t tcp_conns_fin;
+
 /* free checker data */
 void
 free_checker(checker_t *checker)
 {
 	list_del_init(&checker->rs_list);
+	FREE_PTR(checker->latency);
 	(*checker->checker_funcs->free_func) (checker);
 }
 
+static const char *checker_latency_names[CHECKER_LATENCY_PHASES] = {
+	[CHECKER_LATENCY_CONNECT] = "Connect",
+	[CHECKER_LATENCY_TLS] = "TLS handshake",
+	[CHECKER_LATENCY_FIRST_BYTE] = "First byte",
+	[CHECKER_LATENCY_TOTAL] = "Total",
+};
+
+static void
+dump_checker_latency(FILE *fp, const checker_t *checker)
+{
+	const checker_latency_t *lat;
+	char buf[512];
+	size_t len;
+	unsigned i, phase;
+
+	for (phase = 0; phase < CHECKER_LATENCY_PHASES; phase++) {
+		lat = &checker->latency[phase];
+		if (!lat->count)
+			continue;
+
+		conf_write(fp, "   %s latency: samples %" PRIu64 ", p50 %lu us, p90 %lu us, p99 %lu us, max %lu us",
+				checker_latency_names[phase], lat->count,
+				checker_latency_percentile(checker, phase, 50, false),
+				checker_latency_percentile(checker, phase, 90, false),
+				checker_latency_percentile(checker, phase, 99, false),
+				lat->max);
+
+		for (i = 0, len = 0; i < CHECKER_LATENCY_BUCKETS && len < sizeof(buf); i++) {
+			if (!lat->hist[i])
+				continue;
+			if (i == CHECKER_LATENCY_BUCKETS - 1)
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " >=%lu:%" PRIu64,
+						1UL << (CHECKER_LATENCY_MIN_SHIFT + i - 1), lat->hist[i]);
+			else
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " <%lu:%" PRIu64,
+						1UL << (CHECKER_LATENCY_MIN_SHIFT + i), lat->hist[i]);
+		}
+		conf_write(fp, "     Buckets (us):%s", buf);
+	}
+}
+
 /* dump checker data */
 static void
 dump_checker(FILE *fp, const checker_t *checker)
@@ -91,6 +149,11 @@ dump_checker(FILE *fp, const checker_t *checker)
 	}
 	conf_write(fp, "   Log all failures = %s", checker->log_all_failures ? "yes" : "no");
 
+	if (checker->dup_of)
+		conf_write(fp, "   Shares result of %s for VS %s", FMT_CHK(checker->dup_of), FMT_VS(checker->dup_of->vs));
+	else if (checker->latency)
+		dump_checker_latency(fp, checker);
+
 	if (checker->co) {
 		conf_write(fp, "   Connection");
 		dump_connection_opts(fp, checker->co);
@@ -114,6 +177,8 @@ dump_connection_opts(FILE *fp, const void *data)
 		conf_write(fp, "     Mark = %u", conn->fwmark);
 #endif
 	conf_write(fp, "     Timeout = %f", (double)conn->connection_to / TIMER_HZ);
+	if (conn->close_rst > 0)
+		conf_write(fp, "     Close with RST");
 	if (conn->last_errno)
 		conf_write(fp, "     Last errno = %d", conn->last_errno);
 }
@@ -132,10 +197,14 @@ queue_checker(const checker_funcs_t *funcs
 	if (co) {
 		co->dst = current_rs->addr;
 		co->connection_to = UINT_MAX;
+		co->close_rst = -1;
 	}
 
 	PMALLOC(checker);
 	INIT_LIST_HEAD(&checker->rs_list);
+	INIT_LIST_HEAD(&checker->dups);
+	INIT_LIST_HEAD(&checker->dup_list);
+	INIT_LIST_HEAD(&checker->wait_list);
 	checker->checker_funcs = funcs;
 	checker->launch = launch;
 	checker->vs = current_vs;
@@ -202,6 +271,8 @@ compare_conn_opts(const conn_opts_t *a, const conn_opts_t *b)
 		return false;
 	if (a->connection_to != b->connection_to)
 		return false;
+	if (a->close_rst != b->close_rst)
+		return false;
 #ifdef _WITH_SO_MARK_
 	if (a->fwmark != b->fwmark)
 		return false;
@@ -315,6 +386,23 @@ co_timeout_handler(const vector_t *strvec)
 	co->connection_to = timer;
 }
 
+/* "close_rst" keyword */
+static void
+co_close_rst_handler(const vector_t *strvec)
+{
+	conn_opts_t *co = current_checker->co;
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec, 1));
+		if (res == -1) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid close_rst parameter %s", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+	co->close_rst = res;
+}
+
 #ifdef _WITH_SO_MARK_
 /* "fwmark" keyword */
 static void
@@ -428,6 +516,7 @@ install_checker_common_keywords(bool connection_keywords)
 		install_keyword("bind_port", &co_srcport_handler);
 		install_keyword("bind_if", &co_srcif_handler);
 		install_keyword("connect_timeout", &co_timeout_handler);
+		install_keyword("close_rst", &co_close_rst_handler);
 #ifdef _WITH_SO_MARK_
 		install_keyword("fwmark", &co_fwmark_handler);
 #endif
@@ -461,6 +550,21 @@ dump_checkers(FILE *fp)
 			}
 		}
 	}
+
+	if (check_data->num_dup_checkers)
+		conf_write(fp, " Deduplicated checkers = %u", check_data->num_dup_checkers);
+
+	if (tcp_conns_rst || tcp_conns_fin)
+		conf_write(fp, " TCP connections closed with RST = %" PRIu64 ", with FIN = %" PRIu64, tcp_conns_rst, tcp_conns_fin);
+
+	if (global_data->checker_max_in_flight) {
+		conf_write(fp, " Checks in flight = %u, peak %u, limit %u", checks_in_flight,
+				checks_in_flight_peak, global_data->checker_max_in_flight);
+		conf_write(fp, " Checks waiting = %u, peak %u", checks_waiting_num, checks_waiting_peak);
+		conf_write(fp, " Checks delayed = %" PRIu64, checks_waited);
+		conf_write(fp, " Mean wait = %s", format_decimal(checks_waited ? checks_wait_total / checks_waited : 0, TIMER_HZ_DIGITS));
+		conf_write(fp, " Max wait = %s", format_decimal(checks_wait_max, TIMER_HZ_DIGITS));
+	}
 }
 
 /* release the checkers for a real server */
@@ -473,6 +577,310 @@ free_rs_checkers(const real_server_t *rs)
 		free_checker(checker);
 }
 
+/* Order checkers by type and destination, and then configuration order */
+typedef struct _dedup_entry {
+	checker_t			*checker;
+	unsigned			order;
+} dedup_entry_t;
+
+static int
+dedup_entry_cmp(const void *a, const void *b)
+{
+	const dedup_entry_t *ea = a, *eb = b;
+	const checker_t *ca = ea->checker, *cb = eb->checker;
+	int res;
+
+	if (ca->checker_funcs->type != cb->checker_funcs->type)
+		return ca->checker_funcs->type < cb->checker_funcs->type ? -1 : 1;
+	/* inet_sockaddrcmp() returns -2 both ways round for different families */
+	if ((res = less_equal_greater_than(ca->co->dst.ss_family, cb->co->dst.ss_family)))
+		return res;
+	if ((res = inet_sockaddrcmp(&ca->co->dst, &cb->co->dst)))
+		return res;
+	if ((res = less_equal_greater_than(inet_sockaddrport(&ca->co->dst), inet_sockaddrport(&cb->co->dst))))
+		return res;
+
+	return less_equal_greater_than(ea->order, eb->order);
+}
+
+static bool
+checker_is_dup(const checker_t *a, checker_t *b)
+{
+	return a->checker_funcs == b->checker_funcs &&
+	       a->enabled == b->enabled &&
+	       a->alpha == b->alpha &&
+	       a->delay_loop == b->delay_loop &&
+	       a->retry == b->retry &&
+	       a->delay_before_retry == b->delay_before_retry &&
+	       a->checker_funcs->same_check(a, b);
+}
+
+/* Checkers with the same destination and parameters under several virtual
+ * servers only run the first one's check, and update_svr_checker_state()
+ * passes its result on to the others. */
+static void
+dedup_checkers(void)
+{
+	virtual_server_t *vs;
+	real_server_t *rs;
+	checker_t *checker, *dup;
+	dedup_entry_t *entries;
+	unsigned num = 0;
+	unsigned i, j;
+
+	check_data->num_dup_checkers = 0;
+
+	list_for_each_entry(vs, &check_data->vs, e_list) {
+		/* ha_suspend enables and disables the checkers of each virtual server separately */
+		if (vs->ha_suspend)
+			continue;
+		list_for_each_entry(rs, &vs->rs, e_list) {
+			list_for_each_entry(checker, &rs->checkers_list, rs_list) {
+				if (checker->launch && checker->co && checker->checker_funcs->same_check)
+					num++;
+			}
+		}
+	}
+
+	if (num < 2)
+		return;
+
+	entries = MALLOC(num * sizeof(*entries));
+	num = 0;
+	list_for_each_entry(vs, &check_data->vs, e_list) {
+		if (vs->ha_suspend)
+			continue;
+		list_for_each_entry(rs, &vs->rs, e_list) {
+			list_for_each_entry(checker, &rs->checkers_list, rs_list) {
+				if (checker->launch && checker->co && checker->checker_funcs->same_check) {
+					entries[num].checker = checker;
+					entries[num].order = num;
+					num++;
+				}
+			}
+		}
+	}
+
+	qsort(entries, num, sizeof(*entries), dedup_entry_cmp);
+
+	for (i = 0; i < num; i++) {
+		checker = entries[i].checker;
+		if (checker->dup_of)
+			continue;
+
+		for (j = i + 1; j < num; j++) {
+			dup = entries[j].checker;
+			if (dup->checker_funcs->type != checker->checker_funcs->type ||
+			    inet_sockaddrcmp(&dup->co->dst, &checker->co->dst) ||
+			    inet_sockaddrport(&dup->co->dst) != inet_sockaddrport(&checker->co->dst))
+				break;
+
+			if (dup->dup_of || !checker_is_dup(checker, dup))
+				continue;
+
+			dup->dup_of = checker;
+			list_add_tail(&dup->dup_list, &checker->dups);
+			check_data->num_dup_checkers++;
+
+			/* A checker added by a reload takes the state of the one already running */
+			if (checker->has_run && (!dup->has_run || dup->is_up != checker->is_up))
+				update_svr_checker_state(checker->is_up, dup);
+		}
+	}
+
+	FREE(entries);
+
+	if (check_data->num_dup_checkers)
+		log_message(LOG_INFO, "%u of %u healthcheckers share the result of an identical checker",
+				check_data->num_dup_checkers, num);
+}
+
+/* Called by a checker's launch thread once it is enabled. If the checker
+ * can't start its check now it is queued, and its launch thread is run
+ * again when another check finishes. Otherwise this is the start time of
+ * the check for the latency measurements. */
+bool
+checker_limit_start(thread_ref_t thread)
+{
+	checker_t *checker = THREAD_ARG(thread);
+
+	if (!global_data->checker_max_in_flight || checker->in_flight) {
+		checker->check_start = time_now;
+		return true;
+	}
+
+	if (checks_in_flight < global_data->checker_max_in_flight) {
+		checker->in_flight = true;
+		if (++checks_in_flight > checks_in_flight_peak)
+			checks_in_flight_peak = checks_in_flight;
+		checker->check_start = time_now;
+		return true;
+	}
+
+	checker->wait_start = time_now;
+	list_add_tail(&checker->wait_list, &checks_waiting);
+	if (++checks_waiting_num > checks_waiting_peak)
+		checks_waiting_peak = checks_waiting_num;
+
+	return false;
+}
+
+/* Called before a checker schedules its next check, and passes its slot on */
+void
+checker_limit_end(checker_t *checker)
+{
+	checker_t *next;
+	unsigned long wait;
+
+	if (!checker->in_flight)
+		return;
+
+	checker->in_flight = false;
+
+	if (list_empty(&checks_waiting)) {
+		checks_in_flight--;
+		return;
+	}
+
+	next = list_first_entry(&checks_waiting, checker_t, wait_list);
+	list_del_init(&next->wait_list);
+	checks_waiting_num--;
+
+	next->in_flight = true;
+	wait = timer_long(time_now) - timer_long(next->wait_start);
+	checks_waited++;
+	checks_wait_total += wait;
+	if (wait > checks_wait_max)
+		checks_wait_max = wait;
+
+	thread_add_timer(master, next->launch, next, 0);
+}
+
+/* The checkers are about to be freed, along with their threads */
+void
+checker_limit_release(void)
+{
+	checks_in_flight = 0;
+	checks_waiting_num = 0;
+	INIT_LIST_HEAD(&checks_waiting);
+}
+
+/* Called when a checker's TCP connection has been established. The
+ * connection will be closed with RST if SO_LINGER was set for close_rst. */
+void
+checker_tcp_connected(const checker_t *checker)
+{
+	if (checker->co->close_rst > 0)
+		tcp_conns_rst++;
+	else
+		tcp_conns_fin++;
+}
+
+/* Record the time from the start of the check to the end of a phase */
+void
+checker_latency_record(checker_t *checker, checker_latency_phase_t phase)
+{
+	checker_latency_t *lat;
+	checker_t *dup;
+	unsigned long usecs;
+	unsigned bucket, i;
+
+	if (!checker->check_start.tv_sec)
+		return;
+
+	if (!checker->latency)
+		checker->latency = MALLOC(CHECKER_LATENCY_PHASES * sizeof(*checker->latency));
+	lat = &checker->latency[phase];
+
+	usecs = timer_long(time_now) - timer_long(checker->check_start);
+	for (bucket = 0; bucket < CHECKER_LATENCY_BUCKETS - 1 && usecs >= 1UL << (CHECKER_LATENCY_MIN_SHIFT + bucket); bucket++);
+
+	lat->count++;
+	lat->hist[bucket]++;
+	if (usecs > lat->max)
+		lat->max = usecs;
+
+	/* Age the recent samples so that the percentiles follow changes */
+	if (lat->recent_count >= CHECKER_LATENCY_RECENT) {
+		lat->recent_count = 0;
+		for (i = 0; i < CHECKER_LATENCY_BUCKETS; i++) {
+			lat->recent[i] /= 2;
+			lat->recent_count += lat->recent[i];
+		}
+	}
+	lat->recent[bucket]++;
+	lat->recent_count++;
+
+	if (phase != CHECKER_LATENCY_TOTAL)
+		return;
+
+	rs_latency_updated(checker->vs, checker->rs);
+	list_for_each_entry(dup, &checker->dups, dup_list)
+		rs_latency_updated(dup->vs, dup->rs);
+}
+
+/* Estimate a percentile, interpolating within its bucket. 0 if no samples. */
+unsigned long __attribute__ ((pure))
+checker_latency_percentile(const checker_t *checker, checker_latency_phase_t phase, unsigned pct, bool recent)
+{
+	const checker_latency_t *lat;
+	uint64_t count, target, cum = 0, n;
+	unsigned long lo, hi;
+	unsigned i;
+
+	if (checker->dup_of)
+		checker = checker->dup_of;
+	if (!checker->latency)
+		return 0;
+
+	lat = &checker->latency[phase];
+	count = recent ? lat->recent_count : lat->count;
+	if (!count)
+		return 0;
+
+	target = (count * pct + 99) / 100;
+	if (!target)
+		target = 1;
+
+	for (i = 0; i < CHECKER_LATENCY_BUCKETS; i++) {
+		n = recent ? lat->recent[i] : lat->hist[i];
+		if (cum + n >= target)
+			break;
+		cum += n;
+	}
+	if (i == CHECKER_LATENCY_BUCKETS)
+		return lat->max;
+
+	lo = i ? 1UL << (CHECKER_LATENCY_MIN_SHIFT + i - 1) : 0;
+	hi = i < CHECKER_LATENCY_BUCKETS - 1 ? 1UL << (CHECKER_LATENCY_MIN_SHIFT + i) : lat->max;
+	if (hi > lat->max)
+		hi = lat->max;
+	if (hi < lo)
+		return hi;
+
+	return lo + (unsigned long)((hi - lo) * (target - cum) / n);
+}
+
+/* The recent latency of a real server's slowest checker, 0 if not enough samples */
+unsigned long __attribute__ ((pure))
+rs_checker_latency(const real_server_t *rs, unsigned pct)
+{
+	checker_t *checker;
+	const checker_t *c;
+	unsigned long latency, max_latency = 0;
+
+	list_for_each_entry(checker, &rs->checkers_list, rs_list) {
+		c = checker->dup_of ? checker->dup_of : checker;
+		if (!c->latency || c->latency[CHECKER_LATENCY_TOTAL].recent_count < CHECKER_LATENCY_MIN_SAMPLES)
+			continue;
+		latency = checker_latency_percentile(c, CHECKER_LATENCY_TOTAL, pct, true);
+		if (latency > max_latency)
+			max_latency = latency;
+	}
+
+	return max_latency;
+}
+
 /* register checkers to the global I/O scheduler */
 void
 register_checkers_thread(void)
@@ -481,11 +889,27 @@ register_checkers_thread(void)
 	real_server_t *rs;
 	checker_t *checker;
 	unsigned long warmup;
+	unsigned num_checkers = 0;
+	unsigned checker_index = 0;
+
+	if (global_data->checker_deduplicate)
+		dedup_checkers();
+
+	if (global_data->checker_spread_start) {
+		list_for_each_entry(vs, &check_data->vs, e_list) {
+			list_for_each_entry(rs, &vs->rs, e_list) {
+				list_for_each_entry(checker, &rs->checkers_list, rs_list) {
+					if (checker->launch && !checker->dup_of)
+						num_checkers++;
+				}
+			}
+		}
+	}
 
 	list_for_each_entry(vs, &check_data->vs, e_list) {
 		list_for_each_entry(rs, &vs->rs, e_list) {
 			list_for_each_entry(checker, &rs->checkers_list, rs_list) {
-				if (checker->launch) {
+				if (checker->launch && !checker->dup_of) {
 					if (checker->vs->ha_suspend && !checker->vs->ha_suspend_addr_count)
 						checker->enabled = false;
 
@@ -500,7 +924,10 @@ register_checkers_thread(void)
 					   the same RS.
 					*/
 					warmup = checker->warmup;
-					if (warmup) {
+					if (warmup && num_checkers) {
+						/* Give each checker its own phase within its warmup */
+						warmup = (unsigned long)((uint64_t)warmup * checker_index++ / num_checkers);
+					} else if (warmup) {
 						/* coverity[dont_call] */
 						warmup = warmup * (unsigned)random() / RAND_MAX;
 					}
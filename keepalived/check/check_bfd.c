@@ -130,7 +130,7 @@ find_checker_tracked_bfd_by_name(char *name)
 	return NULL;
 }
 
-static const checker_funcs_t bfd_checker_funcs = { CHECKER_BFD, free_bfd_check, dump_bfd_check, compare_bfd_check, NULL };
+static const checker_funcs_t bfd_checker_funcs = { CHECKER_BFD, free_bfd_check, dump_bfd_check, compare_bfd_check, NULL, NULL };
 
 static void
 bfd_check_handler(__attribute__((unused)) const vector_t *strvec)
@@ -51,6 +51,8 @@
 #include "check_ssl.h"
 #include "check_api.h"
 #include "check_ping.h"
+#include "check_dns.h"
+#include "coprocess.h"
 #include "check_file.h"
 #include "global_data.h"
 #include "pidfile.h"
@@ -63,6 +65,7 @@
 #include "bitops.h"
 #include "keepalived_netlink.h"
 #include "check_print.h"
+#include "check_stats_shm.h"
 #ifdef _WITH_SNMP_CHECKER_
   #include "check_snmp.h"
 #endif
@@ -135,6 +138,10 @@ checker_dispatcher_release(void)
 #ifdef _WITH_BFD_
 	checker_bfd_dispatcher_release();
 #endif
+	checker_ping_dispatcher_release();
+	checker_dns_dispatcher_release();
+	checker_limit_release();
+	coprocess_release();
 	cancel_signal_read_thread();
 	cancel_kernel_netlink_threads();
 }
@@ -179,6 +186,8 @@ checker_terminate_phase2(void)
 	/* Stop daemon */
 	pidfile_rm(&checkers_pidfile);
 
+	check_stats_shm_close();
+
 	/* Clean data */
 	if (global_data)
 		free_global_data(&global_data);
@@ -303,7 +312,7 @@ set_effective_weights(void)
 
 	list_for_each_entry(vs, &check_data->vs, e_list) {
 		list_for_each_entry(rs, &vs->rs, e_list) {
-			rs->effective_weight = rs->iweight;
+			rs->effective_weight = rs->iweight + rs->latency_weight_adj;
 
 			list_for_each_entry(checker, &rs->checkers_list, rs_list)
 				checker->rs->effective_weight += checker->cur_weight;
@@ -456,6 +465,9 @@ start_check(data_t *prev_global_data)
 	/* Register checkers thread */
 	register_checkers_thread();
 
+	/* Create or replace the live statistics file */
+	check_stats_shm_init();
+
 	/* Set the process priority and non swappable if configured */
 	if (reload)
 		restore_priority(global_data->checker_realtime_priority, global_data->max_auto_priority, global_data->min_auto_priority_delay,
@@ -627,6 +639,7 @@ register_check_thread_addresses(void)
 	register_scheduler_addresses();
 	register_signal_thread_addresses();
 	register_notify_addresses();
+	register_coprocess_addresses();
 
 	register_smtp_addresses();
 	register_keepalived_netlink_addresses();
@@ -646,6 +659,7 @@ register_check_thread_addresses(void)
 #ifdef _WITH_BFD_
 	register_check_bfd_addresses();
 #endif
+	register_ipwrapper_addresses();
 
 #ifndef _ONE_PROCESS_DEBUG_
 	register_thread_address("reload_check_thread", reload_check_thread);
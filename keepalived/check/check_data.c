@@ -492,6 +492,8 @@ dump_rs(FILE *fp, const real_server_t *rs)
 			    , inet_sockaddrtos(&rs->addr)
 			    , ntohs(inet_sockaddrport(&rs->addr))
 			    , real_weight(rs->effective_weight), rs->effective_weight);
+	if (rs->latency_weight_adj)
+		conf_write(fp, "   Latency weight adjustment = %" PRIi64, rs->latency_weight_adj);
 	dump_forwarding_method(fp, "", rs);
 
 	conf_write(fp, "   Alpha is %s", rs->alpha ? "ON" : "OFF");
@@ -729,6 +731,8 @@ dump_vs(FILE *fp, const virtual_server_t *vs)
 		dump_notify_vs_rs_script(fp, vs->notify_quorum_down, "Quorum", "down");
 	if (vs->ha_suspend)
 		conf_write(fp, "   Using HA suspend");
+	if (vs->latency_weight)
+		conf_write(fp, "   Using latency weights");
 	conf_write(fp, "   Using smtp notification = %s", vs->smtp_alert ? "yes" : "no");
 
 	real_server_t rs = { .forwarding_method = vs->forwarding_method };
@@ -1352,6 +1356,8 @@ validate_check_config(void)
 						checker->retry = checker->rs->retry != UINT_MAX ? checker->rs->retry : checker->default_retry;
 					if (checker->co && checker->co->connection_to == UINT_MAX)
 						checker->co->connection_to = checker->rs->connection_to;
+					if (checker->co && checker->co->close_rst == -1)
+						checker->co->close_rst = global_data->checker_close_rst;
 					if (checker->delay_loop == ULONG_MAX)
 						checker->delay_loop = checker->rs->delay_loop;
 					if (checker->warmup == ULONG_MAX)
@@ -28,6 +28,7 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <sys/socket.h>
 
 #include "check_dns.h"
 #include "check_api.h"
@@ -56,8 +57,29 @@ const dns_type_t DNS_TYPE[] = {
 	{0, NULL}
 };
 
+#define DNS_POOL_BATCH	16
+
+/* The shared sockets of an address family, opened on first use */
+typedef struct _dns_pool {
+	sa_family_t family;
+	unsigned num_socks;
+	unsigned next;
+	dns_pool_sock_t *socks;
+} dns_pool_t;
+
+typedef struct _dns_pool_key {
+	uint16_t id;
+	const sockaddr_t *server;
+} dns_pool_key_t;
+
+static dns_pool_t dns_pools[] = {
+	{ .family = AF_INET },
+	{ .family = AF_INET6 },
+};
+
 static void dns_connect_thread(thread_ref_t);
 static void dns_send_thread(thread_ref_t);
+static void dns_pool_recv_thread(thread_ref_t);
 
 
 static uint16_t __attribute__ ((pure))
@@ -87,13 +109,11 @@ dns_type_name(uint16_t type)
 }
 
 static void __attribute__ ((format (printf, 3, 4)))
-dns_log_message(thread_ref_t thread, int level, const char *fmt, ...)
+dns_log_message(const checker_t *checker, int level, const char *fmt, ...)
 {
 	char buf[MAX_LOG_MSG];
 	va_list args;
 
-	checker_t *checker = THREAD_ARG(thread);
-
 	va_start(args, fmt);
 	vsnprintf(buf, sizeof (buf), fmt, args);
 	va_end(args);
@@ -101,43 +121,37 @@ dns_log_message(thread_ref_t thread, int level, const char *fmt, ...)
 	log_message(level, "DNS_CHECK (%s) %s", FMT_CHK(checker), buf);
 }
 
-static int __attribute__ ((format (printf, 3, 4)))
-dns_final(thread_ref_t thread, bool error, const char *fmt, ...)
+/* Record the result of a check and schedule the next one */
+static int __attribute__ ((format (printf, 4, 0)))
+dns_checker_final(thread_master_t *m, checker_t *checker, bool error, const char *fmt, va_list args)
 {
 	char buf[MAX_LOG_MSG];
-	va_list args;
 	int len;
 	bool checker_was_up;
 	bool rs_was_alive;
 
-	checker_t *checker = THREAD_ARG(thread);
-
 #ifdef _CHECKER_DEBUG_
 	if (do_checker_debug)
-		dns_log_message(thread, LOG_DEBUG, "final error=%d attempts=%u retry=%u", error,
+		dns_log_message(checker, LOG_DEBUG, "final error=%d attempts=%u retry=%u", error,
 				checker->retry_it, checker->retry);
 #endif
 
-	if (thread->type != THREAD_READY_TIMER)
-		thread_close_fd(thread);
-
 	if (error) {
 		if (checker->is_up || !checker->has_run) {
 			if (fmt &&
 			    (global_data->checker_log_all_failures ||
 			     checker->log_all_failures ||
 			     checker->retry_it >= checker->retry)) {
-				va_start(args, fmt);
 				len = vsnprintf(buf, sizeof (buf), fmt, args);
-				va_end(args);
 				if (checker->has_run && checker->retry_it >= checker->retry )
 					snprintf(buf + len, sizeof(buf) - len, " after %u retries", checker->retry);
-				dns_log_message(thread, LOG_INFO, "%s", buf);
+				dns_log_message(checker, LOG_INFO, "%s", buf);
 			}
 			if (checker->retry_it < checker->retry) {
 				checker->retry_it++;
 				checker->has_run = true;
-				thread_add_timer(thread->master,
+				checker_limit_end(checker);
+				thread_add_timer(m,
 						 dns_connect_thread, checker,
 						 checker->delay_before_retry);
 				return 0;
@@ -151,6 +165,7 @@ dns_final(thread_ref_t thread, bool error, const char *fmt, ...)
 					   "=> DNS_CHECK: failed on service <=");
 		}
 	} else {
+		checker_latency_record(checker, CHECKER_LATENCY_TOTAL);
 		if (!checker->is_up || !checker->has_run) {
 			checker_was_up = checker->is_up;
 			rs_was_alive = checker->rs->alive;
@@ -163,12 +178,44 @@ dns_final(thread_ref_t thread, bool error, const char *fmt, ...)
 	}
 
 	checker->retry_it = 0;
-	thread_add_timer(thread->master, dns_connect_thread, checker,
+	checker_limit_end(checker);
+	thread_add_timer(m, dns_connect_thread, checker,
 			 checker->delay_loop);
 
 	return 0;
 }
 
+/* Completion of a check on its own socket, which is closed unless this is a timer thread */
+static int __attribute__ ((format (printf, 3, 4)))
+dns_final(thread_ref_t thread, bool error, const char *fmt, ...)
+{
+	va_list args;
+	int ret;
+
+	if (thread->type != THREAD_READY_TIMER)
+		thread_close_fd(thread);
+
+	va_start(args, fmt);
+	ret = dns_checker_final(thread->master, THREAD_ARG(thread), error, fmt, args);
+	va_end(args);
+
+	return ret;
+}
+
+/* Completion of a check on a shared pool socket, which must stay open */
+static int __attribute__ ((format (printf, 4, 5)))
+dns_pool_final(thread_master_t *m, checker_t *checker, bool error, const char *fmt, ...)
+{
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = dns_checker_final(m, checker, error, fmt, args);
+	va_end(args);
+
+	return ret;
+}
+
 static void
 dns_recv_thread(thread_ref_t thread)
 {
@@ -202,7 +249,7 @@ dns_recv_thread(thread_ref_t thread)
 	if (ret < (ssize_t) sizeof (r_header)) {
 #ifdef _CHECKER_DEBUG_
 		if (do_checker_debug)
-			dns_log_message(thread, LOG_DEBUG, "too small message. (%zd bytes)", ret);
+			dns_log_message(checker, LOG_DEBUG, "too small message. (%zd bytes)", ret);
 #endif
 		thread_add_read(thread->master, dns_recv_thread, checker,
 				thread->u.f.fd, timeout, THREAD_DESTROY_CLOSE_FD);
@@ -215,7 +262,7 @@ dns_recv_thread(thread_ref_t thread)
 	if (s_header->id != r_header->id) {
 #ifdef _CHECKER_DEBUG_
 		if (do_checker_debug)
-			dns_log_message(thread, LOG_DEBUG, "ID does not match. (%04x != %04x)",
+			dns_log_message(checker, LOG_DEBUG, "ID does not match. (%04x != %04x)",
 					ntohs(s_header->id), ntohs(r_header->id));
 #endif
 		thread_add_read(thread->master, dns_recv_thread, checker,
@@ -228,7 +275,7 @@ dns_recv_thread(thread_ref_t thread)
 	if (!DNS_QR(flags)) {
 #ifdef _CHECKER_DEBUG_
 		if (do_checker_debug)
-			dns_log_message(thread, LOG_DEBUG, "receive query message?");
+			dns_log_message(checker, LOG_DEBUG, "receive query message?");
 #endif
 		thread_add_read(thread->master, dns_recv_thread, checker,
 				thread->u.f.fd, timeout, THREAD_DESTROY_CLOSE_FD);
@@ -375,6 +422,310 @@ dns_check_thread(thread_ref_t thread)
 	}
 }
 
+/* Checkers which bind to an address or interface, or set a fwmark, need their own socket */
+static bool __attribute__ ((pure))
+dns_can_pool(const conn_opts_t *co)
+{
+	return global_data->dns_check_socket_pool &&
+	       co->bindto.ss_family == AF_UNSPEC &&
+#ifdef _WITH_SO_MARK_
+	       !co->fwmark &&
+#endif
+	       !co->bind_if[0];
+}
+
+static int
+dns_pool_key_cmp(const dns_pool_key_t *key, const dns_check_t *dns_check)
+{
+	const dns_header_t *header = PTR_CAST_CONST(dns_header_t, dns_check->sbuf);
+	const sockaddr_t *server = &dns_check->checker->co->dst;
+	int res;
+
+	if (key->id != header->id)
+		return key->id < header->id ? -1 : 1;
+
+	if ((res = inet_sockaddrcmp(key->server, server)))
+		return res;
+
+	return less_equal_greater_than(inet_sockaddrport(key->server), inet_sockaddrport(server));
+}
+
+static int
+dns_pool_find_cmp(const void *key, const rb_node_t *a)
+{
+	return dns_pool_key_cmp(key, rb_entry_const(a, dns_check_t, pending));
+}
+
+static int
+dns_pool_add_cmp(rb_node_t *a, const rb_node_t *b)
+{
+	const dns_check_t *dns_check = rb_entry_const(a, dns_check_t, pending);
+	dns_pool_key_t key = {
+		.id = PTR_CAST_CONST(dns_header_t, dns_check->sbuf)->id,
+		.server = &dns_check->checker->co->dst
+	};
+
+	return dns_pool_key_cmp(&key, rb_entry_const(b, dns_check_t, pending));
+}
+
+static dns_pool_sock_t *
+dns_pool_get_sock(thread_master_t *m, sa_family_t family)
+{
+	dns_pool_t *pool = &dns_pools[family == AF_INET6];
+	dns_pool_sock_t *sock;
+	unsigned i;
+
+	if (!pool->socks) {
+		pool->num_socks = global_data->dns_check_socket_pool;
+		pool->socks = MALLOC(pool->num_socks * sizeof(*pool->socks));
+		for (i = 0; i < pool->num_socks; i++) {
+			pool->socks[i].fd = -1;
+			INIT_LIST_HEAD(&pool->socks[i].send_queue);
+			pool->socks[i].pending = RB_ROOT;
+		}
+	}
+
+	/* Spread the queries over the sockets, and so over source ports */
+	sock = &pool->socks[pool->next++ % pool->num_socks];
+
+	if (sock->fd == -1) {
+		if ((sock->fd = socket(family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_UDP)) == -1)
+			return NULL;
+
+		sock->read_thread = thread_add_read(m, dns_pool_recv_thread, sock, sock->fd, TIMER_NEVER, 0);
+	}
+
+	return sock;
+}
+
+/* Remove a checker's query from its shared socket */
+static void
+dns_pool_remove(dns_check_t *dns_check)
+{
+	thread_cancel(dns_check->timeout_thread);
+	dns_check->timeout_thread = NULL;
+
+	if (!list_empty(&dns_check->e_list))
+		list_del_init(&dns_check->e_list);
+
+	if (dns_check->sock) {
+		rb_erase(&dns_check->pending, &dns_check->sock->pending);
+		dns_check->sock = NULL;
+	}
+}
+
+static void
+dns_pool_timeout_thread(thread_ref_t thread)
+{
+	checker_t *checker = THREAD_ARG(thread);
+	dns_check_t *dns_check = CHECKER_ARG(checker);
+
+	dns_check->timeout_thread = NULL;
+	dns_pool_remove(dns_check);
+
+	dns_pool_final(thread->master, checker, true, "read timeout from socket");
+}
+
+static void
+dns_pool_send_thread(thread_ref_t thread)
+{
+	dns_pool_sock_t *sock = THREAD_ARG(thread);
+	static struct mmsghdr msgs[DNS_POOL_BATCH];
+	static struct iovec iovs[DNS_POOL_BATCH];
+	dns_check_t *dns_check;
+	const sockaddr_t *server;
+	unsigned n;
+	int ret;
+	int i;
+
+	if (thread->type == THREAD_READY_WRITE_FD)
+		thread_del_write(thread);
+	sock->send_thread = NULL;
+
+	while (!list_empty(&sock->send_queue)) {
+		n = 0;
+		list_for_each_entry(dns_check, &sock->send_queue, e_list) {
+			server = &dns_check->checker->co->dst;
+			iovs[n].iov_base = dns_check->sbuf;
+			iovs[n].iov_len = dns_check->slen;
+			memset(&msgs[n], 0, sizeof(msgs[n]));
+			msgs[n].msg_hdr.msg_name = no_const(sockaddr_t, server);
+			msgs[n].msg_hdr.msg_namelen = server->ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+			msgs[n].msg_hdr.msg_iov = &iovs[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+			if (++n == DNS_POOL_BATCH)
+				break;
+		}
+
+		ret = sendmmsg(sock->fd, msgs, n, 0);
+		if (ret == -1) {
+			if (check_EAGAIN(errno) || check_EINTR(errno)) {
+				sock->send_thread = thread_add_write(thread->master, dns_pool_send_thread,
+								   sock, sock->fd, TIMER_NEVER, 0);
+				return;
+			}
+
+			/* The first query could not be sent */
+			dns_check = list_first_entry(&sock->send_queue, dns_check_t, e_list);
+			dns_pool_remove(dns_check);
+
+			dns_pool_final(thread->master, dns_check->checker, true, "failed to write socket.");
+			continue;
+		}
+
+		for (i = 0; i < ret; i++) {
+			dns_check = list_first_entry(&sock->send_queue, dns_check_t, e_list);
+			list_del_init(&dns_check->e_list);
+		}
+	}
+}
+
+static void
+dns_pool_reply(thread_ref_t thread, dns_pool_sock_t *sock, const sockaddr_t *from, const uint8_t *rbuf, size_t len)
+{
+	const dns_header_t *r_header = PTR_CAST_CONST(dns_header_t, rbuf);
+	dns_pool_key_t key;
+	dns_check_t *dns_check;
+	rb_node_t *node;
+	int flags, rcode;
+
+	if (len < sizeof(*r_header))
+		return;
+
+	key.id = r_header->id;
+	key.server = from;
+
+	/* Replies that do not match an outstanding query, including late replies, are dropped */
+	if (!(node = rb_find(&key, &sock->pending, dns_pool_find_cmp)))
+		return;
+
+	dns_check = rb_entry(node, dns_check_t, pending);
+
+	/* Not yet sent */
+	if (!list_empty(&dns_check->e_list))
+		return;
+
+	flags = ntohs(r_header->flags);
+
+	if (!DNS_QR(flags)) {
+#ifdef _CHECKER_DEBUG_
+		if (do_checker_debug)
+			dns_log_message(dns_check->checker, LOG_DEBUG, "receive query message?");
+#endif
+		return;
+	}
+
+	dns_pool_remove(dns_check);
+
+	if ((rcode = DNS_RC(flags)) != 0) {
+		dns_pool_final(thread->master, dns_check->checker, true, "read error occurred. (rcode = %d)", rcode);
+		return;
+	}
+
+	/* success */
+	dns_pool_final(thread->master, dns_check->checker, false, NULL);
+}
+
+static void
+dns_pool_recv_thread(thread_ref_t thread)
+{
+	dns_pool_sock_t *sock = THREAD_ARG(thread);
+	static struct mmsghdr msgs[DNS_POOL_BATCH];
+	static struct iovec iovs[DNS_POOL_BATCH];
+	static sockaddr_t from[DNS_POOL_BATCH];
+	static uint8_t rbuf[DNS_POOL_BATCH][DNS_BUFFER_SIZE] __attribute__((aligned(__alignof__(dns_header_t))));
+	int ret;
+	int i;
+
+	/* A pending socket error is returned, and cleared, by recvmmsg() */
+	do {
+		for (i = 0; i < DNS_POOL_BATCH; i++) {
+			iovs[i].iov_base = rbuf[i];
+			iovs[i].iov_len = sizeof(rbuf[i]);
+			memset(&msgs[i], 0, sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_name = &from[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		ret = recvmmsg(sock->fd, msgs, DNS_POOL_BATCH, MSG_DONTWAIT, NULL);
+		if (ret == -1) {
+			if (!check_EAGAIN(errno) && !check_EINTR(errno))
+				log_message(LOG_INFO, "DNS_CHECK shared socket read failed; errno %d (%s)", errno, strerror(errno));
+			break;
+		}
+
+		for (i = 0; i < ret; i++)
+			dns_pool_reply(thread, sock, &from[i], rbuf[i], msgs[i].msg_len);
+	} while (ret == DNS_POOL_BATCH);
+
+	sock->read_thread = thread_add_read(thread->master, dns_pool_recv_thread, sock, sock->fd, TIMER_NEVER, 0);
+}
+
+/* Queue the query on a shared socket, to be sent with any others queued in this pass */
+static void
+dns_pool_query(thread_ref_t thread)
+{
+	checker_t *checker = THREAD_ARG(thread);
+	dns_check_t *dns_check = CHECKER_ARG(checker);
+	dns_header_t *header = PTR_CAST(dns_header_t, dns_check->sbuf);
+	dns_pool_sock_t *sock;
+
+	if (!(sock = dns_pool_get_sock(thread->master, checker->co->dst.ss_family))) {
+		dns_log_message(checker, LOG_INFO,
+				"failed to create socket. Rescheduling.");
+		checker_limit_end(checker);
+		thread_add_timer(thread->master, dns_connect_thread, checker,
+				 checker->delay_loop);
+		return;
+	}
+
+	dns_check->checker = checker;
+	dns_make_query(thread);
+
+	/* The query id must be unique for the server on this socket */
+	while (rb_find_add(&dns_check->pending, &sock->pending, dns_pool_add_cmp))
+		/* coverity[dont_call] */
+		header->id = random();
+	dns_check->sock = sock;
+
+	list_add_tail(&dns_check->e_list, &sock->send_queue);
+	if (!sock->send_thread)
+		sock->send_thread = thread_add_event(thread->master, dns_pool_send_thread, sock, 0);
+
+	dns_check->timeout_thread = thread_add_timer(thread->master, dns_pool_timeout_thread,
+						     checker, checker->co->connection_to);
+}
+
+/* The pending trees and send queues reference checkers which are about to
+ * be freed, and their timeout threads are removed with the thread master. */
+void
+checker_dns_dispatcher_release(void)
+{
+	dns_pool_t *pool;
+	dns_pool_sock_t *sock;
+	unsigned i, j;
+
+	for (i = 0; i < sizeof(dns_pools) / sizeof(dns_pools[0]); i++) {
+		pool = &dns_pools[i];
+		if (!pool->socks)
+			continue;
+
+		for (j = 0; j < pool->num_socks; j++) {
+			sock = &pool->socks[j];
+			thread_cancel(sock->read_thread);
+			thread_cancel(sock->send_thread);
+			if (sock->fd != -1)
+				close(sock->fd);
+		}
+
+		FREE(pool->socks);
+		pool->num_socks = 0;
+		pool->next = 0;
+	}
+}
+
 static void
 dns_connect_thread(thread_ref_t thread)
 {
@@ -385,14 +736,24 @@ dns_connect_thread(thread_ref_t thread)
 	conn_opts_t *co = checker->co;
 
 	if (!checker->enabled) {
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, dns_connect_thread, checker,
 				 checker->delay_loop);
 		return;
 	}
 
+	if (!checker_limit_start(thread))
+		return;
+
+	if (dns_can_pool(co)) {
+		dns_pool_query(thread);
+		return;
+	}
+
 	if ((fd = socket(co->dst.ss_family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_UDP)) == -1) {
-		dns_log_message(thread, LOG_INFO,
+		dns_log_message(checker, LOG_INFO,
 				"failed to create socket. Rescheduling.");
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, dns_connect_thread, checker,
 				 checker->delay_loop);
 		return;
@@ -420,8 +781,9 @@ dns_connect_thread(thread_ref_t thread)
 	/* handle connection status & register check worker thread */
 	if (socket_connection_state(fd, status, thread, dns_check_thread, co->connection_to, 0)) {
 		close(fd);
-		dns_log_message(thread, LOG_INFO,
+		dns_log_message(checker, LOG_INFO,
 				"UDP socket bind failed. Rescheduling.");
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, dns_connect_thread, checker,
 				 checker->delay_loop);
 	}
@@ -446,6 +808,7 @@ dump_dns_check(FILE *fp, const checker_t *checker)
 	conf_write(fp, "   Keepalive method = DNS_CHECK");
 	conf_write(fp, "   Type = %s", dns_type_name(dns_check->type));
 	conf_write(fp, "   Name = %s", dns_check->name);
+	conf_write(fp, "   Shared socket = %s", dns_can_pool(checker->co) ? "yes" : "no");
 }
 
 static bool
@@ -464,7 +827,7 @@ compare_dns_check(const checker_t *old_c, checker_t *new_c)
 	return true;
 }
 
-static const checker_funcs_t dns_checker_funcs = { CHECKER_DNS, free_dns_check, dump_dns_check, compare_dns_check, NULL };
+static const checker_funcs_t dns_checker_funcs = { CHECKER_DNS, free_dns_check, dump_dns_check, compare_dns_check, NULL, compare_dns_check };
 
 static void
 dns_check_handler(__attribute__((unused)) const vector_t *strvec)
@@ -473,6 +836,7 @@ dns_check_handler(__attribute__((unused)) const vector_t *strvec)
 
 	PMALLOC(dns_check);
 	dns_check->type = DNS_DEFAULT_TYPE;
+	INIT_LIST_HEAD(&dns_check->e_list);
 	queue_checker(&dns_checker_funcs, dns_connect_thread,
 				dns_check, CHECKER_NEW_CO(), true);
 
@@ -563,6 +927,9 @@ register_check_dns_addresses(void)
 {
 	register_thread_address("dns_check_thread", dns_check_thread);
 	register_thread_address("dns_connect_thread", dns_connect_thread);
+	register_thread_address("dns_pool_recv_thread", dns_pool_recv_thread);
+	register_thread_address("dns_pool_send_thread", dns_pool_send_thread);
+	register_thread_address("dns_pool_timeout_thread", dns_pool_timeout_thread);
 	register_thread_address("dns_recv_thread", dns_recv_thread);
 	register_thread_address("dns_send_thread", dns_send_thread);
 }
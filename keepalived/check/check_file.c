@@ -140,7 +140,7 @@ install_file_check_keyword(void)
 	install_sublevel_end(check_ptr);
 }
 
-static const checker_funcs_t file_checker_funcs = { CHECKER_FILE, free_file_check, dump_file_check, NULL, NULL };
+static const checker_funcs_t file_checker_funcs = { CHECKER_FILE, free_file_check, dump_file_check, NULL, NULL, NULL };
 
 void
 add_rs_to_track_files(void)
@@ -27,6 +27,7 @@
 #include <openssl/md5.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -125,13 +126,13 @@ static url_t *current_url;
 
 /* GET processing command */
 static const char *request_template =
-			"GET %s HTTP/1.%d\r\n"
+			"%s %s HTTP/1.%d\r\n"
 			"User-Agent: KeepAliveClient\r\n"
 			"%s"
 			"Host: %s%s\r\n\r\n";
 
 static const char *request_template_ipv6 =
-			"GET %s HTTP/1.%d\r\n"
+			"%s %s HTTP/1.%d\r\n"
 			"User-Agent: KeepAliveClient\r\n"
 			"%s"
 			"Host: [%s]%s\r\n\r\n";
@@ -232,6 +233,8 @@ dump_url(FILE *fp, bool is_ssl, const url_t *url)
 	unsigned min = 0;
 
 	conf_write(fp, "   Checked url = %s", url->path);
+	if (url->head)
+		conf_write(fp, "     method = HEAD");
 	if (url->digest)
 		conf_write(fp, "     digest = %s", format_digest(url->digest, digest_buf));
 	if (is_ssl)
@@ -310,19 +313,42 @@ free_http_request(request_t *req)
 {
 	if(!req)
 		return;
-	if (req->ssl)
+	if (req->ssl) {
+		/* Servers often close without a close_notify, and OpenSSL would
+		 * then stop any cached session (see tls_session_cache) being resumed */
+		SSL_set_shutdown(req->ssl, SSL_get_shutdown(req->ssl) | SSL_SENT_SHUTDOWN);
 		SSL_free(req->ssl);
+	}
+	if (req->context)
+		EVP_MD_CTX_free(req->context);
 	FREE_PTR(req->buffer);
 	FREE(req);
 }
 
+/* Close an idle kept alive connection */
+static void
+http_keepalive_close(http_checker_t *http_get_check)
+{
+	if (http_get_check->ka_fd == -1)
+		return;
+
+	close(http_get_check->ka_fd);
+	http_get_check->ka_fd = -1;
+	free_http_request(http_get_check->req);
+	http_get_check->req = NULL;
+}
+
 void
 free_http_check(checker_t *checker)
 {
 	http_checker_t *http_get_chk = checker->data;
 
 	free_url_list(&http_get_chk->url);
+	if (http_get_chk->keepalive)
+		http_keepalive_close(http_get_chk);
 	free_http_request(http_get_chk->req);
+	if (http_get_chk->tls_session)
+		SSL_SESSION_free(http_get_chk->tls_session);
 	FREE_CONST_PTR(http_get_chk->virtualhost);
 	FREE_PTR(http_get_chk);
 	FREE(checker->co);
@@ -344,8 +370,17 @@ dump_http_check(FILE *fp, const checker_t *checker)
 	conf_write(fp, "   Enable SNI %sset", http_get_chk->enable_sni ? "" : "un");
 #endif
 	conf_write(fp, "   Fast recovery %sset", http_get_chk->fast_recovery ? "" : "un");
-	if (http_get_chk->proto == PROTO_SSL)
+	if (http_get_chk->keepalive)
+		conf_write(fp, "   Keepalive connections: %" PRIu64 " new, %" PRIu64 " reused, %" PRIu64 " stale",
+				http_get_chk->conn_new, http_get_chk->conn_reused, http_get_chk->conn_stale);
+	if (http_get_chk->proto == PROTO_SSL) {
 		conf_write(fp, "   tls_compliant %sset", http_get_chk->tls_compliant ? "" : "un");
+		if (http_get_chk->tls_session_max_age)
+			conf_write(fp, "   TLS session cache max age = %s", format_decimal(http_get_chk->tls_session_max_age, TIMER_HZ_DIGITS));
+		conf_write(fp, "   TLS handshakes: %" PRIu64 " full, %" PRIu64 " resumed",
+				http_get_chk->tls_full_handshakes, http_get_chk->tls_resumed_handshakes);
+	}
+	conf_write(fp, "   Response bytes not read = %" PRIu64, http_get_chk->bytes_avoided);
 	dump_url_list(fp, http_get_chk->proto, &http_get_chk->url);
 	if (http_get_chk->failed_url)
 		conf_write(fp, "   Failed URL = %s", http_get_chk->failed_url->path);
@@ -360,6 +395,7 @@ alloc_http_get(const char *proto)
 	new->proto = (!strcmp(proto, "HTTP_GET")) ? PROTO_HTTP : PROTO_SSL;
 	new->http_protocol = HTTP_PROTOCOL_1_0;
 	new->virtualhost = NULL;
+	new->ka_fd = -1;
 
 	if (new->proto == PROTO_SSL)
 		check_data->ssl_required = true;
@@ -412,6 +448,8 @@ compare_http_check(const checker_t *old_c, checker_t *new_c)
 			return false;
 		if (u1->virtualhost && strcmp(u1->virtualhost, u2->virtualhost))
 			return false;
+		if (u1->head != u2->head)
+			return false;
 #ifdef _WITH_REGEX_CHECK_
 		if (!u1->regex != !u2->regex)
 			return false;
@@ -459,7 +497,34 @@ migrate_http_check(checker_t *new_c, const checker_t *old_c)
 	}
 }
 
-static const checker_funcs_t http_checker_funcs = { CHECKER_HTTP, free_http_check, dump_http_check, compare_http_check, migrate_http_check };
+static bool
+same_http_check(const checker_t *a, checker_t *b)
+{
+	const http_checker_t *ha = a->data;
+	const http_checker_t *hb = b->data;
+
+	if (!compare_http_check(a, b))
+		return false;
+	if (ha->proto != hb->proto ||
+	    ha->http_protocol != hb->http_protocol ||
+	    ha->fast_recovery != hb->fast_recovery ||
+	    ha->tls_compliant != hb->tls_compliant)
+		return false;
+#ifdef _HAVE_SSL_SET_TLSEXT_HOST_NAME_
+	if (ha->enable_sni != hb->enable_sni)
+		return false;
+#endif
+
+	/* Otherwise the Host header and SNI come from the real or virtual server */
+	if (!ha->virtualhost &&
+	    (!string_equal(a->rs->virtualhost, b->rs->virtualhost) ||
+	     !string_equal(a->vs->virtualhost, b->vs->virtualhost)))
+		return false;
+
+	return true;
+}
+
+static const checker_funcs_t http_checker_funcs = { CHECKER_HTTP, free_http_check, dump_http_check, compare_http_check, migrate_http_check, same_http_check };
 
 /* Configuration stream handling */
 static void
@@ -617,6 +682,25 @@ url_virtualhost_handler(const vector_t *strvec)
 	set_string(&current_url->virtualhost, strvec, "url virtualhost");
 }
 
+static void
+url_method_handler(const vector_t *strvec)
+{
+	const char *str;
+
+	if (vector_size(strvec) < 2) {
+		report_config_error(CONFIG_GENERAL_ERROR, "Missing HTTP_GET url method");
+		return;
+	}
+
+	str = strvec_slot(strvec, 1);
+	if (!strcmp(str, "HEAD"))
+		current_url->head = true;
+	else if (!strcmp(str, "GET"))
+		current_url->head = false;
+	else
+		report_config_error(CONFIG_GENERAL_ERROR, "Invalid HTTP_GET url method %s", str);
+}
+
 static void
 url_tls_compliant_handler(const vector_t *strvec)
 {
@@ -867,6 +951,22 @@ fast_recovery_handler(const vector_t *strvec)
 	http_get_chk->fast_recovery = res;
 }
 
+static void
+keepalive_handler(const vector_t *strvec)
+{
+	http_checker_t *http_get_chk = current_checker->data;
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec, 1));
+		if (res == -1) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid keepalive parameter %s", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+	http_get_chk->keepalive = res;
+}
+
 static void
 tls_compliant_handler(const vector_t *strvec)
 {
@@ -883,6 +983,22 @@ tls_compliant_handler(const vector_t *strvec)
 	http_get_chk->tls_compliant = res;
 }
 
+static void
+tls_session_cache_handler(const vector_t *strvec)
+{
+	http_checker_t *http_get_chk = current_checker->data;
+	unsigned long max_age = TLS_SESSION_MAX_AGE;
+
+	if (vector_size(strvec) >= 2 &&
+	    !read_timer(strvec, 1, &max_age, 1, 0, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "Invalid tls_session_cache max age '%s' - must be greater than 0", strvec_slot(strvec, 1));
+		return;
+	}
+
+	http_get_chk->tls_session_max_age = max_age;
+	check_data->tls_session_required = true;
+}
+
 static void
 url_check(void)
 {
@@ -933,6 +1049,17 @@ url_check(void)
 	}
 #endif
 
+	/* A HEAD response has no body to check */
+	if (current_url->head &&
+	    (current_url->digest
+#ifdef _WITH_REGEX_CHECK_
+	     || current_url->regex
+#endif
+				  )) {
+		report_config_error(CONFIG_GENERAL_ERROR, "HTTP_GET url %s cannot use method HEAD with digest or regex - using GET", current_url->path);
+		current_url->head = false;
+	}
+
 	list_add_tail(&current_url->e_list, &http_get_chk->url);
 	if (!http_get_chk->url_it)
 		http_get_chk->url_it = current_url;
@@ -954,14 +1081,18 @@ install_http_ssl_check_keyword(const char *keyword)
 	install_keyword("enable_sni", &enable_sni_handler);
 #endif
 	install_keyword("fast_recovery", &fast_recovery_handler);
-	if (!strcmp(keyword, "SSL_GET"))
+	install_keyword("keepalive", &keepalive_handler);
+	if (!strcmp(keyword, "SSL_GET")) {
 		install_keyword("tls_compliant", &tls_compliant_handler);
+		install_keyword("tls_session_cache", &tls_session_cache_handler);
+	}
 	install_keyword("url", &url_handler);
 	check_ptr1 = install_sublevel(VPP &current_url);
 	install_keyword("path", &path_handler);
 	install_keyword("digest", &digest_handler);
 	install_keyword("status_code", &status_code_handler);
 	install_keyword("virtualhost", &url_virtualhost_handler);
+	install_keyword("method", &url_method_handler);
 #ifdef _WITH_REGEX_CHECK_
 	install_keyword("regex", &regex_handler);
 	install_keyword("regex_no_match", &regex_no_match_handler);
@@ -1017,6 +1148,30 @@ install_ssl_check_keyword(void)
  *     http_handle_response (next checker thread registration)
  */
 
+/*
+ * The whole response has been read and the server is leaving the
+ * connection open, so keep it, and any SSL session, for the next
+ * request. Only the per response state is released.
+ */
+static void
+http_keepalive_park(thread_ref_t thread, http_checker_t *http_get_check)
+{
+	request_t *req = http_get_check->req;
+	SSL *ssl = req->ssl;
+	BIO *bio = req->bio;
+
+	if (req->context)
+		EVP_MD_CTX_free(req->context);
+	FREE_PTR(req->buffer);
+	memset(req, 0, sizeof(*req));
+	req->ssl = ssl;
+	req->bio = bio;
+
+	/* Nothing is read from the connection while it is idle */
+	thread_del_read(thread);
+	http_get_check->ka_fd = thread->u.f.fd;
+}
+
 /*
  * Simple epilog functions. Handling event timeout.
  * Finish the checker with memory management or url rety check.
@@ -1118,7 +1273,9 @@ epilog(thread_ref_t thread, register_checker_t method)
 		delay = checker->delay_before_retry;
 
 	/* If req == NULL, fd is not created */
-	if (req) {
+	if (req && http_get_check->keepalive && req->keepalive && req->complete)
+		http_keepalive_park(thread, http_get_check);
+	else if (req) {
 		free_http_request(req);
 		http_get_check->req = NULL;
 		thread_close_fd(thread);
@@ -1127,6 +1284,7 @@ epilog(thread_ref_t thread, register_checker_t method)
 	/* Register next checker thread.
 	 * If the checker is not up, but we are not aware of any failure,
 	 * don't delay the checks if fast_recovery option specified. */
+	checker_limit_end(checker);
 	if (http_get_check->fast_recovery &&
 	    (!checker->has_run ||
 	     (!checker->is_up && !http_get_check->failed_url)))
@@ -1385,7 +1543,8 @@ http_handle_response(thread_ref_t thread, unsigned char digest[MD5_DIGEST_LENGTH
 	}
 
 	/* Report a length mismatch the first time we get the specific difference */
-	if (req->content_len != SIZE_MAX && req->content_len != req->rx_bytes) {
+	if (req->content_len != SIZE_MAX && req->content_len != req->rx_bytes &&
+	    !req->body_skipped && !req->head) {
 		if (url->len_mismatch != (ssize_t)req->content_len - (ssize_t)req->rx_bytes) {
 			log_message(LOG_INFO, "http_check for RS %s VS %s url %s%s:"
 					      " content_length (%zu) does not match received bytes (%zu)"
@@ -1432,6 +1591,8 @@ http_handle_response(thread_ref_t thread, unsigned char digest[MD5_DIGEST_LENGTH
 	}
 #endif
 
+	checker_latency_record(checker, CHECKER_LATENCY_TOTAL);
+
 	if (!checker->is_up) {
 		log_message(LOG_INFO,
 			"%s success to %s url(%s)", msg
@@ -1463,6 +1624,143 @@ dump_digest(unsigned char *digest, unsigned len)
 	printf(HTML_HASH_FINAL);
 }
 
+/*
+ * Work out from the response headers whether the server will leave the
+ * connection open, and if so how to find the end of the response body
+ * without waiting for the connection to be closed.
+ */
+static void
+http_keepalive_response(request_t *req)
+{
+	size_t hdr_len = (size_t)(req->extracted - req->buffer);
+	bool http_1_0 = !strncmp(req->buffer, "HTTP/1.0", 8);
+	const char *val;
+	size_t val_len;
+	char *end;
+
+	if ((val = extract_header(req->buffer, hdr_len, "Connection", &val_len))) {
+		if (header_has_token(val, val_len, "close"))
+			return;
+		if (http_1_0 && !header_has_token(val, val_len, "keep-alive"))
+			return;
+	} else if (http_1_0)
+		return;
+
+	if (req->head || req->status_code == 204 || req->status_code == 304)
+		req->content_len = 0;
+	else if ((val = extract_header(req->buffer, hdr_len, "Transfer-Encoding", &val_len))) {
+		if (!header_has_token(val, val_len, "chunked"))
+			return;
+		req->chunked = true;
+		req->chunk_state = HTTP_CHUNK_SIZE;
+	} else if (req->content_len == SIZE_MAX) {
+		/* extract_content_length() only matches the canonical header name */
+		if (!(val = extract_header(req->buffer, hdr_len, "Content-Length", &val_len)))
+			return;
+		req->content_len = strtoul(val, &end, 10);
+		if (end != val + val_len) {
+			req->content_len = SIZE_MAX;
+			return;
+		}
+	}
+
+	req->keepalive = true;
+}
+
+/* Follow the chunk framing, returning false if it is invalid */
+static bool
+http_chunked_body(request_t *req, const char *data, size_t len)
+{
+	const char *end = data + len;
+	size_t n;
+	int digit;
+
+	while (data < end) {
+		switch (req->chunk_state) {
+		case HTTP_CHUNK_SIZE:
+			if (*data == ';')
+				req->chunk_state = HTTP_CHUNK_EXT;
+			else if (*data == '\r')
+				req->chunk_state = HTTP_CHUNK_SIZE_LF;
+			else {
+				if (*data >= '0' && *data <= '9')
+					digit = *data - '0';
+				else if ((*data | 0x20) >= 'a' && (*data | 0x20) <= 'f')
+					digit = (*data | 0x20) - 'a' + 10;
+				else
+					return false;
+				if (req->chunk_left > (SIZE_MAX >> 4))
+					return false;
+				req->chunk_left = (req->chunk_left << 4) | (size_t)digit;
+			}
+			break;
+		case HTTP_CHUNK_EXT:
+			if (*data == '\r')
+				req->chunk_state = HTTP_CHUNK_SIZE_LF;
+			break;
+		case HTTP_CHUNK_SIZE_LF:
+			if (*data != '\n')
+				return false;
+			req->chunk_state = req->chunk_left ? HTTP_CHUNK_DATA : HTTP_CHUNK_TRAILER;
+			break;
+		case HTTP_CHUNK_DATA:
+			n = (size_t)(end - data) < req->chunk_left ? (size_t)(end - data) : req->chunk_left;
+			req->chunk_left -= n;
+			data += n;
+			if (!req->chunk_left)
+				req->chunk_state = HTTP_CHUNK_DATA_CR;
+			continue;
+		case HTTP_CHUNK_DATA_CR:
+			if (*data != '\r')
+				return false;
+			req->chunk_state = HTTP_CHUNK_DATA_LF;
+			break;
+		case HTTP_CHUNK_DATA_LF:
+			if (*data != '\n')
+				return false;
+			req->chunk_state = HTTP_CHUNK_SIZE;
+			break;
+		case HTTP_CHUNK_TRAILER:
+			req->chunk_state = *data == '\r' ? HTTP_CHUNK_END_LF : HTTP_CHUNK_TRAILER_LINE;
+			break;
+		case HTTP_CHUNK_TRAILER_LINE:
+			if (*data == '\n')
+				req->chunk_state = HTTP_CHUNK_TRAILER;
+			break;
+		case HTTP_CHUNK_END_LF:
+			if (*data != '\n')
+				return false;
+			req->chunk_state = HTTP_CHUNK_DONE;
+			break;
+		case HTTP_CHUNK_DONE:
+			/* Data beyond the end of the response */
+			return false;
+		}
+		data++;
+	}
+
+	return true;
+}
+
+/* Note when the end of the response body has been received */
+static void
+http_keepalive_body(request_t *req, const char *data, size_t len)
+{
+	if (req->chunked) {
+		if (!http_chunked_body(req, data, len)) {
+			/* We can't tell where the response ends, so read until EOF */
+			req->keepalive = false;
+			return;
+		}
+		req->complete = req->chunk_state == HTTP_CHUNK_DONE;
+	} else if (req->rx_bytes + len >= req->content_len) {
+		/* If the server sent more than it said, don't reuse the connection */
+		if (req->rx_bytes + len > req->content_len)
+			req->keepalive = false;
+		req->complete = true;
+	}
+}
+
 /* Handle response stream performing MD5 updates */
 void
 http_process_response(thread_ref_t thread, request_t *req, size_t r, url_t *url)
@@ -1496,6 +1794,32 @@ http_process_response(thread_ref_t thread, request_t *req, size_t r, url_t *url)
 				}
 			}
 
+			/* The Content-Length of a HEAD response is that of the body GET would return */
+			if (req->head && req->content_len != SIZE_MAX)
+				http_get_check->bytes_avoided += req->content_len;
+
+			if (http_get_check->keepalive) {
+				http_keepalive_response(req);
+				if (req->keepalive)
+					http_keepalive_body(req, req->extracted, r);
+			}
+
+			/*
+			 * If only the status code is being checked, there is no need to
+			 * read the rest of the response, unless the connection is to be
+			 * kept alive.
+			 */
+			if (!req->complete && !req->keepalive && !url->digest &&
+#ifdef _WITH_REGEX_CHECK_
+			    !url->regex &&
+#endif
+			    !http_get_check->genhash_flags) {
+				if (req->content_len != SIZE_MAX && req->content_len > r && !req->head)
+					http_get_check->bytes_avoided += req->content_len - r;
+				req->body_skipped = true;
+				req->complete = true;
+			}
+
 			req->rx_bytes = r;
 #ifdef _WITH_REGEX_CHECK_
 			if (!r || !url->regex || !check_regex(url, req))
@@ -1511,7 +1835,10 @@ http_process_response(thread_ref_t thread, request_t *req, size_t r, url_t *url)
 				dump_buffer(req->buffer + old_req_len, req->content_len == SIZE_MAX || req->content_len >= req->rx_bytes + r ? r : req->content_len - req->rx_bytes, stdout, 0);
 		}
 
-		req->rx_bytes += req->len;
+		if (req->keepalive)
+			http_keepalive_body(req, req->buffer + old_req_len, r);
+
+		req->rx_bytes += r;
 #ifdef _WITH_REGEX_CHECK_
 		if (!url->regex || !check_regex(url, req))
 #endif
@@ -1551,37 +1878,43 @@ http_read_thread(thread_ref_t thread)
 		return;
 	}
 
-	if (r <= 0) {	/* -1:error , 0:EOF */
-		/* All the HTTP stream has been parsed */
-		if (url->digest) {
-			EVP_DigestFinal_ex(req->context, digest, NULL);
-			EVP_MD_CTX_free(req->context);
-			req->context = NULL;
-			if (r == 0 && http_get_check->genhash_flags & GENHASH_VERBOSE)
-				dump_digest(digest, MD5_DIGEST_LENGTH);
-		} else
-			digest[0] = 0;
-
-		if (r == -1) {
-			/* We have encountered a real read error */
-			timeout_epilog(thread, "Read error with");
+	if (r > 0) {
+		if (!req->len && !req->extracted)
+			checker_latency_record(checker, CHECKER_LATENCY_FIRST_BYTE);
+
+		/* Handle response stream */
+		http_process_response(thread, req, (size_t)r, url);
+
+		if (!req->complete) {
+			/*
+			 * Register next http stream reader.
+			 * Register itself to not perturbe global I/O multiplexer.
+			 */
+			thread_add_read(thread->master, http_read_thread, checker,
+					thread->u.f.fd, timeout, THREAD_DESTROY_CLOSE_FD);
 			return;
 		}
+	} else if (http_keepalive_retry(thread))
+		return;
 
-		/* Handle response stream */
-		http_handle_response(thread, digest, !req->extracted);
+	/* All the HTTP stream has been parsed (-1:error, 0:EOF, or end of kept alive response) */
+	if (url->digest) {
+		EVP_DigestFinal_ex(req->context, digest, NULL);
+		EVP_MD_CTX_free(req->context);
+		req->context = NULL;
+		if (r == 0 && http_get_check->genhash_flags & GENHASH_VERBOSE)
+			dump_digest(digest, MD5_DIGEST_LENGTH);
+	} else
+		digest[0] = 0;
+
+	if (r == -1) {
+		/* We have encountered a real read error */
+		timeout_epilog(thread, "Read error with");
 		return;
 	}
 
 	/* Handle response stream */
-	http_process_response(thread, req, (size_t)r, url);
-
-	/*
-	 * Register next http stream reader.
-	 * Register itself to not perturbe global I/O multiplexer.
-	 */
-	thread_add_read(thread->master, http_read_thread, checker,
-			thread->u.f.fd, timeout, THREAD_DESTROY_CLOSE_FD);
+	http_handle_response(thread, digest, !req->extracted);
 }
 
 /*
@@ -1642,9 +1975,16 @@ http_request(thread_ref_t thread)
 	const char *request_host;
 	char request_host_port[7];	/* ":" [0-9][0-9][0-9][0-9][0-9] "\0" */
 	char *str_request;
+	const char *connection;
 	url_t *fetched_url;
 	int ret = 0;
 
+	/* Handle write timeout on a reused connection */
+	if (thread->type == THREAD_WRITE_TIMEOUT) {
+		timeout_epilog(thread, "Timeout WEB write");
+		return;
+	}
+
 	/* Allocate & clean the GET string */
 	str_request = PTR_CAST(char, MALLOC(GET_BUFFER_LENGTH));
 
@@ -1672,11 +2012,19 @@ http_request(thread_ref_t thread)
 			 ntohs(inet_sockaddrport(addr)));
 	}
 
+	/* HTTP/1.1 connections are persistent unless either end says otherwise */
+	if (http_get_check->keepalive)
+		connection = http_get_check->http_protocol == HTTP_PROTOCOL_1_1 ? "" : "Connection: keep-alive\r\n";
+	else
+		connection = http_get_check->http_protocol == HTTP_PROTOCOL_1_0C || http_get_check->http_protocol == HTTP_PROTOCOL_1_1 ? "Connection: close\r\n" : "";
+
 		/* if literal ipv6 address, use ipv6 template, see RFC 2732 */
+	req->head = fetched_url->head;
 	snprintf(str_request, GET_BUFFER_LENGTH, (addr->ss_family == AF_INET6 && !vhost) ? request_template_ipv6 : request_template,
+			fetched_url->head ? "HEAD" : "GET",
 			fetched_url->path,
 			http_get_check->http_protocol == HTTP_PROTOCOL_1_1 ? 1 : 0,
-			http_get_check->http_protocol == HTTP_PROTOCOL_1_0C || http_get_check->http_protocol == HTTP_PROTOCOL_1_1 ? "Connection: close\r\n" : "",
+			connection,
 			request_host, request_host_port);
 
 #ifdef _CHECKER_DEBUG_
@@ -1693,7 +2041,8 @@ http_request(thread_ref_t thread)
 	FREE(str_request);
 
 	if (!ret) {
-		timeout_epilog(thread, "Cannot send get request to");
+		if (!http_keepalive_retry(thread))
+			timeout_epilog(thread, "Cannot send get request to");
 		return;
 	}
 
@@ -1730,6 +2079,8 @@ http_check_thread(thread_ref_t thread)
 	if (!http_get_check->req) {
 		PMALLOC(http_get_check->req);
 		new_req = true;
+		checker_tcp_connected(checker);
+		checker_latency_record(checker, CHECKER_LATENCY_CONNECT);
 	} else
 		new_req = false;
 
@@ -1771,6 +2122,8 @@ http_check_thread(thread_ref_t thread)
 	if (ret) {
 		/* Remote WEB server is connected.
 		 */
+		if (http_get_check->proto == PROTO_SSL)
+			checker_latency_record(checker, CHECKER_LATENCY_TLS);
 #ifdef _CHECKER_DEBUG_
 		if (do_checker_debug)
 			log_message(LOG_DEBUG, "Remote Web server %s connected.", FMT_CHK(checker));
@@ -1790,42 +2143,27 @@ http_check_thread(thread_ref_t thread)
 	}
 }
 
-void
-http_connect_thread(thread_ref_t thread)
+/* Open a new connection to the remote web server */
+static void
+http_connect(thread_ref_t thread, checker_t *checker)
 {
-	checker_t *checker = THREAD_ARG(thread);
 	http_checker_t *http_get_check = CHECKER_ARG(checker);
 	conn_opts_t *co = checker->co;
-	url_t *fetched_url;
 	enum connect_result status;
 	int fd;
 
-	/*
-	 * Register a new checker thread & return
-	 * if checker is disabled
-	 */
-	if (!checker->enabled) {
-		thread_add_timer(thread->master, http_connect_thread, checker,
-				 checker->delay_loop);
-		return;
-	}
-
-	/* if there are no URLs in list, enable server w/o checking */
-	fetched_url = fetch_next_url(http_get_check);
-	if (!fetched_url) {
-		epilog(thread, REGISTER_CHECKER_NEW);
-		return;
-	}
-
 	/* Create the socket */
 	if ((fd = socket(co->dst.ss_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_TCP)) == -1) {
 		log_message(LOG_INFO, "WEB connection fail to create socket. Rescheduling.");
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, http_connect_thread, checker,
 				checker->delay_loop);
 
 		return;
 	}
 
+	http_get_check->conn_new++;
+
 	status = tcp_bind_connect(fd, co);
 
 	/* handle tcp connection status & register check worker thread */
@@ -1835,12 +2173,88 @@ http_connect_thread(thread_ref_t thread)
 			timeout_epilog(thread, "HTTP/SSL_CHECK - network unreachable");
 		} else {
 			log_message(LOG_INFO, "WEB socket bind failed. Rescheduling");
+			checker_limit_end(checker);
 			thread_add_timer(thread->master, http_connect_thread, checker,
 					 checker->delay_loop);
 		}
 	}
 }
 
+/*
+ * A reused connection failed before any of the response was received,
+ * most likely because the server closed it just as we sent the request.
+ * Try again on a new connection rather than reporting a failure.
+ */
+bool
+http_keepalive_retry(thread_ref_t thread)
+{
+	checker_t *checker = THREAD_ARG(thread);
+	http_checker_t *http_get_check = CHECKER_ARG(checker);
+	request_t *req = http_get_check->req;
+
+	if (!req || !req->reused || req->extracted || req->len)
+		return false;
+
+	http_get_check->conn_stale++;
+	free_http_request(req);
+	http_get_check->req = NULL;
+	thread_close_fd(thread);
+
+	http_connect(thread, checker);
+
+	return true;
+}
+
+void
+http_connect_thread(thread_ref_t thread)
+{
+	checker_t *checker = THREAD_ARG(thread);
+	http_checker_t *http_get_check = CHECKER_ARG(checker);
+	url_t *fetched_url;
+	char c;
+	int fd;
+
+	/*
+	 * Register a new checker thread & return
+	 * if checker is disabled
+	 */
+	if (!checker->enabled) {
+		checker_limit_end(checker);
+		thread_add_timer(thread->master, http_connect_thread, checker,
+				 checker->delay_loop);
+		return;
+	}
+
+	if (!checker_limit_start(thread))
+		return;
+
+	/* if there are no URLs in list, enable server w/o checking */
+	fetched_url = fetch_next_url(http_get_check);
+	if (!fetched_url) {
+		epilog(thread, REGISTER_CHECKER_NEW);
+		return;
+	}
+
+	/* Reuse an idle kept alive connection unless the server has closed it,
+	 * or sent something we weren't expecting */
+	if (http_get_check->ka_fd != -1) {
+		if (recv(http_get_check->ka_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == -1 && check_EAGAIN(errno)) {
+			fd = http_get_check->ka_fd;
+			http_get_check->ka_fd = -1;
+			http_get_check->req->reused = true;
+			http_get_check->conn_reused++;
+			thread_add_write(thread->master, http_request, checker,
+					 fd, checker->co->connection_to, THREAD_DESTROY_CLOSE_FD);
+			return;
+		}
+
+		http_get_check->conn_stale++;
+		http_keepalive_close(http_get_check);
+	}
+
+	http_connect(thread, checker);
+}
+
 #ifdef THREAD_DUMP
 void
 register_check_http_addresses(void)
@@ -1848,6 +2262,7 @@ register_check_http_addresses(void)
 	register_thread_address("http_check_thread", http_check_thread);
 	register_thread_address("http_connect_thread", http_connect_thread);
 	register_thread_address("http_read_thread", http_read_thread);
+	register_thread_address("http_request", http_request);
 	register_thread_address("http_response_thread", http_response_thread);
 }
 #endif
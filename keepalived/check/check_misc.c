@@ -48,6 +48,7 @@
 
 static void misc_check_thread(thread_ref_t);
 static void misc_check_child_thread(thread_ref_t);
+static void misc_check_coprocess_done(void *, int, bool);
 
 static bool script_user_set;
 
@@ -74,6 +75,9 @@ dump_misc_check(FILE *fp, const checker_t *checker)
 	conf_write(fp, "   script = %s", cmd_str(&misck_checker->script));
 	conf_write(fp, "   timeout = %lu", misck_checker->timeout/TIMER_HZ);
 	conf_write(fp, "   dynamic = %s", misck_checker->dynamic ? "YES" : "NO");
+	conf_write(fp, "   persistent = %s", misck_checker->persistent ? "YES" : "NO");
+	if (misck_checker->persistent)
+		dump_coprocess_req(fp, &misck_checker->req);
 	conf_write(fp, "   uid:gid = %u:%u", misck_checker->script.uid, misck_checker->script.gid);
 	ctime_r(&misck_checker->last_ran.tv_sec, time_str);
 	conf_write(fp, "   Last ran = %" PRI_tv_sec ".%6.6" PRI_tv_usec " (%.24s.%6.6" PRI_tv_usec ")", misck_checker->last_ran.tv_sec, misck_checker->last_ran.tv_usec, time_str, misck_checker->last_ran.tv_usec);
@@ -86,7 +90,8 @@ compare_misc_check(const checker_t *old_c, checker_t *new_c)
 	const misc_checker_t *old = old_c->data;
 	const misc_checker_t *new = new_c->data;
 
-	if (new->dynamic != old->dynamic)
+	if (new->dynamic != old->dynamic ||
+	    new->persistent != old->persistent)
 		return false;
 
 	return notify_script_compare(&old->script, &new->script);
@@ -107,7 +112,7 @@ migrate_misc_check(checker_t *new_c, const checker_t *old_c)
 	new_c->cur_weight = new->last_exit_code - (new->last_exit_code ? 2 : 0) - new_c->rs->iweight;
 }
 
-static const checker_funcs_t misc_checker_funcs = { CHECKER_MISC, free_misc_check, dump_misc_check, compare_misc_check, migrate_misc_check };
+static const checker_funcs_t misc_checker_funcs = { CHECKER_MISC, free_misc_check, dump_misc_check, compare_misc_check, migrate_misc_check, NULL };
 
 static void
 misc_check_handler(__attribute__((unused)) const vector_t *strvec)
@@ -162,6 +167,14 @@ misc_dynamic_handler(__attribute__((unused)) const vector_t *strvec)
 	new_misck_checker->dynamic = true;
 }
 
+static void
+misc_persistent_handler(__attribute__((unused)) const vector_t *strvec)
+{
+	misc_checker_t *new_misck_checker = current_checker->data;
+
+	new_misck_checker->persistent = true;
+}
+
 static void
 misc_user_handler(const vector_t *strvec)
 {
@@ -191,6 +204,11 @@ misc_end_handler(void)
 		return;
 	}
 
+	if (new_misck_checker->persistent && !coprocess_script_valid(&new_misck_checker->script)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "misc_persistent script %s parameters cannot contain newlines - running per check", cmd_str(&new_misck_checker->script));
+		new_misck_checker->persistent = false;
+	}
+
 	if (!script_user_set)
 	{
 		if (get_default_script_user(&new_misck_checker->script.uid, &new_misck_checker->script.gid)) {
@@ -212,6 +230,7 @@ install_misc_check_keyword(void)
 	install_keyword_quoted("misc_path", &misc_path_handler);
 	install_keyword("misc_timeout", &misc_timeout_handler);
 	install_keyword("misc_dynamic", &misc_dynamic_handler);
+	install_keyword("misc_persistent", &misc_persistent_handler);
 	install_keyword("user", &misc_user_handler);
 	install_level_end_handler(&misc_end_handler);
 	install_sublevel_end(check_ptr);
@@ -255,6 +274,9 @@ check_misc_script_security(magic_t magic)
 				if (insecure) {
 					/* Remove the script */
 					free_checker(checker);
+				} else if (misc_script->persistent && !(misc_script->script.flags & SC_EXECABLE)) {
+					log_message(LOG_INFO, "Misc script %s cannot be run persistently since it cannot be exec'd - running per check", cmd_str(&misc_script->script));
+					misc_script->persistent = false;
 				}
 			}
 		}
@@ -278,11 +300,26 @@ misc_check_thread(thread_ref_t thread)
 	 */
 	if (!checker->enabled) {
 		/* Register next timer checker */
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, misc_check_thread, checker,
 				 checker->delay_loop);
 		return;
 	}
 
+	if (!checker_limit_start(thread))
+		return;
+
+	if (misck_checker->persistent) {
+		if (coprocess_request(thread->master, &misck_checker->req, &misck_checker->script,
+				      (misck_checker->timeout) ? misck_checker->timeout : checker->vs->delay_loop,
+				      misc_check_coprocess_done, checker)) {
+			misck_checker->last_ran = time_now;
+			misck_checker->state = SCRIPT_STATE_RUNNING;
+		} else
+			checker_limit_end(checker);
+		return;
+	}
+
 	/* Execute the script in a child process. Parent returns, child doesn't */
 	ret = system_call_script(thread->master, misc_check_child_thread,
 				  checker, (misck_checker->timeout) ? misck_checker->timeout : checker->vs->delay_loop,
@@ -290,19 +327,36 @@ misc_check_thread(thread_ref_t thread)
 	if (!ret) {
 		misck_checker->last_ran = time_now;
 		misck_checker->state = SCRIPT_STATE_RUNNING;
-	}
+	} else
+		checker_limit_end(checker);
 }
 
 static void
-misc_check_child_thread(thread_ref_t thread)
+misc_check_reschedule(thread_master_t *m, checker_t *checker)
 {
-	int wait_status;
-	pid_t pid;
-	checker_t *checker;
-	misc_checker_t *misck_checker;
+	misc_checker_t *misck_checker = CHECKER_ARG(checker);
 	timeval_t next_time;
-	int sig_num;
-	unsigned timeout = 0;
+
+	/* Register next timer checker */
+	next_time = timer_add_long(misck_checker->last_ran, checker->retry_it ? checker->delay_before_retry : checker->delay_loop);
+	next_time = timer_sub_now(next_time);
+	if (next_time.tv_sec < 0 ||
+	    (next_time.tv_sec == 0 && next_time.tv_usec == 0))
+		next_time.tv_sec = 0, next_time.tv_usec = 1;
+
+	checker_limit_end(checker);
+	thread_add_timer(m, misc_check_thread, checker, timer_long(next_time));
+
+	misck_checker->state = SCRIPT_STATE_IDLE;
+
+	checker->has_run = true;
+}
+
+/* Handle the exit status of the script, or the reply of a persistent script */
+static void
+misc_check_result(thread_master_t *m, checker_t *checker, int wait_status)
+{
+	misc_checker_t *misck_checker = CHECKER_ARG(checker);
 	const char *script_exit_type = NULL;
 	bool script_success = false;
 	const char *reason = NULL;
@@ -310,56 +364,6 @@ misc_check_child_thread(thread_ref_t thread)
 	bool rs_was_alive;
 	bool message_only = false;
 
-	checker = THREAD_ARG(thread);
-	misck_checker = CHECKER_ARG(checker);
-
-	if (thread->type == THREAD_CHILD_TIMEOUT) {
-		pid = THREAD_CHILD_PID(thread);
-
-		if (misck_checker->state == SCRIPT_STATE_RUNNING) {
-			misck_checker->state = SCRIPT_STATE_REQUESTING_TERMINATION;
-			sig_num = SIGTERM;
-			timeout = 2;
-		} else if (misck_checker->state == SCRIPT_STATE_REQUESTING_TERMINATION) {
-			misck_checker->state = SCRIPT_STATE_FORCING_TERMINATION;
-			sig_num = SIGKILL;
-			timeout = 2;
-		} else if (misck_checker->state == SCRIPT_STATE_FORCING_TERMINATION) {
-			log_message(LOG_INFO, "Child (PID %d) failed to terminate after kill", pid);
-			sig_num = SIGKILL;
-			timeout = 10;	/* Give it longer to terminate */
-		}
-
-		if (timeout) {
-			/* If kill returns an error, we can't kill the process since either the process has terminated,
-			 * or we don't have permission. If we can't kill it, there is no point trying again. */
-			if (kill(-pid, sig_num)) {
-				if (errno == ESRCH) {
-					/* The process does not exist, and we should
-					 * have reaped its exit status, otherwise it
-					 * would exist as a zombie process. */
-					log_message(LOG_INFO, "Misc script %s child (PID %d) lost, register checker again", misck_checker->script.args[0], pid);
-					misck_checker->state = SCRIPT_STATE_IDLE;
-					timeout = 0;
-					goto recheck;
-				} else {
-					log_message(LOG_INFO, "kill -%d of process %s(%d) with new state %u failed with errno %d", sig_num, misck_checker->script.args[0], pid, misck_checker->state, errno);
-					timeout = 1000;
-				}
-			}
-		} else if (misck_checker->state != SCRIPT_STATE_IDLE) {
-			log_message(LOG_INFO, "Child thread pid %d timeout with unknown script state %u", pid, misck_checker->state);
-			timeout = 10;	/* We need some timeout */
-		}
-
-		if (timeout)
-			thread_add_child(thread->master, misc_check_child_thread, checker, pid, timeout * TIMER_HZ);
-
-		return;
-	}
-
-	wait_status = THREAD_CHILD_STATUS(thread);
-
 	if (WIFEXITED(wait_status)) {
 		unsigned status = WEXITSTATUS(wait_status);
 		int64_t effective_weight;
@@ -380,6 +384,7 @@ misc_check_child_thread(thread_ref_t thread)
 			}
 
 			/* everything is good */
+			checker_latency_record(checker, CHECKER_LATENCY_TOTAL);
 			if (!checker->is_up || !checker->has_run) {
 				script_exit_type = "succeeded";
 				script_success = true;
@@ -407,14 +412,6 @@ misc_check_child_thread(thread_ref_t thread)
 			misck_checker->last_exit_code = status;
 	}
 	else if (WIFSIGNALED(wait_status)) {
-		if (misck_checker->state == SCRIPT_STATE_REQUESTING_TERMINATION && WTERMSIG(wait_status) == SIGTERM) {
-			/* The script terminated due to a SIGTERM, and we sent it a SIGTERM to
-			 * terminate the process. Now make sure any children it created have
-			 * died too. */
-			pid = THREAD_CHILD_PID(thread);
-			kill(-pid, SIGKILL);
-		}
-
 		/* We treat forced termination as a failure */
 		if (checker->is_up || !checker->has_run) {
 			if ((misck_checker->state == SCRIPT_STATE_REQUESTING_TERMINATION &&
@@ -491,19 +488,92 @@ misc_check_child_thread(thread_ref_t thread)
 		}
 	}
 
-recheck:
-	/* Register next timer checker */
-	next_time = timer_add_long(misck_checker->last_ran, checker->retry_it ? checker->delay_before_retry : checker->delay_loop);
-	next_time = timer_sub_now(next_time);
-	if (next_time.tv_sec < 0 ||
-	    (next_time.tv_sec == 0 && next_time.tv_usec == 0))
-		next_time.tv_sec = 0, next_time.tv_usec = 1;
+	misc_check_reschedule(m, checker);
+}
 
-	thread_add_timer(thread->master, misc_check_thread, checker, timer_long(next_time));
+static void
+misc_check_child_thread(thread_ref_t thread)
+{
+	int wait_status;
+	pid_t pid;
+	checker_t *checker;
+	misc_checker_t *misck_checker;
+	int sig_num;
+	unsigned timeout = 0;
 
-	misck_checker->state = SCRIPT_STATE_IDLE;
+	checker = THREAD_ARG(thread);
+	misck_checker = CHECKER_ARG(checker);
 
-	checker->has_run = true;
+	if (thread->type == THREAD_CHILD_TIMEOUT) {
+		pid = THREAD_CHILD_PID(thread);
+
+		if (misck_checker->state == SCRIPT_STATE_RUNNING) {
+			misck_checker->state = SCRIPT_STATE_REQUESTING_TERMINATION;
+			sig_num = SIGTERM;
+			timeout = 2;
+		} else if (misck_checker->state == SCRIPT_STATE_REQUESTING_TERMINATION) {
+			misck_checker->state = SCRIPT_STATE_FORCING_TERMINATION;
+			sig_num = SIGKILL;
+			timeout = 2;
+		} else if (misck_checker->state == SCRIPT_STATE_FORCING_TERMINATION) {
+			log_message(LOG_INFO, "Child (PID %d) failed to terminate after kill", pid);
+			sig_num = SIGKILL;
+			timeout = 10;	/* Give it longer to terminate */
+		}
+
+		if (timeout) {
+			/* If kill returns an error, we can't kill the process since either the process has terminated,
+			 * or we don't have permission. If we can't kill it, there is no point trying again. */
+			if (kill(-pid, sig_num)) {
+				if (errno == ESRCH) {
+					/* The process does not exist, and we should
+					 * have reaped its exit status, otherwise it
+					 * would exist as a zombie process. */
+					log_message(LOG_INFO, "Misc script %s child (PID %d) lost, register checker again", misck_checker->script.args[0], pid);
+					misck_checker->state = SCRIPT_STATE_IDLE;
+					misc_check_reschedule(thread->master, checker);
+					return;
+				} else {
+					log_message(LOG_INFO, "kill -%d of process %s(%d) with new state %u failed with errno %d", sig_num, misck_checker->script.args[0], pid, misck_checker->state, errno);
+					timeout = 1000;
+				}
+			}
+		} else if (misck_checker->state != SCRIPT_STATE_IDLE) {
+			log_message(LOG_INFO, "Child thread pid %d timeout with unknown script state %u", pid, misck_checker->state);
+			timeout = 10;	/* We need some timeout */
+		}
+
+		if (timeout)
+			thread_add_child(thread->master, misc_check_child_thread, checker, pid, timeout * TIMER_HZ);
+
+		return;
+	}
+
+	wait_status = THREAD_CHILD_STATUS(thread);
+
+	if (WIFSIGNALED(wait_status) &&
+	    misck_checker->state == SCRIPT_STATE_REQUESTING_TERMINATION && WTERMSIG(wait_status) == SIGTERM) {
+		/* The script terminated due to a SIGTERM, and we sent it a SIGTERM to
+		 * terminate the process. Now make sure any children it created have
+		 * died too. */
+		pid = THREAD_CHILD_PID(thread);
+		kill(-pid, SIGKILL);
+	}
+
+	misc_check_result(thread->master, checker, wait_status);
+}
+
+static void
+misc_check_coprocess_done(void *arg, int status, bool timed_out)
+{
+	checker_t *checker = arg;
+	misc_checker_t *misck_checker = CHECKER_ARG(checker);
+
+	/* The helper has been killed, so report it the same way as a script we killed */
+	if (timed_out)
+		misck_checker->state = SCRIPT_STATE_FORCING_TERMINATION;
+
+	misc_check_result(master, checker, status);
 }
 
 #ifdef THREAD_DUMP
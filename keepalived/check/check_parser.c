@@ -586,6 +586,21 @@ hasuspend_handler(__attribute__((unused)) const vector_t *strvec)
 	current_vs->ha_suspend = true;
 }
 
+static void
+latency_weight_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec, 1));
+		if (res == -1) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid virtual_server latency_weight parameter %s", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+	current_vs->latency_weight = res;
+}
+
 static void
 vs_smtp_alert_handler(const vector_t *strvec)
 {
@@ -978,6 +993,7 @@ init_check_keywords(bool active)
 	install_keyword("persistence_granularity", &pgr_handler);
 	install_keyword("protocol", &proto_handler);
 	install_keyword("ha_suspend", &hasuspend_handler);
+	install_keyword("latency_weight", &latency_weight_handler);
 	install_keyword("smtp_alert", &vs_smtp_alert_handler);
 	install_keyword("virtualhost", &vs_virtualhost_handler);
 #ifdef _WITH_SNMP_CHECKER_
@@ -38,17 +38,34 @@
 #include "smtp.h"
 #include "ipwrapper.h"
 #include "check_parser.h"
+#include "rbtree_ka.h"
+#include "utils.h"
 
 #define ICMP_BUFSIZE 128
-#define SOCK_RECV_BUFF 128*1024
+#define SOCK_RECV_BUFF 1024*1024	/* Shared by all PING_CHECKs of an address family */
+#define ICMP_RECV_BATCH 32
+
+/* One ICMP socket per address family, shared by all the PING_CHECKs */
+typedef struct _ping_socket {
+	sa_family_t	family;
+	int		fd;
+	thread_ref_t	thread;
+	uint16_t	seq_no;
+	rb_root_t	pending;		/* ping_check_t awaiting a reply */
+} ping_socket_t;
 
 static const char * const ping_group_range = "/proc/sys/net/ipv4/ping_group_range";
 
 static gid_t save_gid_min;
 static bool checked_ping_group_range;
 
-static void icmp_connect_thread(thread_ref_t);
+static ping_socket_t ping_sockets[] = {
+	{ .family = AF_INET, .fd = -1 },
+	{ .family = AF_INET6, .fd = -1 },
+};
+
 static void icmp_ping_thread(thread_ref_t);
+static void icmp_recv_thread(thread_ref_t);
 
 bool
 set_ping_group_range(bool set)
@@ -142,7 +159,7 @@ compare_ping_check(const checker_t *a, checker_t *b)
 	return compare_conn_opts(a->co, b->co);
 }
 
-static const checker_funcs_t ping_checker_funcs = { CHECKER_PING, free_ping_check, dump_ping_check, compare_ping_check, NULL };
+static const checker_funcs_t ping_checker_funcs = { CHECKER_PING, free_ping_check, dump_ping_check, compare_ping_check, NULL, compare_ping_check };
 
 static void
 ping_check_handler(__attribute__((unused)) const vector_t *strvec)
@@ -150,7 +167,7 @@ ping_check_handler(__attribute__((unused)) const vector_t *strvec)
 	ping_check_t *ping_check = sizeof(ping_check_t) ? MALLOC(sizeof (ping_check_t)) : NULL;
 
 	/* queue new checker */
-	queue_checker(&ping_checker_funcs, icmp_connect_thread, ping_check, CHECKER_NEW_CO(), true);
+	queue_checker(&ping_checker_funcs, icmp_ping_thread, ping_check, CHECKER_NEW_CO(), true);
 
 	if (!checked_ping_group_range)
 		set_ping_group_range(true);
@@ -178,67 +195,86 @@ install_ping_check_keyword(void)
 	install_sublevel_end(check_ptr);
 }
 
-static enum connect_result
-ping_it(int fd, checker_t *checker, conn_opts_t* co)
+static int
+ping_seq_cmp(const void *seq_no, const rb_node_t *a)
 {
-	ping_check_t *ping_checker = CHECKER_ARG(checker);
+	return less_equal_greater_than(*PTR_CAST_CONST(uint16_t, seq_no), rb_entry_const(a, ping_check_t, pending)->seq_no);
+}
 
-	struct icmphdr *icmp_hdr;
-	char send_buf[sizeof(*icmp_hdr) + ICMP_BUFSIZE] __attribute__((aligned(__alignof__(struct icmphdr))));
+static int
+ping_pending_cmp(rb_node_t *a, const rb_node_t *b)
+{
+	return less_equal_greater_than(rb_entry(a, ping_check_t, pending)->seq_no, rb_entry_const(b, ping_check_t, pending)->seq_no);
+}
 
-	set_buf(send_buf + sizeof(*icmp_hdr), ICMP_BUFSIZE);
+static ping_socket_t *
+get_ping_socket(sa_family_t family)
+{
+	return &ping_sockets[family == AF_INET6];
+}
 
-	icmp_hdr = PTR_CAST(struct icmphdr, send_buf);
+static bool
+open_ping_socket(thread_master_t *m, ping_socket_t *ps)
+{
+	int size = SOCK_RECV_BUFF;
 
-	memset(icmp_hdr, 0, sizeof(*icmp_hdr));
-	icmp_hdr->type = ICMP_ECHO;
-	icmp_hdr->un.echo.sequence = htons(++ping_checker->seq_no);
+	/*
+	 * Using SOCK_DGRAM with IPPROTO_ICMP/ICMPV6 means that the kernel will insert the ICMP
+	 * id value, and only deliver echo replies with that id to the socket. All the PING_CHECKs
+	 * of an address family share the socket, so the replies are matched to their checkers
+	 * by sequence number and source address.
+	 *
+	 * The alternative is to use SOCK_RAW, but then we can't ensure the uniqueness of the id
+	 * field.
+	 */
+	if ((ps->fd = socket(ps->family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+			     ps->family == AF_INET ? IPPROTO_ICMP : IPPROTO_ICMPV6)) == -1)
+		return false;
 
-	if (sendto(fd, send_buf, sizeof(send_buf), 0, PTR_CAST(struct sockaddr, &co->dst), sizeof(struct sockaddr)) < 0) {
-		log_message(LOG_INFO, "send ICMP packet fail");
-		return connect_error;
+	if (setsockopt(ps->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)))
+		log_message(LOG_INFO, "setsockopt SO_RCVBUF for socket %d failed (%d) - %m", ps->fd, errno);
+
+	ps->thread = thread_add_read(m, icmp_recv_thread, ps, ps->fd, TIMER_NEVER, 0);
+
+	return true;
+}
+
+static void
+close_ping_socket(ping_socket_t *ps)
+{
+	thread_cancel(ps->thread);
+	ps->thread = NULL;
+
+	if (ps->fd != -1) {
+		close(ps->fd);
+		ps->fd = -1;
 	}
-	return connect_success;
 }
 
 static enum connect_result
-recv_it(int fd, checker_t *checker)
+ping_it(int fd, uint16_t seq_no, conn_opts_t* co)
 {
-	ping_check_t *ping_checker = CHECKER_ARG(checker);
-	ssize_t len;
-	const struct icmphdr *icmp_hdr;
-	char recv_buf[sizeof(*icmp_hdr) + ICMP_BUFSIZE] __attribute__((aligned(__alignof__(struct icmphdr))));
-
-	len = recv(fd, recv_buf, sizeof(recv_buf), 0);
+	struct icmphdr *icmp_hdr;
+	char send_buf[sizeof(*icmp_hdr) + ICMP_BUFSIZE] __attribute__((aligned(__alignof__(struct icmphdr))));
 
-	if (len < 0) {
-		log_message(LOG_INFO, "recv ICMP packet error");
-		return connect_error;
-	}
+	set_buf(send_buf + sizeof(*icmp_hdr), ICMP_BUFSIZE);
 
-	if ((size_t)len < sizeof(*icmp_hdr)) {
-		log_message(LOG_INFO, "Error, got short ICMP packet, %zd bytes", len);
-		return connect_error;
-	}
+	icmp_hdr = PTR_CAST(struct icmphdr, send_buf);
 
-	icmp_hdr = PTR_CAST_CONST(struct icmphdr, recv_buf);
-	if (icmp_hdr->type != ICMP_ECHOREPLY) {
-		log_message(LOG_INFO, "Got ICMP packet with type 0x%x", icmp_hdr->type);
-		return connect_error;
-	}
+	memset(icmp_hdr, 0, sizeof(*icmp_hdr));
+	icmp_hdr->type = ICMP_ECHO;
+	icmp_hdr->un.echo.sequence = htons(seq_no);
 
-	if (ntohs(icmp_hdr->un.echo.sequence) != ping_checker->seq_no) {
-		log_message(LOG_INFO, "Ping reply expected seq no %u, received %u", ping_checker->seq_no, ntohs(icmp_hdr->un.echo.sequence));
+	if (sendto(fd, send_buf, sizeof(send_buf), 0, PTR_CAST(struct sockaddr, &co->dst), sizeof(struct sockaddr)) < 0) {
+		log_message(LOG_INFO, "send ICMP packet fail");
 		return connect_error;
 	}
-
 	return connect_success;
 }
 
 static enum connect_result
-ping6_it(int fd, checker_t *checker, conn_opts_t* co)
+ping6_it(int fd, uint16_t seq_no, conn_opts_t* co)
 {
-	ping_check_t *ping_checker = CHECKER_ARG(checker);
 	struct icmp6_hdr* icmp6_hdr;
 	char send_buf[sizeof(*icmp6_hdr) + ICMP_BUFSIZE] __attribute__((aligned(__alignof__(struct icmp6_hdr))));
 
@@ -248,7 +284,7 @@ ping6_it(int fd, checker_t *checker, conn_opts_t* co)
 
 	memset(icmp6_hdr, 0, sizeof(*icmp6_hdr));
 	icmp6_hdr->icmp6_type = ICMP6_ECHO_REQUEST;
-	icmp6_hdr->icmp6_seq = htons(++ping_checker->seq_no);
+	icmp6_hdr->icmp6_seq = htons(seq_no);
 
 	if (sendto(fd, send_buf, sizeof(send_buf), 0, PTR_CAST(struct sockaddr, &co->dst), sizeof(struct sockaddr_in6)) < 0) {
 		log_message(LOG_INFO, "send ICMPv6 packet fail - errno %d", errno);
@@ -258,49 +294,15 @@ ping6_it(int fd, checker_t *checker, conn_opts_t* co)
 	return connect_success;
 }
 
-static enum connect_result
-recv6_it(int fd, checker_t *checker)
-{
-	ping_check_t *ping_checker = CHECKER_ARG(checker);
-	ssize_t len;
-	const struct icmp6_hdr* icmp6_hdr;
-	char recv_buf[sizeof (*icmp6_hdr) + ICMP_BUFSIZE] __attribute__((aligned(__alignof__(struct icmp6_hdr))));
-
-	len = recv(fd, recv_buf, sizeof(recv_buf), 0);
-
-	if (len < 0) {
-		log_message(LOG_INFO, "recv ICMPv6 packet error");
-		return connect_error;
-	}
-
-	if ((size_t)len < sizeof(*icmp6_hdr)) {
-		log_message(LOG_INFO, "Error, got short ICMPv6 packet, %zd bytes", len);
-		return connect_error;
-	}
-
-	icmp6_hdr = PTR_CAST_CONST(struct icmp6_hdr, recv_buf);
-	if (icmp6_hdr->icmp6_type != ICMP6_ECHO_REPLY) {
-		log_message(LOG_INFO, "Got ICMPv6 packet with type 0x%x", icmp6_hdr->icmp6_type);
-		return connect_error;
-	}
-
-	if (ntohs(icmp6_hdr->icmp6_seq) != ping_checker->seq_no) {
-		log_message(LOG_INFO, "Ping reply expected seq no %u, received %u", ping_checker->seq_no, ntohs(icmp6_hdr->icmp6_seq));
-		return connect_error;
-	}
-
-	return connect_success;
-}
-
 static void
-icmp_epilog(thread_ref_t thread, bool is_success)
+icmp_epilog(thread_master_t *m, checker_t *checker, bool is_success)
 {
-	checker_t *checker;
 	unsigned long delay;
 	bool checker_was_up;
 	bool rs_was_alive;
 
-	checker = THREAD_ARG(thread);
+	if (is_success)
+		checker_latency_record(checker, CHECKER_LATENCY_TOTAL);
 
 	delay = checker->delay_loop;
 	if (is_success || ((checker->is_up || !checker->has_run) && checker->retry_it >= checker->retry)) {
@@ -342,131 +344,217 @@ icmp_epilog(thread_ref_t thread, bool is_success)
 
 	checker->has_run = true;
 
-	if (is_success)
-		thread_add_read(thread->master, icmp_ping_thread, checker, thread->u.f.fd, delay, THREAD_DESTROY_CLOSE_FD);
-	else {
-		thread_close_fd(thread);
-		thread_add_timer(thread->master, icmp_connect_thread, checker, delay);
-	}
+	checker_limit_end(checker);
+	thread_add_timer(m, icmp_ping_thread, checker, delay);
 }
 
 static void
-icmp_check_thread(thread_ref_t thread)
+icmp_timeout_thread(thread_ref_t thread)
 {
 	checker_t *checker = THREAD_ARG(thread);
-	enum connect_result status;
+	ping_check_t *ping_checker = CHECKER_ARG(checker);
 
-	if (thread->type == THREAD_READ_TIMEOUT) {
-		if (checker->is_up &&
-		    (global_data->checker_log_all_failures || checker->log_all_failures))
-			log_message(LOG_INFO, "ICMP connection to address %s timeout.", FMT_CHK(checker));
-		status = connect_error;
-	} else
-		status = checker->co->dst.ss_family == AF_INET ?
-				recv_it(thread->u.f.fd, checker) : recv6_it(thread->u.f.fd, checker);
+	ping_checker->timeout_thread = NULL;
+	rb_erase(&ping_checker->pending, &get_ping_socket(checker->co->dst.ss_family)->pending);
 
-	/*
-	 * If status = connect_success, then we start udp check with the record of icmp failed times.
-	 * Otherwise we will do the icmp connect again until it reaches the unhealthy threshold.
-	 * we handle fd uniform.
-	 */
-	if (status == connect_success)
-		icmp_epilog(thread, true);
-	else if (status == connect_error) {
-		if (checker->is_up &&
-		    thread->type != THREAD_READ_TIMEOUT &&
-		    (global_data->checker_log_all_failures || checker->log_all_failures))
-			log_message(LOG_INFO, "ICMP connection to %s of %s failed."
-				,FMT_CHK(checker), FMT_VS(checker->vs));
-		icmp_epilog(thread, false);
-	}
+	if (checker->is_up &&
+	    (global_data->checker_log_all_failures || checker->log_all_failures))
+		log_message(LOG_INFO, "ICMP connection to address %s timeout.", FMT_CHK(checker));
+
+	icmp_epilog(thread->master, checker, false);
 }
 
 static void
-icmp_ping_thread(thread_ref_t thread)
+icmp_reply(thread_master_t *m, ping_socket_t *ps, const sockaddr_t *from, const char *buf, size_t len)
 {
-	checker_t *checker = THREAD_ARG(thread);
-	conn_opts_t *co = checker->co;
-	enum connect_result status;
+	checker_t *checker;
+	ping_check_t *ping_checker;
+	rb_node_t *node;
+	uint16_t seq_no;
+
+	if (ps->family == AF_INET) {
+		const struct icmphdr *icmp_hdr = PTR_CAST_CONST(struct icmphdr, buf);
+
+		if (len < sizeof(*icmp_hdr)) {
+			log_message(LOG_INFO, "Error, got short ICMP packet, %zu bytes", len);
+			return;
+		}
 
-	if (thread->type == THREAD_READ_TIMEOUT) {
-		/* Send next ICMP echo request */
-		if (co->dst.ss_family == AF_INET)
-			status = ping_it(thread->u.f.fd, checker, co);
-		else
-			status = ping6_it(thread->u.f.fd, checker, co);
-
-		/* handle icmp send status & register check worker thread */
-		if (udp_icmp_check_state(thread->u.f.fd, status, thread, icmp_check_thread, co->connection_to))
-			icmp_epilog(thread, false);
-	} else if (thread->type == THREAD_READY_READ_FD) {
-		/* This shouldn't happen */
-		ssize_t len;
-		char recv_buf[sizeof (struct icmp6_hdr) + ICMP_BUFSIZE] __attribute__((aligned(__alignof__(struct icmp6_hdr))));
-
-		len = recv(thread->u.f.fd, recv_buf, sizeof(recv_buf), 0);
-
-		if (len > 0)
-			log_message(LOG_INFO, "unexpected ping check receive packet");
-		thread_add_read_sands(thread->master, icmp_ping_thread, checker, thread->u.f.fd, &thread->sands, THREAD_DESTROY_CLOSE_FD);
+		if (icmp_hdr->type != ICMP_ECHOREPLY) {
+			log_message(LOG_INFO, "Got ICMP packet with type 0x%x", icmp_hdr->type);
+			return;
+		}
+
+		seq_no = ntohs(icmp_hdr->un.echo.sequence);
 	} else {
-		/* THREAD_READ_ERROR */
+		const struct icmp6_hdr *icmp6_hdr = PTR_CAST_CONST(struct icmp6_hdr, buf);
+
+		if (len < sizeof(*icmp6_hdr)) {
+			log_message(LOG_INFO, "Error, got short ICMPv6 packet, %zu bytes", len);
+			return;
+		}
+
+		if (icmp6_hdr->icmp6_type != ICMP6_ECHO_REPLY) {
+			log_message(LOG_INFO, "Got ICMPv6 packet with type 0x%x", icmp6_hdr->icmp6_type);
+			return;
+		}
+
+		seq_no = ntohs(icmp6_hdr->icmp6_seq);
+	}
+
+	/* A late reply to a request that has already timed out is simply dropped */
+	if (!(node = rb_find(&seq_no, &ps->pending, ping_seq_cmp)))
+		return;
+
+	ping_checker = rb_entry(node, ping_check_t, pending);
+	checker = ping_checker->checker;
+
+	if (inet_sockaddrcmp(from, &checker->co->dst)) {
+		log_message(LOG_INFO, "Ping reply seq no %u for %s received from %s", seq_no,
+				FMT_CHK(checker), inet_sockaddrtos(from));
+		return;
+	}
+
+	rb_erase(&ping_checker->pending, &ps->pending);
+	thread_cancel(ping_checker->timeout_thread);
+	ping_checker->timeout_thread = NULL;
+
+	icmp_epilog(m, checker, true);
+}
+
+static void
+icmp_recv_thread(thread_ref_t thread)
+{
+	ping_socket_t *ps = THREAD_ARG(thread);
+	static struct mmsghdr msgs[ICMP_RECV_BATCH];
+	static struct iovec iovs[ICMP_RECV_BATCH];
+	static sockaddr_t from[ICMP_RECV_BATCH];
+	static char recv_buf[ICMP_RECV_BATCH][sizeof(struct icmp6_hdr) + ICMP_BUFSIZE] __attribute__((aligned(__alignof__(struct icmphdr))));
+	int ret;
+	int i;
+
+	if (thread->type == THREAD_READ_ERROR) {
+		/* The pending checks will time out, and the next ping will reopen the socket */
+		log_message(LOG_INFO, "ICMP%s shared socket error - closing", ps->family == AF_INET ? "" : "v6");
+		ps->thread = NULL;
 		thread_close_fd(thread);
-		thread_add_timer_sands(thread->master, icmp_connect_thread, checker, &thread->sands);
+		ps->fd = -1;
+		return;
+	}
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < ICMP_RECV_BATCH; i++) {
+		iovs[i].iov_base = recv_buf[i];
+		iovs[i].iov_len = sizeof(recv_buf[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &from[i];
 	}
+
+	do {
+		for (i = 0; i < ICMP_RECV_BATCH; i++)
+			msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+
+		ret = recvmmsg(ps->fd, msgs, ICMP_RECV_BATCH, MSG_DONTWAIT, NULL);
+		if (ret == -1) {
+			if (!check_EAGAIN(errno) && !check_EINTR(errno))
+				log_message(LOG_INFO, "recv ICMP%s packet error - errno %d (%m)",
+						ps->family == AF_INET ? "" : "v6", errno);
+			break;
+		}
+
+		for (i = 0; i < ret; i++)
+			icmp_reply(thread->master, ps, &from[i], recv_buf[i], msgs[i].msg_len);
+	} while (ret == ICMP_RECV_BATCH);
+
+	ps->thread = thread_add_read(thread->master, icmp_recv_thread, ps, ps->fd, TIMER_NEVER, 0);
 }
 
 static void
-icmp_connect_thread(thread_ref_t thread)
+icmp_ping_thread(thread_ref_t thread)
 {
 	checker_t *checker = THREAD_ARG(thread);
 	ping_check_t *ping_checker = CHECKER_ARG(checker);
 	conn_opts_t *co = checker->co;
-	int fd;
-	int size = SOCK_RECV_BUFF;
+	ping_socket_t *ps = get_ping_socket(co->dst.ss_family);
+	enum connect_result status;
+	unsigned tries;
 
 	if (!checker->enabled) {
-		thread_add_timer(thread->master, icmp_connect_thread, checker,
+		checker_limit_end(checker);
+		thread_add_timer(thread->master, icmp_ping_thread, checker,
 				checker->delay_loop);
 		return;
 	}
 
+	if (!checker_limit_start(thread))
+		return;
+
 	/*
 	 * If we config a real server in several virtual server, the icmp_ratelimit should be cancelled.
 	 * echo 0 > /proc/sys/net/ipv4/icmp_ratelimit
 	 */
 
-	/*
-	 * Using SOCK_DGRAM with IPPROTO_ICMP/ICMPV6 means that the kernel will insert the ICMP
-	 * id value. In order to keep the same id value for each ICMP echo request, we need to keep
-	 * the socket open.
-	 *
-	 * The alternative is to use SOCK_RAW, but then we can't ensure the uniqueness of the id
-	 * field.
-	 */
-	if ((fd = socket(co->dst.ss_family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
-			 co->dst.ss_family == AF_INET ? IPPROTO_ICMP : IPPROTO_ICMPV6)) == -1) {
+	if (ps->fd == -1 && !open_ping_socket(thread->master, ps)) {
 		log_message(LOG_INFO, "ICMP%s connect fail to create socket. Rescheduling.",
 				co->dst.ss_family == AF_INET ? "" : "v6");
-		thread_add_timer(thread->master, icmp_connect_thread, checker,
+		checker_limit_end(checker);
+		thread_add_timer(thread->master, icmp_ping_thread, checker,
+				checker->delay_loop);
+		return;
+	}
+
+	/* Skip over any sequence number still awaiting a reply after wrapping */
+	ping_checker->checker = checker;
+	for (tries = 0; tries <= UINT16_MAX; tries++) {
+		ping_checker->seq_no = ++ps->seq_no;
+		if (!rb_find_add(&ping_checker->pending, &ps->pending, ping_pending_cmp))
+			break;
+	}
+
+	if (tries > UINT16_MAX) {
+		log_message(LOG_INFO, "ICMP%s no free sequence number on shared socket. Rescheduling.",
+				co->dst.ss_family == AF_INET ? "" : "v6");
+		checker_limit_end(checker);
+		thread_add_timer(thread->master, icmp_ping_thread, checker,
 				checker->delay_loop);
 		return;
 	}
 
-	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)))
-		log_message(LOG_INFO, "setsockopt SO_RCVBUF for socket %d failed (%d) - %m", fd, errno);
+	/* Send next ICMP echo request */
+	if (co->dst.ss_family == AF_INET)
+		status = ping_it(ps->fd, ping_checker->seq_no, co);
+	else
+		status = ping6_it(ps->fd, ping_checker->seq_no, co);
 
-	ping_checker->seq_no = 0;
+	if (status != connect_success) {
+		rb_erase(&ping_checker->pending, &ps->pending);
+		icmp_epilog(thread->master, checker, false);
+		return;
+	}
+
+	ping_checker->timeout_thread = thread_add_timer(thread->master, icmp_timeout_thread, checker, co->connection_to);
+}
 
-	thread_add_read(thread->master, icmp_ping_thread, checker, fd, 0, THREAD_DESTROY_CLOSE_FD);
+/* The pending trees reference checkers which are about to be freed, and
+ * their timeout threads are removed with the thread master. */
+void
+checker_ping_dispatcher_release(void)
+{
+	unsigned i;
+
+	for (i = 0; i < sizeof(ping_sockets) / sizeof(ping_sockets[0]); i++) {
+		close_ping_socket(&ping_sockets[i]);
+		ping_sockets[i].pending = RB_ROOT;
+	}
 }
 
 #ifdef THREAD_DUMP
 void
 register_check_ping_addresses(void)
 {
-	register_thread_address("icmp_check_thread", icmp_check_thread);
-	register_thread_address("icmp_connect_thread", icmp_connect_thread);
 	register_thread_address("icmp_ping_thread", icmp_ping_thread);
+	register_thread_address("icmp_recv_thread", icmp_recv_thread);
+	register_thread_address("icmp_timeout_thread", icmp_timeout_thread);
 }
 #endif
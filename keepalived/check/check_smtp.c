@@ -102,7 +102,7 @@ compare_smtp_check(const checker_t *old_c, checker_t *new_c)
 	return true;
 }
 
-static const checker_funcs_t smtp_checker_funcs = { CHECKER_SMTP, free_smtp_check, dump_smtp_check, compare_smtp_check, NULL };
+static const checker_funcs_t smtp_checker_funcs = { CHECKER_SMTP, free_smtp_check, dump_smtp_check, compare_smtp_check, NULL, NULL };
 
 /*
  * Callback for whenever an SMTP_CHECK keyword is encountered
@@ -239,6 +239,7 @@ smtp_host_handler(__attribute__((unused)) const vector_t *strvec)
 
 	/* Default to the RS */
 	current_checker_host->co->dst = current_rs->addr;
+	current_checker_host->co->close_rst = -1;
 }
 
 static void
@@ -389,6 +390,7 @@ smtp_final(thread_ref_t thread, const char *format, ...)
 		}
 
 		/* Reschedule the main thread using the configured delay loop */
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, smtp_start_check_thread, checker, checker->delay_loop);
 
 		return 0;
@@ -401,6 +403,7 @@ smtp_final(thread_ref_t thread, const char *format, ...)
 	 * take note and bring up the real server as well as inject the delay_loop.
 	 */
 	checker->retry_it = 0;
+	checker_latency_record(checker, CHECKER_LATENCY_TOTAL);
 
 	/*
 	 * Set the internal host pointer to the host that we'll be
@@ -424,6 +427,7 @@ smtp_final(thread_ref_t thread, const char *format, ...)
 
 	checker->has_run = true;
 
+	checker_limit_end(checker);
 	thread_add_timer(thread->master, smtp_start_check_thread, checker, checker->delay_loop);
 
 	return 0;
@@ -729,6 +733,8 @@ smtp_check_thread(thread_ref_t thread)
 			break;
 
 		case connect_success:
+			checker_tcp_connected(checker);
+			checker_latency_record(checker, CHECKER_LATENCY_CONNECT);
 #ifdef _CHECKER_DEBUG_
 			if (do_checker_debug)
 				log_message(LOG_DEBUG, "SMTP_CHECK Remote SMTP server %s connected",
@@ -795,6 +801,7 @@ smtp_connect_thread(thread_ref_t thread)
 	 * we don't fall of the face of the earth.
 	 */
 	if (!checker->enabled) {
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, smtp_start_check_thread, checker,
 				 checker->delay_loop);
 		return;
@@ -805,6 +812,7 @@ smtp_connect_thread(thread_ref_t thread)
 	/* Create the socket, failing here should be an oddity */
 	if ((sd = socket(smtp_host->dst.ss_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_TCP)) == -1) {
 		log_message(LOG_INFO, "SMTP_CHECK connection failed to create socket. Rescheduling.");
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, smtp_start_check_thread, checker,
 				 checker->delay_loop);
 		return;
@@ -822,6 +830,7 @@ smtp_connect_thread(thread_ref_t thread)
 		} else {
 			close(sd);
 			log_message(LOG_INFO, "SMTP_CHECK socket bind failed. Rescheduling.");
+			checker_limit_end(checker);
 			thread_add_timer(thread->master, smtp_start_check_thread, checker,
 				checker->delay_loop);
 		}
@@ -833,6 +842,9 @@ smtp_start_check_thread(thread_ref_t thread)
 {
 	checker_t *checker = THREAD_ARG(thread);
 
+	if (checker->enabled && !checker_limit_start(thread))
+		return;
+
 	checker->retry_it = 0;
 
 	smtp_connect_thread(thread);
@@ -208,6 +208,9 @@ enum check_snmp_realserver_magic {
 	CHECK_SNMP_RSRATEINBPS64,
 	CHECK_SNMP_RSRATEOUTBPS64,
 #endif
+	CHECK_SNMP_RSLATENCYP50,
+	CHECK_SNMP_RSLATENCYP90,
+	CHECK_SNMP_RSLATENCYWEIGHTADJ,
 };
 
 #define STATE_VSGM_FWMARK 1
@@ -1274,6 +1277,18 @@ check_snmp_realserver(struct variable *vp, oid *name, size_t *length,
 		*var_len = sizeof(struct counter64);
 		return PTR_CAST(u_char, &counter64_ret);
 #endif
+	case CHECK_SNMP_RSLATENCYP50:
+		if (type == STATE_RS_SORRY) break;
+		long_ret.u = rs_checker_latency(rs, 50);
+		return PTR_CAST(u_char, &long_ret);
+	case CHECK_SNMP_RSLATENCYP90:
+		if (type == STATE_RS_SORRY) break;
+		long_ret.u = rs_checker_latency(rs, 90);
+		return PTR_CAST(u_char, &long_ret);
+	case CHECK_SNMP_RSLATENCYWEIGHTADJ:
+		if (type == STATE_RS_SORRY) break;
+		long_ret.s = rs->latency_weight_adj;
+		return PTR_CAST(u_char, &long_ret);
 	default:
 		return NULL;
 	}
@@ -1702,6 +1717,12 @@ static struct variable3 check_vars[] = {
 	{CHECK_SNMP_RSRATEOUTBPS64, ASN_COUNTER64, RONLY,
 	 check_snmp_realserver, 3, {4, 1, 62}},
 #endif
+	{CHECK_SNMP_RSLATENCYP50, ASN_UNSIGNED, RONLY,
+	 check_snmp_realserver, 3, {4, 1, 63}},
+	{CHECK_SNMP_RSLATENCYP90, ASN_UNSIGNED, RONLY,
+	 check_snmp_realserver, 3, {4, 1, 64}},
+	{CHECK_SNMP_RSLATENCYWEIGHTADJ, ASN_INTEGER, RONLY,
+	 check_snmp_realserver, 3, {4, 1, 65}},
 
 #ifdef _WITH_VRRP_
 	/* LVS sync daemon configuration */
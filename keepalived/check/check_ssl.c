@@ -33,6 +33,7 @@
 #include "check_api.h"
 #include "check_http.h"
 #include "logger.h"
+#include "timer.h"
 #ifdef THREAD_DUMP
 #include "scheduler.h"
 #endif
@@ -46,6 +47,10 @@ clear_ssl(ssl_data_t *ssl)
 		SSL_CTX_free(ssl->ctx);
 		ssl->ctx = NULL;
 	}
+	if (ssl && ssl->resume_ctx) {
+		SSL_CTX_free(ssl->resume_ctx);
+		ssl->resume_ctx = NULL;
+	}
 }
 
 /* PEM password callback function */
@@ -62,11 +67,74 @@ password_cb(char *buf, int num, __attribute__((unused)) int rwflag, void *userda
 	return (int)plen;
 }
 
+/* Called by OpenSSL when a new session, or a TLS 1.3 session ticket,
+ * is received. Keep the latest one for the checker to resume. */
+static int
+ssl_new_session(SSL *ssl, SSL_SESSION *session)
+{
+	checker_t *checker = SSL_get_app_data(ssl);
+	http_checker_t *http_get_check;
+
+	if (!checker)
+		return 0;
+
+	http_get_check = CHECKER_ARG(checker);
+	if (!http_get_check->tls_session_max_age)
+		return 0;
+
+	if (http_get_check->tls_session)
+		SSL_SESSION_free(http_get_check->tls_session);
+	http_get_check->tls_session = session;
+	http_get_check->tls_session_time = timer_long(time_now);
+
+	/* We keep the reference to the session */
+	return 1;
+}
+
+/* Load our keys, certificates and trusted CAs into a context */
+static bool
+load_ssl_ctx(SSL_CTX *ctx)
+{
+	/* Load our keys and certificates */
+	if (check_data->ssl->certfile)
+		if (!(SSL_CTX_use_certificate_chain_file(ctx,
+							 check_data->ssl->certfile))) {
+			log_message(LOG_INFO, "SSL error : Cant load certificate file...");
+			return false;
+		}
+
+	/* Handle password callback using userdata ssl */
+	if (check_data->ssl->password) {
+		SSL_CTX_set_default_passwd_cb_userdata(ctx,
+						       check_data->ssl);
+		SSL_CTX_set_default_passwd_cb(ctx, password_cb);
+	}
+
+	if (check_data->ssl->keyfile)
+		if (!(SSL_CTX_use_PrivateKey_file(ctx,
+						  check_data->ssl->keyfile,
+						  SSL_FILETYPE_PEM))) {
+			log_message(LOG_INFO, "SSL error : Cant load key file...");
+			return false;
+		}
+
+	/* Load the CAs we trust */
+	if (check_data->ssl->cafile)
+		if (!(SSL_CTX_load_verify_locations(ctx,
+						    check_data->ssl->cafile, 0))) {
+			log_message(LOG_INFO, "SSL error : Cant load CA file...");
+			return false;
+		}
+
+	return true;
+}
+
 /* Inititalize global SSL context */
 static bool
 build_ssl_ctx(void)
 {
 	ssl_data_t *ssl;
+	bool autogen = !check_data->ssl;
 
 	/* Library initialization */
 #ifdef HAVE_OPENSSL_INIT_CRYPTO
@@ -103,46 +171,40 @@ build_ssl_ctx(void)
 		return false;
 	}
 
-	/* return for autogen context */
-	if (!check_data->ssl) {
+	/* autogen context has no keys, certificates or CAs */
+	if (autogen)
 		check_data->ssl = ssl;
-		goto end;
-	}
+	else if (!load_ssl_ctx(ssl->ctx))
+		return false;
 
-	/* Load our keys and certificates */
-	if (check_data->ssl->certfile)
-		if (!(SSL_CTX_use_certificate_chain_file(ssl->ctx,
-							 check_data->ssl->certfile))) {
-			log_message(LOG_INFO, "SSL error : Cant load certificate file...");
-			return false;
-		}
+#if HAVE_SSL_CTX_SET_VERIFY_DEPTH
+	SSL_CTX_set_verify_depth(ssl->ctx, 1);
+#endif
 
-	/* Handle password callback using userdata ssl */
-	if (check_data->ssl->password) {
-		SSL_CTX_set_default_passwd_cb_userdata(ssl->ctx,
-						       check_data->ssl);
-		SSL_CTX_set_default_passwd_cb(ssl->ctx, password_cb);
+	if (!check_data->tls_session_required)
+		return true;
+
+	/* Checkers using tls_session_cache have their own context, so that
+	 * the session caching does not affect other checkers */
+	if (!(ssl->resume_ctx = SSL_CTX_new(ssl->meth))) {
+		log_message(LOG_INFO, "SSL error: cannot create new SSL session cache context");
+		return false;
 	}
 
-	if (check_data->ssl->keyfile)
-		if (!(SSL_CTX_use_PrivateKey_file(ssl->ctx,
-						  check_data->ssl->keyfile,
-						  SSL_FILETYPE_PEM))) {
-			log_message(LOG_INFO, "SSL error : Cant load key file...");
-			return false;
-		}
+	if (!autogen && !load_ssl_ctx(ssl->resume_ctx))
+		return false;
 
-	/* Load the CAs we trust */
-	if (check_data->ssl->cafile)
-		if (!(SSL_CTX_load_verify_locations(ssl->ctx,
-						    check_data->ssl->cafile, 0))) {
-			log_message(LOG_INFO, "SSL error : Cant load CA file...");
-			return false;
-		}
+	/* Sessions are cached by the checkers (see tls_session_cache) */
+	SSL_CTX_set_session_cache_mode(ssl->resume_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ssl->resume_ctx, ssl_new_session);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	/* A server closing without a close_notify is otherwise a fatal error,
+	 * which stops the session being resumed */
+	SSL_CTX_set_options(ssl->resume_ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
 
-      end:
 #if HAVE_SSL_CTX_SET_VERIFY_DEPTH
-	SSL_CTX_set_verify_depth(ssl->ctx, 1);
+	SSL_CTX_set_verify_depth(ssl->resume_ctx, 1);
 #endif
 
 	return true;
@@ -221,7 +283,7 @@ ssl_connect(thread_ref_t thread, int new_req)
 	if (new_req) {
 		int bio_fd;
 
-		if (!(req->ssl = SSL_new(check_data->ssl->ctx))) {
+		if (!(req->ssl = SSL_new(http_get_check->tls_session_max_age ? check_data->ssl->resume_ctx : check_data->ssl->ctx))) {
 			log_message(LOG_INFO, "Unable to establish ssl connection - SSL_new() failed");
 			return 0;
 		}
@@ -278,10 +340,29 @@ ssl_connect(thread_ref_t thread, int new_req)
 				SSL_set_tlsext_host_name(req->ssl, vhost.name);
 		}
 #endif
+
+		SSL_set_app_data(req->ssl, checker);
+
+		/* Try to resume the last session, unless it is too old */
+		if (http_get_check->tls_session) {
+			if (timer_long(time_now) - http_get_check->tls_session_time < http_get_check->tls_session_max_age)
+				SSL_set_session(req->ssl, http_get_check->tls_session);
+			else {
+				SSL_SESSION_free(http_get_check->tls_session);
+				http_get_check->tls_session = NULL;
+			}
+		}
 	}
 
 	ret = SSL_connect(req->ssl);
 
+	if (ret == 1) {
+		if (SSL_session_reused(req->ssl))
+			http_get_check->tls_resumed_handshakes++;
+		else
+			http_get_check->tls_full_handshakes++;
+	}
+
 	return ret;
 }
 
@@ -324,17 +405,21 @@ ssl_read_thread(thread_ref_t thread)
 		/* Handle response stream */
 		http_process_response(thread, req, (size_t)r, url);
 
-		/*
-		 * Register next ssl stream reader.
-		 * Register itself to not perturbe global I/O multiplexer.
-		 */
+		if (!req->complete) {
+			/*
+			 * Register next ssl stream reader.
+			 * Register itself to not perturbe global I/O multiplexer.
+			 */
 
-		thread_add_read(thread->master, ssl_read_thread, checker,
-				thread->u.f.fd, timeout, THREAD_DESTROY_CLOSE_FD);
-		return;
-	}
+			thread_add_read(thread->master, ssl_read_thread, checker,
+					thread->u.f.fd, timeout, THREAD_DESTROY_CLOSE_FD);
+			return;
+		}
 
-	req->error = SSL_get_error(req->ssl, r);
+		/* The connection is being kept alive */
+		req->error = SSL_ERROR_NONE;
+	} else
+		req->error = SSL_get_error(req->ssl, r);
 
 	if (req->error == SSL_ERROR_WANT_READ) {
 		 /* async read unfinished */
@@ -379,6 +464,10 @@ ssl_read_thread(thread_ref_t thread)
 		}
 	}
 
+	if ((req->error == SSL_ERROR_ZERO_RETURN || req->error == SSL_ERROR_SYSCALL) &&
+	    http_keepalive_retry(thread))
+		return;
+
 	/* All the SSL stream has been parsed */
 	if (url->digest) {
 		EVP_DigestFinal_ex(req->context, digest, NULL);
@@ -390,7 +479,9 @@ ssl_read_thread(thread_ref_t thread)
 	} else
 		digest[0] = 0;
 
-	if (req->error != SSL_ERROR_SSL && req->error != SSL_ERROR_SYSCALL)
+	if (req->complete && req->keepalive)
+		r = 0;
+	else if (req->error != SSL_ERROR_SSL && req->error != SSL_ERROR_SYSCALL)
 		r = SSL_shutdown(req->ssl);
 	else
 		r = 0;
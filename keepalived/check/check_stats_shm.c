@@ -0,0 +1,160 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Checker live statistics in shared memory.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <netinet/in.h>
+
+#include "check_stats_shm.h"
+#include "global_data.h"
+#include "main.h"
+#include "scheduler.h"
+#include "list_head.h"
+#include "utils.h"
+
+static stats_shm_t *checker_shm;
+
+/* Copy the real server's current state to its record. This is called
+ * from the refresh timer and whenever a checker changes the real
+ * server's state or weight. */
+void
+check_stats_shm_update(const virtual_server_t *vs, const real_server_t *rs)
+{
+	checker_shm_rec_t *rec = rs->shm_rec;
+	uint32_t flags;
+	int32_t weight;
+
+	if (!rec)
+		return;
+
+	flags = (rs->alive ? STATS_SHM_RS_ALIVE : 0) |
+		(rs->set ? STATS_SHM_RS_SET : 0) |
+		(rs == vs->s_svr ? STATS_SHM_RS_SORRY : 0) |
+		(vs->quorum_state_up ? STATS_SHM_VS_QUORUM_UP : 0);
+	weight = real_weight(rs->effective_weight);
+
+	if (flags == rec->flags &&
+	    weight == rec->weight &&
+	    rs->num_failed_checkers == rec->num_failed_checkers &&
+	    rec->last_change)
+		return;
+
+	stats_shm_write_begin(&rec->seq);
+
+	rec->flags = flags;
+	rec->weight = weight;
+	rec->num_failed_checkers = rs->num_failed_checkers;
+	rec->last_change = stats_shm_timeval(&time_now);
+
+	stats_shm_write_end(&rec->seq);
+}
+
+static void
+check_stats_shm_thread(__attribute__((unused)) thread_ref_t thread)
+{
+	virtual_server_t *vs;
+	real_server_t *rs;
+
+	list_for_each_entry(vs, &check_data->vs, e_list) {
+		list_for_each_entry(rs, &vs->rs, e_list)
+			check_stats_shm_update(vs, rs);
+		if (vs->s_svr)
+			check_stats_shm_update(vs, vs->s_svr);
+	}
+
+	stats_shm_set_update_time(checker_shm);
+
+	thread_add_timer(master, check_stats_shm_thread, NULL, global_data->stats_shm_refresh);
+}
+
+static void
+init_rec(stats_shm_t *shm, unsigned index, const virtual_server_t *vs, real_server_t *rs)
+{
+	checker_shm_rec_t *rec;
+
+	rec = rs->shm_rec = stats_shm_rec(shm, index);
+
+	/* These don't change until the next reload */
+	strcpy_safe(rec->vs_name, FMT_VS(vs));
+	rec->rs_family = rs->addr.ss_family;
+	rec->rs_port = ntohs(inet_sockaddrport(&rs->addr));
+	if (rs->addr.ss_family == AF_INET)
+		memcpy(rec->rs_addr, &PTR_CAST_CONST(struct sockaddr_in, &rs->addr)->sin_addr, sizeof(struct in_addr));
+	else if (rs->addr.ss_family == AF_INET6)
+		memcpy(rec->rs_addr, &PTR_CAST_CONST(struct sockaddr_in6, &rs->addr)->sin6_addr, sizeof(struct in6_addr));
+
+	check_stats_shm_update(vs, rs);
+}
+
+/* Called after the configuration has been read, and after each reload */
+void
+check_stats_shm_init(void)
+{
+	virtual_server_t *vs;
+	real_server_t *rs;
+	unsigned num_recs = 0;
+
+	/* Old real servers must not write to the segment being replaced */
+	if (old_check_data) {
+		list_for_each_entry(vs, &old_check_data->vs, e_list) {
+			list_for_each_entry(rs, &vs->rs, e_list)
+				rs->shm_rec = NULL;
+			if (vs->s_svr)
+				vs->s_svr->shm_rec = NULL;
+		}
+	}
+
+	if (checker_shm)
+		stats_shm_close(&checker_shm, !global_data->checker_stats_shm || strcmp(global_data->checker_stats_shm, checker_shm->file_name));
+
+	if (!global_data->checker_stats_shm)
+		return;
+
+	list_for_each_entry(vs, &check_data->vs, e_list) {
+		list_for_each_entry(rs, &vs->rs, e_list)
+			num_recs++;
+		if (vs->s_svr)
+			num_recs++;
+	}
+
+	if (!(checker_shm = stats_shm_create(global_data->checker_stats_shm, STATS_SHM_CHECKER, sizeof(checker_shm_rec_t), num_recs)))
+		return;
+
+	num_recs = 0;
+	list_for_each_entry(vs, &check_data->vs, e_list) {
+		list_for_each_entry(rs, &vs->rs, e_list)
+			init_rec(checker_shm, num_recs++, vs, rs);
+		if (vs->s_svr)
+			init_rec(checker_shm, num_recs++, vs, vs->s_svr);
+	}
+
+	stats_shm_set_update_time(checker_shm);
+
+	thread_add_timer(master, check_stats_shm_thread, NULL, global_data->stats_shm_refresh);
+}
+
+void
+check_stats_shm_close(void)
+{
+	stats_shm_close(&checker_shm, true);
+}
@@ -62,7 +62,7 @@ compare_tcp_check(const checker_t *old_c, checker_t *new_c)
 	return compare_conn_opts(old_c->co, new_c->co);
 }
 
-static const checker_funcs_t tcp_checker_funcs = { CHECKER_TCP, free_tcp_check, dump_tcp_check, compare_tcp_check, NULL };
+static const checker_funcs_t tcp_checker_funcs = { CHECKER_TCP, free_tcp_check, dump_tcp_check, compare_tcp_check, NULL, compare_tcp_check };
 
 static void
 tcp_check_handler(__attribute__((unused)) const vector_t *strvec)
@@ -143,6 +143,7 @@ tcp_epilog(thread_ref_t thread, bool is_success)
 	checker->has_run = true;
 
 	/* Register next timer checker */
+	checker_limit_end(checker);
 	thread_add_timer(thread->master, tcp_connect_thread, checker, delay);
 }
 
@@ -163,6 +164,9 @@ tcp_check_thread(thread_ref_t thread)
 		break;
 	case connect_success:
 		thread_close_fd(thread);
+		checker_tcp_connected(checker);
+		checker_latency_record(checker, CHECKER_LATENCY_CONNECT);
+		checker_latency_record(checker, CHECKER_LATENCY_TOTAL);
 		tcp_epilog(thread, true);
 		break;
 	case connect_timeout:
@@ -194,13 +198,18 @@ tcp_connect_thread(thread_ref_t thread)
 	 * if checker is disabled
 	 */
 	if (!checker->enabled) {
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, tcp_connect_thread, checker,
 				 checker->delay_loop);
 		return;
 	}
 
+	if (!checker_limit_start(thread))
+		return;
+
 	if ((fd = socket(co->dst.ss_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_TCP)) == -1) {
 		log_message(LOG_INFO, "TCP connect fail to create socket. Rescheduling.");
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, tcp_connect_thread, checker,
 				checker->delay_loop);
 
@@ -218,6 +227,7 @@ tcp_connect_thread(thread_ref_t thread)
 			tcp_epilog(thread, false);
 		} else {
 			log_message(LOG_INFO, "TCP socket bind failed. Rescheduling.");
+			checker_limit_end(checker);
 			thread_add_timer(thread->master, tcp_connect_thread, checker,
 					checker->delay_loop);
 		}
@@ -24,6 +24,7 @@
 
 /* system includes */
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 /* local includes */
@@ -84,7 +85,34 @@ compare_udp_check(const checker_t *a, checker_t *b)
 	return compare_conn_opts(a->co, b->co);
 }
 
-static const checker_funcs_t udp_checker_funcs = { CHECKER_UDP, free_udp_check, dump_udp_check, compare_udp_check, NULL };
+static bool
+same_udp_check(const checker_t *a, checker_t *b)
+{
+	const udp_check_t *ua = CHECKER_ARG(a);
+	const udp_check_t *ub = CHECKER_ARG(b);
+
+	if (!compare_conn_opts(a->co, b->co))
+		return false;
+	if (ua->payload_len != ub->payload_len ||
+	    !ua->payload != !ub->payload ||
+	    (ua->payload && memcmp(ua->payload, ub->payload, ua->payload_len)))
+		return false;
+	if (ua->require_reply != ub->require_reply ||
+	    ua->min_reply_len != ub->min_reply_len ||
+	    ua->max_reply_len != ub->max_reply_len ||
+	    ua->reply_len != ub->reply_len)
+		return false;
+	if (!ua->reply_data != !ub->reply_data ||
+	    (ua->reply_data && memcmp(ua->reply_data, ub->reply_data, ua->reply_len)))
+		return false;
+	if (!ua->reply_mask != !ub->reply_mask ||
+	    (ua->reply_mask && memcmp(ua->reply_mask, ub->reply_mask, ua->reply_len)))
+		return false;
+
+	return true;
+}
+
+static const checker_funcs_t udp_checker_funcs = { CHECKER_UDP, free_udp_check, dump_udp_check, compare_udp_check, NULL, same_udp_check };
 
 static void
 udp_check_handler(__attribute__((unused)) const vector_t *strvec)
@@ -208,6 +236,9 @@ udp_epilog(thread_ref_t thread, bool is_success)
 
 	checker = THREAD_ARG(thread);
 
+	if (is_success)
+		checker_latency_record(checker, CHECKER_LATENCY_TOTAL);
+
 	delay = checker->delay_loop;
 	if (is_success || ((checker->is_up || !checker->has_run) && checker->retry_it >= checker->retry)) {
 		checker->retry_it = 0;
@@ -248,6 +279,7 @@ udp_epilog(thread_ref_t thread, bool is_success)
 
 	checker->has_run = true;
 
+	checker_limit_end(checker);
 	thread_add_timer(thread->master, udp_connect_thread, checker, delay);
 }
 
@@ -331,13 +363,18 @@ udp_connect_thread(thread_ref_t thread)
 	 * if checker is disabled
 	 */
 	if (!checker->enabled) {
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, udp_connect_thread, checker,
 				 checker->delay_loop);
 		return;
 	}
 
+	if (!checker_limit_start(thread))
+		return;
+
 	if ((fd = socket(co->dst.ss_family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_UDP)) == -1) {
 		log_message(LOG_INFO, "UDP connect fail to create socket. Rescheduling.");
+		checker_limit_end(checker);
 		thread_add_timer(thread->master, udp_connect_thread, checker,
 				checker->delay_loop);
 
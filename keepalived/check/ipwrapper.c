@@ -24,6 +24,7 @@
 
 #include <unistd.h>
 #include <inttypes.h>
+#include <stdlib.h>
 
 #include "ipwrapper.h"
 #include "check_api.h"
@@ -41,6 +42,7 @@
 #include "check_nftables.h"
 #include "check_data.h"
 #endif
+#include "check_stats_shm.h"
 
 static bool __attribute((pure))
 vs_iseq(const virtual_server_t *vs_a, const virtual_server_t *vs_b)
@@ -621,6 +623,8 @@ perform_svr_state(bool alive, checker_t *checker)
 	 * but is now up, this is where the rs is added. */
 	update_quorum_state(vs, false);
 
+	check_stats_shm_update(vs, rs);
+
 	return true;
 }
 
@@ -720,7 +724,100 @@ update_svr_wgt(int64_t weight, virtual_server_t * vs, real_server_t * rs
 			ipvs_cmd(LVS_CMD_EDIT_DEST, vs, rs);
 		if (update_quorum)
 			update_quorum_state(vs, false);
+
+		check_stats_shm_update(vs, rs);
+	}
+}
+
+static int
+latency_cmp(const void *a, const void *b)
+{
+	return less_equal_greater_than(*(const unsigned long *)a, *(const unsigned long *)b);
+}
+
+/* Scale down the weight of each real server whose recent p90 check time
+ * is more than LATENCY_WEIGHT_MARGIN percent above the median of its alive
+ * peers, in steps of LATENCY_WEIGHT_STEP percent so that small variations
+ * don't keep changing it. */
+void
+update_latency_weights(virtual_server_t *vs)
+{
+	real_server_t *rs;
+	unsigned long *latencies;
+	unsigned long median = 0;
+	unsigned num = 0, num_rs = 0;
+	unsigned pct;
+	int64_t weight, adj;
+
+	list_for_each_entry(rs, &vs->rs, e_list)
+		num_rs++;
+
+	latencies = MALLOC(num_rs * sizeof(*latencies));
+	list_for_each_entry(rs, &vs->rs, e_list) {
+		if (ISALIVE(rs) && rs->latency_p90)
+			latencies[num++] = rs->latency_p90;
+	}
+	if (num >= 2) {
+		qsort(latencies, num, sizeof(*latencies), latency_cmp);
+		median = latencies[num / 2];
+	}
+	FREE(latencies);
+	vs->latency_median = median;
+
+	list_for_each_entry(rs, &vs->rs, e_list) {
+		weight = rs->effective_weight - rs->latency_weight_adj;
+		adj = 0;
+
+		if (median && weight > 0 && ISALIVE(rs) &&
+		    rs->latency_p90 > median + median * LATENCY_WEIGHT_MARGIN / 100) {
+			pct = (unsigned)(median * 100 / rs->latency_p90);
+			pct -= pct % LATENCY_WEIGHT_STEP;
+			adj = weight * pct / 100 - weight;
+			if (weight + adj < 1)
+				adj = 1 - weight;
+		}
+
+		if (adj != rs->latency_weight_adj) {
+			rs->latency_weight_adj = adj;
+			update_svr_wgt(weight + adj, vs, rs, true);
+		}
+	}
+}
+
+static void
+latency_weights_thread(thread_ref_t thread)
+{
+	virtual_server_t *vs = THREAD_ARG(thread);
+
+	vs->latency_weight_thread = NULL;
+	update_latency_weights(vs);
+}
+
+/* Called after a check of rs completes. The weights are recalculated at
+ * most every LATENCY_WEIGHT_INTERVAL, unless rs has moved across the
+ * threshold for being slow, in which case they are recalculated now. */
+void
+rs_latency_updated(virtual_server_t *vs, real_server_t *rs)
+{
+	unsigned long old_latency = rs->latency_p90;
+	unsigned long threshold;
+
+	rs->latency_p90 = rs_checker_latency(rs, 90);
+
+	if (!vs->latency_weight)
+		return;
+
+	threshold = vs->latency_median + vs->latency_median * LATENCY_WEIGHT_MARGIN / 100;
+	if (vs->latency_median &&
+	    (old_latency > threshold) != (rs->latency_p90 > threshold)) {
+		thread_cancel(vs->latency_weight_thread);
+		vs->latency_weight_thread = NULL;
+		update_latency_weights(vs);
+		return;
 	}
+
+	if (!vs->latency_weight_thread)
+		vs->latency_weight_thread = thread_add_timer(master, latency_weights_thread, vs, LATENCY_WEIGHT_INTERVAL);
 }
 
 void
@@ -735,11 +832,13 @@ set_checker_state(checker_t *checker, bool up)
 		checker->rs->num_failed_checkers++;
 	else if (checker->rs->num_failed_checkers)
 		checker->rs->num_failed_checkers--;
+
+	check_stats_shm_update(checker->vs, checker->rs);
 }
 
 /* Update checker's state */
-void
-update_svr_checker_state(bool alive, checker_t *checker)
+static void
+update_one_svr_checker_state(bool alive, checker_t *checker)
 {
 	if (checker->is_up == alive) {
 		if (!checker->has_run) {
@@ -770,6 +869,18 @@ update_svr_checker_state(bool alive, checker_t *checker)
 	set_checker_state(checker, alive);
 }
 
+void
+update_svr_checker_state(bool alive, checker_t *checker)
+{
+	checker_t *dup;
+
+	update_one_svr_checker_state(alive, checker);
+
+	/* Pass the result on to any identical checkers that don't run themselves */
+	list_for_each_entry(dup, &checker->dups, dup_list)
+		update_one_svr_checker_state(alive, dup);
+}
+
 /* Check if a vsg entry is in new data */
 static virtual_server_group_entry_t * __attribute__ ((pure))
 vsge_exist(virtual_server_group_entry_t *vsg_entry, list_head_t *l)
@@ -976,6 +1087,12 @@ migrate_checkers(virtual_server_t *vs, real_server_t *old_rs, real_server_t *new
 					if (new_c->checker_funcs->migrate)
 						new_c->checker_funcs->migrate(new_c, old_c);
 
+					/* Keep the latency history */
+					if (!new_c->latency) {
+						new_c->latency = old_c->latency;
+						old_c->latency = NULL;
+					}
+
 					break;
 				}
 			}
@@ -1047,6 +1164,8 @@ clear_diff_rs(virtual_server_t *old_vs, virtual_server_t *new_vs)
 		new_rs->set = rs->set;
 		new_rs->effective_weight = rs->effective_weight;
 		new_rs->peffective_weight = rs->effective_weight;
+		if (new_vs->latency_weight)
+			new_rs->latency_weight_adj = rs->latency_weight_adj;
 		new_rs->reloaded = true;
 
 		/*
@@ -1276,3 +1395,11 @@ link_vsg_to_vs(void)
 		}
 	}
 }
+
+#ifdef THREAD_DUMP
+void
+register_ipwrapper_addresses(void)
+{
+	register_thread_address("latency_weights_thread", latency_weights_thread);
+}
+#endif
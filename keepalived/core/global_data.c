@@ -33,6 +33,7 @@
 #include "utils.h"
 #include "main.h"
 #include "memory.h"
+#include "stats_shm.h"
 #ifdef _WITH_VRRP_
 #include "vrrp.h"
 #include "vrrp_ipaddress.h"
@@ -177,7 +178,7 @@ format_email_addr(const char *addr)
 	        *end_description == '\t'))
 	       end_description--;
 
-	/* We can't have a '"' because alloc_strvec_r() doesn't support it.
+	/* We can't have a '"' because alloc_strvec_arena() doesn't support it.
 	 * We might be able to use alloc_strvec_quoted_escaped(), in which
 	 * case we probably can have embedded '"'s. */
 
@@ -301,6 +302,8 @@ alloc_global_data(void)
 	new->json_version = JSON_VERSION_V1;
 #endif
 
+	new->stats_shm_refresh = STATS_SHM_REFRESH;
+
 	return new;
 }
 
@@ -522,6 +525,12 @@ free_global_data(data_t **datap)
 	FREE_CONST_PTR(data->state_dump_file);
 	FREE_CONST_PTR(data->stats_dump_file);
 	FREE_CONST_PTR(data->json_dump_file);
+#ifdef _WITH_VRRP_
+	FREE_CONST_PTR(data->vrrp_stats_shm);
+#endif
+#ifdef _WITH_LVS_
+	FREE_CONST_PTR(data->checker_stats_shm);
+#endif
 
 	FREE(data);
 
@@ -691,6 +700,13 @@ dump_global_data(FILE *fp, data_t * data)
 	conf_write(fp, " Default smtp_alert_checker = %s",
 			data->smtp_alert_checker == -1 ? "unset" : data->smtp_alert_checker ? "on" : "off");
 	conf_write(fp, " Checkers log all failures = %s", data->checker_log_all_failures ? "true" : "false");
+	conf_write(fp, " Checker deduplication = %s", data->checker_deduplicate ? "true" : "false");
+	if (data->checker_max_in_flight)
+		conf_write(fp, " Checker max in flight = %u", data->checker_max_in_flight);
+	conf_write(fp, " Checker spread start = %s", data->checker_spread_start ? "true" : "false");
+	conf_write(fp, " Checker close with RST = %s", data->checker_close_rst ? "true" : "false");
+	if (data->dns_check_socket_pool)
+		conf_write(fp, " DNS_CHECK socket pool = %u sockets per address family", data->dns_check_socket_pool);
 #endif
 #ifndef _ONE_PROCESS_DEBUG_
 	if (data->reload_check_config)
@@ -809,8 +825,13 @@ dump_global_data(FILE *fp, data_t * data)
 #endif
 	conf_write(fp, " Send advert after receive lower priority advert = %s", data->vrrp_lower_prio_no_advert ? "false" : "true");
 	conf_write(fp, " Send advert after receive higher priority advert = %s", data->vrrp_higher_prio_send_advert ? "true" : "false");
+	conf_write(fp, " Align master advert timers = %s", data->vrrp_advert_align ? "true" : "false");
+	if (data->vrrp_advert_align)
+		conf_write(fp, " Advert alignment jitter = %f", data->vrrp_advert_align_jitter / TIMER_HZ_DOUBLE);
 	conf_write(fp, " Gratuitous ARP interval = %f", data->vrrp_garp_interval / TIMER_HZ_DOUBLE);
 	conf_write(fp, " Gratuitous NA interval = %f", data->vrrp_gna_interval / TIMER_HZ_DOUBLE);
+	if (data->vrrp_garp_rate)
+		conf_write(fp, " Gratuitous ARP/NA rate = %u/s, burst %u", data->vrrp_garp_rate, data->vrrp_garp_burst);
 	conf_write(fp, " VRRP default protocol version = %d", data->vrrp_version);
 #ifdef _WITH_IPTABLES_
 	if (data->vrrp_iptables_inchain) {
@@ -875,6 +896,14 @@ dump_global_data(FILE *fp, data_t * data)
 		conf_write(fp, " VRRP CPU Affinity = %s", cpu_str);
 	}
 	conf_write(fp, " VRRP realtime limit = %" PRI_rlim_t, data->vrrp_rlimit_rt);
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	if (data->vrrp_advert_thread) {
+		if (data->vrrp_advert_thread_priority)
+			conf_write(fp, " VRRP advert thread priority = %u", data->vrrp_advert_thread_priority);
+		else
+			conf_write(fp, " VRRP advert thread priority = auto");
+	}
+#endif
 #endif
 #ifdef _WITH_LVS_
 	conf_write(fp, " Checker process priority = %d", data->checker_process_priority);
@@ -953,6 +982,11 @@ dump_global_data(FILE *fp, data_t * data)
 	if (buf[0])
 		conf_write(fp, "%s", buf);
 	conf_write(fp, " rx_bufs_multiples = %d", global_data->vrrp_rx_bufs_multiples);
+#ifdef _WITH_VRRP_RX_RING_
+	if (global_data->vrrp_rx_ring)
+		conf_write(fp, " rx_ring block size = %u, blocks = %u, timeout = %ums", global_data->vrrp_rx_ring_block_size,
+			   global_data->vrrp_rx_ring_block_nr, global_data->vrrp_rx_ring_timeout);
+#endif
 	conf_write(fp, " umask = 0%o", umask_val);
 	if (global_data->vrrp_startup_delay)
 		conf_write(fp, " vrrp_startup_delay = %g", global_data->vrrp_startup_delay / TIMER_HZ_DOUBLE);
@@ -984,4 +1018,13 @@ dump_global_data(FILE *fp, data_t * data)
 		conf_write(fp, " stats dump file %s", global_data->stats_dump_file);
 	if (global_data->json_dump_file)
 		conf_write(fp, " json dump file %s", global_data->json_dump_file);
+#ifdef _WITH_VRRP_
+	if (global_data->vrrp_stats_shm)
+		conf_write(fp, " vrrp stats shm file %s", global_data->vrrp_stats_shm);
+#endif
+#ifdef _WITH_LVS_
+	if (global_data->checker_stats_shm)
+		conf_write(fp, " checker stats shm file %s", global_data->checker_stats_shm);
+#endif
+	conf_write(fp, " stats shm refresh = %gs", global_data->stats_shm_refresh / TIMER_HZ_DOUBLE);
 }
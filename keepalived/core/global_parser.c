@@ -49,12 +49,16 @@
 #include "utils.h"
 #include "logger.h"
 #include "bitops.h"
+#include "stats_shm.h"
 #ifdef _WITH_FIREWALL_
 #include "vrrp_firewall.h"
 #endif
 #include "memory.h"
 #ifdef _WITH_VRRP_
 #include "vrrp_daemon.h"
+#ifdef _WITH_VRRP_RX_RING_
+#include "vrrp_rx_ring.h"
+#endif
 #ifdef _WITH_NFTABLES_
 #include "vrrp_nftables.h"
 #endif
@@ -464,6 +468,90 @@ checker_log_all_failures_handler(const vector_t *strvec)
 
 	global_data->checker_log_all_failures = res;
 }
+
+static void
+checker_deduplicate_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec,1));
+		if (res < 0) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid value for checker_deduplicate specified");
+			return;
+		}
+	}
+
+	global_data->checker_deduplicate = res;
+}
+
+static void
+checker_max_in_flight_handler(const vector_t *strvec)
+{
+	unsigned num;
+
+	if (vector_size(strvec) < 2) {
+		report_config_error(CONFIG_GENERAL_ERROR, "checker_max_in_flight requires a number of checks");
+		return;
+	}
+
+	if (!read_unsigned_strvec(strvec, 1, &num, 0, UINT_MAX, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "checker_max_in_flight '%s' invalid - ignoring", strvec_slot(strvec, 1));
+		return;
+	}
+
+	global_data->checker_max_in_flight = num;
+}
+
+static void
+checker_spread_start_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec,1));
+		if (res < 0) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid value for checker_spread_start specified");
+			return;
+		}
+	}
+
+	global_data->checker_spread_start = res;
+}
+
+static void
+checker_close_rst_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec,1));
+		if (res < 0) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid value for checker_close_rst specified");
+			return;
+		}
+	}
+
+	global_data->checker_close_rst = res;
+}
+
+static void
+dns_check_socket_pool_handler(const vector_t *strvec)
+{
+	unsigned num;
+
+	if (vector_size(strvec) < 2) {
+		report_config_error(CONFIG_GENERAL_ERROR, "dns_check_socket_pool requires a number of sockets");
+		return;
+	}
+
+	if (!read_unsigned_strvec(strvec, 1, &num, 0, 256, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "dns_check_socket_pool '%s' must be in [0, 256] - ignoring", strvec_slot(strvec, 1));
+		return;
+	}
+
+	global_data->dns_check_socket_pool = num;
+}
 #endif
 
 #ifdef _WITH_VRRP_
@@ -985,6 +1073,25 @@ vrrp_gna_interval_handler(const vector_t *strvec)
 		log_message(LOG_INFO, "The vrrp_gna_interval is very large - %s seconds", strvec_slot(strvec, 1));
 }
 static void
+vrrp_garp_rate_handler(const vector_t *strvec)
+{
+	unsigned rate, burst = 1;
+
+	if (!read_unsigned_strvec(strvec, 1, &rate, 1, TIMER_HZ, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "vrrp_garp_rate '%s' is invalid", strvec_slot(strvec, 1));
+		return;
+	}
+
+	if (vector_size(strvec) >= 3 &&
+	    !read_unsigned_strvec(strvec, 2, &burst, 1, GARP_MAX_BURST, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "vrrp_garp_rate burst '%s' is invalid", strvec_slot(strvec, 2));
+		return;
+	}
+
+	global_data->vrrp_garp_rate = rate;
+	global_data->vrrp_garp_burst = burst;
+}
+static void
 vrrp_min_garp_handler(const vector_t *strvec)
 {
 	int res = false;
@@ -1071,6 +1178,21 @@ vrrp_higher_prio_send_advert_handler(const vector_t *strvec)
 	else
 		global_data->vrrp_higher_prio_send_advert = true;
 }
+static void
+vrrp_advert_align_handler(const vector_t *strvec)
+{
+	unsigned jitter;
+
+	global_data->vrrp_advert_align = true;
+
+	if (vector_size(strvec) < 2)
+		return;
+
+	if (!read_decimal_unsigned_strvec(strvec, 1, &jitter, 0, TIMER_MAX_SEC * TIMER_HZ, TIMER_HZ_DIGITS, true))
+		report_config_error(CONFIG_GENERAL_ERROR, "vrrp_advert_align jitter '%s' is invalid", strvec_slot(strvec, 1));
+	else
+		global_data->vrrp_advert_align_jitter = jitter;
+}
 #endif
 
 #if defined _WITH_IPTABLES_ || defined _WITH_NFTABLES_
@@ -1447,6 +1569,22 @@ vrrp_rt_priority_handler(const vector_t *strvec)
 	if (priority >= 0)
 		global_data->vrrp_realtime_priority = priority;
 }
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+static void
+vrrp_advert_thread_handler(const vector_t *strvec)
+{
+	int priority;
+
+	global_data->vrrp_advert_thread = true;
+
+	if (vector_size(strvec) < 2)
+		return;
+
+	priority = get_realtime_priority(strvec, "vrrp advert thread");
+	if (priority >= 0)
+		global_data->vrrp_advert_thread_priority = priority;
+}
+#endif
 static void
 vrrp_cpu_affinity_handler(const vector_t *strvec)
 {
@@ -1921,6 +2059,39 @@ vrrp_rx_bufs_multiplier_handler(const vector_t *strvec)
 	else
 		global_data->vrrp_rx_bufs_multiples = rx_buf_mult;
 }
+
+#ifdef _WITH_VRRP_RX_RING_
+static void
+vrrp_rx_ring_handler(const vector_t *strvec)
+{
+	unsigned block_size = VRRP_RX_RING_BLOCK_SIZE;
+	unsigned block_nr = VRRP_RX_RING_BLOCK_NR;
+	unsigned timeout = VRRP_RX_RING_TIMEOUT;
+
+	if (vector_size(strvec) >= 2 &&
+	    !read_unsigned_strvec(strvec, 1, &block_size, 4096, 1U << 24, false)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "vrrp_rx_ring block size '%s' is invalid", strvec_slot(strvec, 1));
+		return;
+	}
+
+	if (vector_size(strvec) >= 3 &&
+	    !read_unsigned_strvec(strvec, 2, &block_nr, 2, 1024, false)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "vrrp_rx_ring block count '%s' is invalid", strvec_slot(strvec, 2));
+		return;
+	}
+
+	if (vector_size(strvec) >= 4 &&
+	    !read_unsigned_strvec(strvec, 3, &timeout, 1, 1000, false)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "vrrp_rx_ring timeout '%s' is invalid", strvec_slot(strvec, 3));
+		return;
+	}
+
+	global_data->vrrp_rx_ring = true;
+	global_data->vrrp_rx_ring_block_size = block_size;
+	global_data->vrrp_rx_ring_block_nr = block_nr;
+	global_data->vrrp_rx_ring_timeout = timeout;
+}
+#endif
 #endif
 
 #if defined _WITH_VRRP_ || defined _WITH_LVS_
@@ -2522,6 +2693,48 @@ json_dump_file_handler(const vector_t *strvec)
 	global_data->json_dump_file = STRDUP(strvec_slot(strvec, 1));
 }
 
+static void
+stats_shm_file(const vector_t *strvec, const char **file, const char *default_file)
+{
+	if (vector_size(strvec) > 2 ||
+	    (vector_size(strvec) == 2 && strvec_slot(strvec, 1)[0] != '/')) {
+		report_config_error(CONFIG_GENERAL_ERROR, "%s requires an absolute path", strvec_slot(strvec, 0));
+		return;
+	}
+
+	FREE_CONST_PTR(*file);
+	*file = STRDUP(vector_size(strvec) == 2 ? strvec_slot(strvec, 1) : default_file);
+}
+
+#ifdef _WITH_VRRP_
+static void
+vrrp_stats_shm_handler(const vector_t *strvec)
+{
+	stats_shm_file(strvec, &global_data->vrrp_stats_shm, VRRP_STATS_SHM_FILE);
+}
+#endif
+
+#ifdef _WITH_LVS_
+static void
+checker_stats_shm_handler(const vector_t *strvec)
+{
+	stats_shm_file(strvec, &global_data->checker_stats_shm, CHECKER_STATS_SHM_FILE);
+}
+#endif
+
+static void
+stats_shm_refresh_handler(const vector_t *strvec)
+{
+	unsigned long interval;
+
+	/* Valid range is 10 ms to 1 hour */
+	if (vector_size(strvec) >= 2 &&
+	    read_timer(strvec, 1, &interval, TIMER_HZ / 100, 3600UL * TIMER_HZ, true))
+		global_data->stats_shm_refresh = interval;
+	else
+		report_config_error(CONFIG_GENERAL_ERROR, "stats_shm_refresh '%s' invalid - ignoring", vector_size(strvec) >= 2 ? strvec_slot(strvec, 1) : "");
+}
+
 void
 init_global_keywords(bool global_active)
 {
@@ -2568,6 +2781,11 @@ init_global_keywords(bool global_active)
 #ifdef _WITH_LVS_
 	install_keyword("smtp_alert_checker", &smtp_alert_checker_handler);
 	install_keyword("checker_log_all_failures", &checker_log_all_failures_handler);
+	install_keyword("checker_deduplicate", &checker_deduplicate_handler);
+	install_keyword("checker_max_in_flight", &checker_max_in_flight_handler);
+	install_keyword("checker_spread_start", &checker_spread_start_handler);
+	install_keyword("checker_close_rst", &checker_close_rst_handler);
+	install_keyword("dns_check_socket_pool", &dns_check_socket_pool_handler);
 #endif
 #ifdef _WITH_VRRP_
 	install_keyword("dynamic_interfaces", &dynamic_interfaces_handler);
@@ -2597,6 +2815,7 @@ init_global_keywords(bool global_active)
 	install_keyword("vrrp_down_timer_adverts", &vrrp_down_timer_adverts_handler);
 	install_keyword("vrrp_garp_interval", &vrrp_garp_interval_handler);
 	install_keyword("vrrp_gna_interval", &vrrp_gna_interval_handler);
+	install_keyword("vrrp_garp_rate", &vrrp_garp_rate_handler);
 	install_keyword("vrrp_min_garp", &vrrp_min_garp_handler);
 #ifdef _HAVE_VRRP_VMAC_
 	install_keyword("vrrp_garp_extra_if", &vrrp_vmac_garp_extra_if_handler);
@@ -2604,6 +2823,7 @@ init_global_keywords(bool global_active)
 #endif
 	install_keyword("vrrp_lower_prio_no_advert", &vrrp_lower_prio_no_advert_handler);
 	install_keyword("vrrp_higher_prio_send_advert", &vrrp_higher_prio_send_advert_handler);
+	install_keyword("vrrp_advert_align", &vrrp_advert_align_handler);
 	install_keyword("vrrp_version", &vrrp_version_handler);
 #if defined _WITH_IPTABLES_ || defined _WITH_NFTABLES_
 	/* We keep the vrrp_iptables command for legacy reasons, and
@@ -2625,6 +2845,9 @@ init_global_keywords(bool global_active)
 	install_keyword("vrrp_priority", &vrrp_prio_handler);
 	install_keyword("vrrp_no_swap", &vrrp_no_swap_handler);
 	install_keyword("vrrp_rt_priority", &vrrp_rt_priority_handler);
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	install_keyword("vrrp_advert_thread", &vrrp_advert_thread_handler);
+#endif
 	install_keyword("vrrp_cpu_affinity", &vrrp_cpu_affinity_handler);
 	install_keyword("vrrp_rlimit_rttime", &vrrp_rt_rlimit_handler);
 	install_keyword("vrrp_rlimit_rtime", &vrrp_rt_rlimit_handler);		/* Deprecated 02/02/2020 */
@@ -2715,6 +2938,9 @@ init_global_keywords(bool global_active)
 #ifdef _WITH_VRRP_
 	install_keyword("vrrp_rx_bufs_policy", &vrrp_rx_bufs_policy_handler);
 	install_keyword("vrrp_rx_bufs_multiplier", &vrrp_rx_bufs_multiplier_handler);
+#ifdef _WITH_VRRP_RX_RING_
+	install_keyword("vrrp_rx_ring", &vrrp_rx_ring_handler);
+#endif
 	install_keyword("vrrp_startup_delay", &vrrp_startup_delay_handler);
 	install_keyword("log_unknown_vrids", &vrrp_log_unknown_vrids_handler);
 	install_keyword("vrrp_owner_ignore_adverts", &vrrp_owner_ignore_adverts_handler);
@@ -2745,4 +2971,11 @@ init_global_keywords(bool global_active)
 	install_keyword("state_dump_file", &state_dump_file_handler);
 	install_keyword("stats_dump_file", &stats_dump_file_handler);
 	install_keyword("json_dump_file", &json_dump_file_handler);
+#ifdef _WITH_VRRP_
+	install_keyword("vrrp_stats_shm", &vrrp_stats_shm_handler);
+#endif
+#ifdef _WITH_LVS_
+	install_keyword("checker_stats_shm", &checker_stats_shm_handler);
+#endif
+	install_keyword("stats_shm_refresh", &stats_shm_refresh_handler);
 }
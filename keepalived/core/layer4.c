@@ -76,6 +76,22 @@ set_buf(char *buf, size_t buf_len)
 }
 #endif
 
+/* If the source port is left to the kernel, don't reserve an ephemeral
+ * port at bind() time, so that it can be shared between destinations */
+static void
+set_bind_address_no_port(int fd, const sockaddr_t *bind_addr)
+{
+#ifdef IP_BIND_ADDRESS_NO_PORT
+	int on = 1;
+
+	if (inet_sockaddrport(bind_addr))
+		return;
+
+	/* Not supported before Linux 4.2, when we just use a port as before */
+	setsockopt(fd, SOL_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof(on));
+#endif
+}
+
 #ifndef _WITH_LVS_
 static
 #endif
@@ -111,8 +127,17 @@ socket_bind_connect(int fd, conn_opts_t *co)
 		}
 	}
 
+	/* Abort the connection when it is closed, so it doesn't sit in TIME_WAIT */
+	if (co->close_rst > 0 && opt == SOCK_STREAM) {
+		struct linger lin = { .l_onoff = 1, .l_linger = 0 };
+
+		if (setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin)) < 0)
+			log_message(LOG_INFO, "Checker can't set SO_LINGER: %s", strerror(errno));
+	}
+
 	/* Bind socket */
 	if (PTR_CAST_CONST(struct sockaddr, bind_addr)->sa_family != AF_UNSPEC) {
+		set_bind_address_no_port(fd, bind_addr);
 		addrlen = sizeof(*bind_addr);
 		if (bind(fd, PTR_CAST_CONST(struct sockaddr, bind_addr), addrlen) != 0) {
 			log_message(LOG_INFO, "Checker bind failed: %s", strerror(errno));
@@ -257,6 +282,7 @@ udp_bind_connect(int fd, conn_opts_t *co, uint8_t *payload, uint16_t payload_len
 
 	/* Bind socket */
 	if (PTR_CAST_CONST(struct sockaddr, bind_addr)->sa_family != AF_UNSPEC) {
+		set_bind_address_no_port(fd, bind_addr);
 		addrlen = sizeof(*bind_addr);
 		if (bind(fd, PTR_CAST_CONST(struct sockaddr, bind_addr), addrlen) != 0) {
 			log_message(LOG_INFO, "bind failed. errno: %d, error: %s", errno, strerror(errno));
@@ -0,0 +1,137 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Shared memory live statistics files.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stats_shm.h"
+#include "logger.h"
+#include "memory.h"
+#include "timer.h"
+
+/* The records are written from the main thread only, and the file is
+ * created under a temporary name and then renamed so that a reader
+ * never sees a partially initialised header. */
+stats_shm_t *
+stats_shm_create(const char *file_name, enum stats_shm_type type, size_t rec_size, unsigned num_recs)
+{
+	stats_shm_t *shm;
+	stats_shm_hdr_t *hdr;
+	char *tmp_name;
+	size_t len;
+	size_t size;
+	int fd;
+
+	rec_size = (rec_size + STATS_SHM_ALIGN - 1) & ~(size_t)(STATS_SHM_ALIGN - 1);
+	size = STATS_SHM_ALIGN + rec_size * num_recs;
+
+	len = strlen(file_name) + 5;
+	tmp_name = MALLOC(len);
+	snprintf(tmp_name, len, "%s.new", file_name);
+
+	unlink(tmp_name);
+	fd = open(tmp_name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd == -1) {
+		log_message(LOG_INFO, "Unable to create stats file %s - errno %d (%m)", tmp_name, errno);
+		FREE(tmp_name);
+		return NULL;
+	}
+
+	if (ftruncate(fd, (off_t)size)) {
+		log_message(LOG_INFO, "Unable to size stats file %s - errno %d (%m)", tmp_name, errno);
+		goto err;
+	}
+
+	hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		log_message(LOG_INFO, "Unable to map stats file %s - errno %d (%m)", tmp_name, errno);
+		goto err;
+	}
+	close(fd);
+
+	hdr->magic = STATS_SHM_MAGIC;
+	hdr->version = STATS_SHM_VERSION;
+	hdr->type = type;
+	hdr->hdr_size = STATS_SHM_ALIGN;
+	hdr->rec_size = (uint32_t)rec_size;
+	hdr->num_recs = num_recs;
+	hdr->pid = getpid();
+
+	if (rename(tmp_name, file_name)) {
+		log_message(LOG_INFO, "Unable to rename stats file %s - errno %d (%m)", tmp_name, errno);
+		munmap(hdr, size);
+		unlink(tmp_name);
+		FREE(tmp_name);
+		return NULL;
+	}
+	FREE(tmp_name);
+
+	PMALLOC(shm);
+	shm->file_name = STRDUP(file_name);
+	shm->hdr = hdr;
+	shm->size = size;
+
+	return shm;
+
+  err:
+	close(fd);
+	unlink(tmp_name);
+	FREE(tmp_name);
+
+	return NULL;
+}
+
+/* Mark the segment stale for any readers, and remove it if it is not being replaced */
+void
+stats_shm_close(stats_shm_t **shmp, bool remove)
+{
+	stats_shm_t *shm = *shmp;
+
+	if (!shm)
+		return;
+
+	__atomic_store_n(&shm->hdr->flags, shm->hdr->flags | STATS_SHM_STALE, __ATOMIC_RELEASE);
+	munmap(shm->hdr, shm->size);
+
+	if (remove)
+		unlink(shm->file_name);
+
+	FREE_CONST(shm->file_name);
+	FREE(shm);
+
+	*shmp = NULL;
+}
+
+void
+stats_shm_set_update_time(stats_shm_t *shm)
+{
+	stats_shm_write_begin(&shm->hdr->seq);
+	shm->hdr->update_time = stats_shm_timeval(&time_now);
+	stats_shm_write_end(&shm->hdr->seq);
+}
@@ -27,6 +27,7 @@
 
 /* global includes */
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/socket.h>
 
@@ -51,6 +52,30 @@ typedef enum _checker_type {
 } checker_type_t;
 
 
+/* Checker latency phases, each measured from the start of the check */
+typedef enum _checker_latency_phase {
+	CHECKER_LATENCY_CONNECT,
+	CHECKER_LATENCY_TLS,
+	CHECKER_LATENCY_FIRST_BYTE,
+	CHECKER_LATENCY_TOTAL,
+	CHECKER_LATENCY_PHASES
+} checker_latency_phase_t;
+
+/* Bucket 0 is < 64us, and each following bucket is twice as wide as the
+ * one before, with the last bucket holding everything >= 2^24us */
+#define CHECKER_LATENCY_BUCKETS		20
+#define CHECKER_LATENCY_MIN_SHIFT	6
+#define CHECKER_LATENCY_RECENT		64	/* Recent samples are halved after this many */
+#define CHECKER_LATENCY_MIN_SAMPLES	16	/* Before a recent percentile is used */
+
+typedef struct _checker_latency {
+	uint64_t			count;
+	uint64_t			hist[CHECKER_LATENCY_BUCKETS];
+	unsigned long			max;			/* usecs */
+	unsigned			recent_count;
+	unsigned			recent[CHECKER_LATENCY_BUCKETS];
+} checker_latency_t;
+
 /* Forward reference */
 struct _checker;
 
@@ -60,6 +85,7 @@ typedef struct _checker_funcs {
 	void				(*dump_func) (FILE *, const struct _checker *);
 	bool				(*compare) (const struct _checker *, struct _checker *);
 	void				(*migrate) (struct _checker *, const struct _checker *);
+	bool				(*same_check) (const struct _checker *, struct _checker *);	/* NULL if never shared */
 } checker_funcs_t;
 
 /* Checkers structure definition */
@@ -84,6 +110,19 @@ typedef struct _checker {
 	unsigned long			default_delay_before_retry; /* interval between retries */
 	bool				log_all_failures;	/* Log all failures when checker up */
 
+	/* Identical checkers of other real servers only run one check */
+	struct _checker			*dup_of;		/* Checker whose result this one shares */
+	list_head_t			dups;			/* Checkers sharing this one's result */
+	list_head_t			dup_list;		/* Entry on dup_of->dups */
+
+	/* checker_max_in_flight */
+	bool				in_flight;		/* Holds a slot while its check runs */
+	list_head_t			wait_list;		/* Waiting for a slot */
+	timeval_t			wait_start;
+
+	timeval_t			check_start;
+	checker_latency_t		*latency;		/* [CHECKER_LATENCY_PHASES], allocated on first use */
+
 	/* Linked list of checkers from rs */
 	list_head_t			rs_list;
 } checker_t;
@@ -129,5 +168,12 @@ extern void install_checkers_keyword(void);
 extern void checker_set_dst_port(sockaddr_t *, uint16_t);
 extern void install_checker_common_keywords(bool);
 extern void update_checker_activity(sa_family_t, void *, bool);
+extern bool checker_limit_start(thread_ref_t);
+extern void checker_limit_end(checker_t *);
+extern void checker_limit_release(void);
+extern void checker_tcp_connected(const checker_t *);
+extern void checker_latency_record(checker_t *, checker_latency_phase_t);
+extern unsigned long checker_latency_percentile(const checker_t *, checker_latency_phase_t, unsigned, bool);
+extern unsigned long rs_checker_latency(const real_server_t *, unsigned);
 
 #endif
@@ -41,6 +41,7 @@
 #include "vector.h"
 #include "notify.h"
 #include "utils.h"
+#include "stats_shm.h"
 #ifdef _WITH_BFD_
 #include "check_bfd.h"
 #endif
@@ -68,6 +69,7 @@ typedef struct _ssl_data {
 	int				enable;
 	int				strong_check;
 	SSL_CTX				*ctx;
+	SSL_CTX				*resume_ctx;	/* For checkers with tls_session_cache */
 	const SSL_METHOD		*meth;
 	const char			*password;
 	const char			*cafile;
@@ -81,6 +83,8 @@ typedef struct _real_server {
 	int64_t				effective_weight;
 	int64_t				peffective_weight; /* previous weight
 							    * used for reloading */
+	int64_t				latency_weight_adj; /* Included in effective_weight */
+	unsigned long			latency_p90;	/* rs_checker_latency() p90, for latency_weight */
 	int				iweight;	/* Initial weight */
 	unsigned			forwarding_method; /* NAT/TUN/DR */
 #ifdef _HAVE_IPVS_TUN_TYPE_
@@ -127,6 +131,7 @@ typedef struct _real_server {
 #ifdef _WITH_BFD_
 	list_head_t			tracked_bfds;	/* cref_tracked_bfd_t */
 #endif
+	checker_shm_rec_t		*shm_rec;	/* Live stats record, if any */
 
 	/* Linked list member */
 	list_head_t			e_list;
@@ -210,6 +215,9 @@ typedef struct _virtual_server {
 	bool				omega;		/* Omega mode enabled. */
 	bool				inhibit;	/* Set weight to 0 instead of removing
 							 * the service from IPVS topology. */
+	bool				latency_weight;	/* Reduce weights of RSs with slow checks */
+	unsigned long			latency_median;	/* Median p90 at the last weight update */
+	thread_ref_t			latency_weight_thread;
 	unsigned int			connection_to;	/* connection time-out */
 	unsigned long			delay_loop;	/* Interval between running checker */
 	unsigned long			warmup;		/* max random timeout to start checker */
@@ -241,6 +249,7 @@ typedef struct _virtual_server {
 /* Configuration data root */
 typedef struct _check_data {
 	bool				ssl_required;
+	bool				tls_session_required;
 	ssl_data_t			*ssl;
 	list_head_t			vs_group;	/* virtual_server_group_t */
 	list_head_t			vs;		/* virtual_server_t */
@@ -250,6 +259,7 @@ typedef struct _check_data {
 #endif
 	unsigned			num_checker_fd_required;
 	unsigned			num_smtp_alert;
+	unsigned			num_dup_checkers;	/* Checkers sharing another's result */
 } check_data_t;
 
 /* macro utility */
@@ -28,6 +28,11 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include "check_api.h"
+#include "list_head.h"
+#include "rbtree_ka.h"
+#include "scheduler.h"
+
 #define DNS_DEFAULT_RETRY    3
 #define DNS_DEFAULT_TYPE  DNS_TYPE_SOA
 #define DNS_DEFAULT_NAME    ""
@@ -83,14 +88,31 @@ typedef struct _dns_header {
 	uint16_t arcount;
 } dns_header_t;
 
+/* A UDP socket shared by the DNS_CHECKs when dns_check_socket_pool is set */
+typedef struct _dns_pool_sock {
+	int fd;
+	thread_ref_t read_thread;
+	thread_ref_t send_thread;
+	list_head_t send_queue;		/* dns_check_t waiting to be sent */
+	rb_root_t pending;		/* dns_check_t awaiting a reply, by query id and server */
+} dns_pool_sock_t;
+
 typedef struct _dns_check {
 	uint16_t type;
 	const char *name;
 	uint8_t sbuf[DNS_BUFFER_SIZE] __attribute__((aligned(__alignof__(dns_header_t))));
 	size_t slen;
+
+	/* Pooled mode */
+	checker_t *checker;
+	dns_pool_sock_t *sock;
+	rb_node_t pending;
+	list_head_t e_list;		/* On sock->send_queue */
+	thread_ref_t timeout_thread;
 } dns_check_t;
 
 extern void install_dns_check_keyword(void);
+extern void checker_dns_dispatcher_release(void);
 #ifdef THREAD_DUMP
 extern void register_check_dns_addresses(void);
 #endif
@@ -27,6 +27,7 @@
 /* system includes */
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <openssl/evp.h>
 #include <openssl/ssl.h>
 #ifdef _WITH_REGEX_CHECK_
@@ -47,6 +48,20 @@ typedef enum {
         HTTP_PROTOCOL_1_1,
 } http_protocol_t;
 
+/* Progress through a chunked response body */
+typedef enum {
+	HTTP_CHUNK_SIZE,
+	HTTP_CHUNK_EXT,
+	HTTP_CHUNK_SIZE_LF,
+	HTTP_CHUNK_DATA,
+	HTTP_CHUNK_DATA_CR,
+	HTTP_CHUNK_DATA_LF,
+	HTTP_CHUNK_TRAILER,
+	HTTP_CHUNK_TRAILER_LINE,
+	HTTP_CHUNK_END_LF,
+	HTTP_CHUNK_DONE,
+} http_chunk_state_t;
+
 #define HTTP_STATUS_CODE_MIN		100
 #define HTTP_STATUS_CODE_MAX		599
 #define HTTP_DEFAULT_STATUS_CODE_MIN	200
@@ -65,6 +80,14 @@ typedef struct _request {
 	EVP_MD_CTX			*context;
 	size_t				content_len;
 	size_t				rx_bytes;
+	bool				head;		/* HEAD request */
+	bool				body_skipped;	/* Only the status was needed */
+	bool				reused;		/* Request sent on a kept alive connection */
+	bool				keepalive;	/* Server will leave the connection open */
+	bool				complete;	/* End of response seen before EOF */
+	bool				chunked;
+	http_chunk_state_t		chunk_state;
+	size_t				chunk_left;
 #ifdef _WITH_REGEX_CHECK_
 	bool				regex_matched;
 	size_t				start_offset;	/* Offset into buffer to match from */
@@ -99,6 +122,7 @@ typedef struct _url {
 	const uint8_t			*digest;
 	unsigned long			status_code[(HTTP_STATUS_CODE_MAX - HTTP_STATUS_CODE_MIN + 1 - 1) / (sizeof(unsigned long) * CHAR_BIT) + 1];
 	const char			*virtualhost;
+	bool				head;		/* Use HEAD rather than GET */
 	ssize_t				len_mismatch;
 	bool				tls_compliant;
 	unsigned long			last_ssl_error;
@@ -128,9 +152,22 @@ typedef struct _http_checker {
 #endif
 	bool				fast_recovery;
 	bool				tls_compliant;
+	bool				keepalive;
+	int				ka_fd;		/* Idle kept alive connection, or -1 */
+	uint64_t			conn_new;
+	uint64_t			conn_reused;
+	uint64_t			conn_stale;	/* Kept alive connections the server had closed */
+	unsigned long			tls_session_max_age;	/* 0 if sessions are not resumed */
+	SSL_SESSION			*tls_session;
+	unsigned long			tls_session_time;
+	uint64_t			tls_full_handshakes;
+	uint64_t			tls_resumed_handshakes;
+	uint64_t			bytes_avoided;	/* Response body not read */
 	int				genhash_flags;
 } http_checker_t;
 
+#define TLS_SESSION_MAX_AGE	(300 * TIMER_HZ)	/* Default tls_session_cache */
+
 #define GET_BUFFER_LENGTH 2048U
 #define MAX_BUFFER_LENGTH 4096U
 #define PROTO_HTTP	0x01
@@ -154,6 +191,7 @@ extern void timeout_epilog(thread_ref_t, const char *);
 extern void dump_digest(unsigned char *, unsigned);
 extern void http_process_response(thread_ref_t, request_t *, size_t, url_t *);
 extern void http_handle_response(thread_ref_t, unsigned char digest[16], bool);
+extern bool http_keepalive_retry(thread_ref_t);
 extern void http_connect_thread(thread_ref_t);
 #ifdef THREAD_DUMP
 extern void register_check_http_addresses(void);
@@ -30,6 +30,7 @@
 
 /* user includes */
 #include "notify.h"
+#include "coprocess.h"
 #include "keepalived_magic.h"
 
 /* Checker argument structure  */
@@ -37,6 +38,8 @@ typedef struct _misc_checker {
 	notify_script_t		script;		/* The script details */
 	unsigned long		timeout;
 	bool			dynamic;	/* false: old-style, true: exit code from checker affects weight */
+	bool			persistent;	/* The script is run once and sent a request per check */
+	coprocess_req_t		req;		/* The request to a persistent script */
 	script_state_t		state;		/* current state of script */
 	unsigned		last_exit_code;	/* The last exit code of the script */
 	timeval_t		last_ran;	/* Time script last ran */
@@ -24,15 +24,20 @@
 #define _CHECK_PING_H
 
 #include "check_api.h"
+#include "rbtree_ka.h"
 
 typedef struct _ping_check {
 	uint16_t	seq_no;
 	bool		response_expected;
+	checker_t	*checker;
+	rb_node_t	pending;	/* In the shared socket's pending tree, by seq_no */
+	thread_ref_t	timeout_thread;
 } ping_check_t;
 
 /* function prototypes */
 extern bool set_ping_group_range(bool);
 extern void install_ping_check_keyword(void);
+extern void checker_ping_dispatcher_release(void);
 #ifdef THREAD_DUMP
 extern void register_check_ping_addresses(void);
 #endif
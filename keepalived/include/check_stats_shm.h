@@ -0,0 +1,34 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        check_stats_shm.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _CHECK_STATS_SHM_H
+#define _CHECK_STATS_SHM_H
+
+/* local includes */
+#include "check_data.h"
+
+/* Prototypes */
+extern void check_stats_shm_update(const virtual_server_t *, const real_server_t *);
+extern void check_stats_shm_init(void);
+extern void check_stats_shm_close(void);
+
+#endif
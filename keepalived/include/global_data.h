@@ -145,6 +145,11 @@ typedef struct _data {
 	ipvs_timeout_t			lvs_timeouts;
 	int				smtp_alert_checker;
 	bool				checker_log_all_failures;
+	unsigned			dns_check_socket_pool;	/* Shared DNS_CHECK sockets per address family */
+	bool				checker_deduplicate;	/* Identical checkers only run once */
+	unsigned			checker_max_in_flight;	/* 0 for no limit */
+	bool				checker_spread_start;	/* Evenly space the first checks */
+	bool				checker_close_rst;	/* Default for checker close_rst */
 	struct lvs_syncd_config		lvs_syncd;
 	bool				lvs_flush;		/* flush any residual LVS config at startup */
 	lvs_flush_t			lvs_flush_on_stop;	/* flush any LVS config at shutdown */
@@ -162,6 +167,8 @@ typedef struct _data {
 	unsigned			vrrp_garp_lower_prio_rep;
 	unsigned			vrrp_garp_interval;
 	unsigned			vrrp_gna_interval;
+	unsigned			vrrp_garp_rate;
+	unsigned			vrrp_garp_burst;
 	unsigned			vrrp_down_timer_adverts;
 #ifdef _HAVE_VRRP_VMAC_
 	unsigned			vrrp_vmac_garp_intvl;
@@ -169,6 +176,8 @@ typedef struct _data {
 #endif
 	bool				vrrp_lower_prio_no_advert;
 	bool				vrrp_higher_prio_send_advert;
+	bool				vrrp_advert_align;
+	unsigned			vrrp_advert_align_jitter;
 	int				vrrp_version;		/* VRRP version (2 or 3) */
 #ifdef _WITH_IPTABLES_
 	const char			*vrrp_iptables_inchain;
@@ -199,6 +208,10 @@ typedef struct _data {
 	unsigned			vrrp_realtime_priority;
 	cpu_set_t			vrrp_cpu_mask;
 	rlim_t				vrrp_rlimit_rt;
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	bool				vrrp_advert_thread;
+	unsigned			vrrp_advert_thread_priority;	/* 0 = automatic */
+#endif
 #endif
 #ifdef _WITH_LVS_
 	bool				have_checker_config;
@@ -284,6 +297,12 @@ typedef struct _data {
 	int				vrrp_rx_bufs_policy;
 	size_t				vrrp_rx_bufs_size;
 	int				vrrp_rx_bufs_multiples;
+#ifdef _WITH_VRRP_RX_RING_
+	bool				vrrp_rx_ring;
+	unsigned			vrrp_rx_ring_block_size;
+	unsigned			vrrp_rx_ring_block_nr;
+	unsigned			vrrp_rx_ring_timeout;		/* ms */
+#endif
 	unsigned			vrrp_startup_delay;
 	bool				log_unknown_vrids;
 	bool				vrrp_owner_ignore_adverts;
@@ -302,6 +321,13 @@ typedef struct _data {
 	const char			*state_dump_file;
 	const char			*stats_dump_file;
 	const char			*json_dump_file;
+#ifdef _WITH_VRRP_
+	const char			*vrrp_stats_shm;
+#endif
+#ifdef _WITH_LVS_
+	const char			*checker_stats_shm;
+#endif
+	unsigned long			stats_shm_refresh;
 } data_t;
 
 /* Global vars exported */
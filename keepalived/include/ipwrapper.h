@@ -43,6 +43,10 @@
 #define LVS_CMD_DEL_DEST	IP_VS_SO_SET_DELDEST
 #define LVS_CMD_EDIT_DEST	IP_VS_SO_SET_EDITDEST
 
+#define LATENCY_WEIGHT_STEP	10	/* percent */
+#define LATENCY_WEIGHT_MARGIN	50	/* percent above the median ignored */
+#define LATENCY_WEIGHT_INTERVAL	TIMER_HZ	/* how often the weights are recalculated */
+
 static inline bool __attribute((pure))
 rs_iseq(const real_server_t *rs_a, const real_server_t *rs_b)
 {
@@ -51,6 +55,8 @@ rs_iseq(const real_server_t *rs_a, const real_server_t *rs_b)
 
 /* prototypes */
 extern void update_svr_wgt(int64_t, virtual_server_t *, real_server_t *, bool);
+extern void update_latency_weights(virtual_server_t *);
+extern void rs_latency_updated(virtual_server_t *, real_server_t *);
 extern void set_checker_state(checker_t *, bool);
 extern void update_svr_checker_state(bool, checker_t *);
 extern bool init_services(void);
@@ -59,5 +65,8 @@ extern void set_quorum_states(void);
 extern void clear_diff_services(void);
 extern void check_new_rs_state(void);
 extern void link_vsg_to_vs(void);
+#ifdef THREAD_DUMP
+extern void register_ipwrapper_addresses(void);
+#endif
 
 #endif
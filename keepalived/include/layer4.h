@@ -53,6 +53,7 @@ typedef struct _conn_opts {
 	unsigned int	fwmark; /* to mark packets going out of the socket using SO_MARK */
 #endif
 	int		last_errno;	/* Errno from last call to connect */
+	int		close_rst;	/* Close TCP connections with RST, -1 for global default */
 } conn_opts_t;
 
 /* Prototypes defs */
@@ -0,0 +1,193 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        stats_shm.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _STATS_SHM_H
+#define _STATS_SHM_H
+
+/* system includes */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+/*
+ * Layout of the live statistics files written by the vrrp and checker
+ * processes (see vrrp_stats_shm and checker_stats_shm).
+ *
+ * The file is a 64 byte header followed by num_recs records of rec_size
+ * bytes, all in host byte order. A reader should mmap() the file read only,
+ * check magic, version and type, and then for each record (and for the
+ * header's update_time) loop:
+ *	s = stats_shm_read_begin(&rec->seq);
+ *	copy the record;
+ *	if (!stats_shm_read_retry(&rec->seq, s)) the copy is consistent;
+ *
+ * When keepalived reloads, a new file is renamed over the old one and the
+ * old header has STATS_SHM_STALE set, so a reader seeing STATS_SHM_STALE
+ * should unmap and reopen the file. STATS_SHM_STALE is also set, and the
+ * file removed, when keepalived stops.
+ */
+#define VRRP_STATS_SHM_FILE	"/dev/shm/keepalived_vrrp.stats"
+#define CHECKER_STATS_SHM_FILE	"/dev/shm/keepalived_checker.stats"
+#define STATS_SHM_REFRESH	TIMER_HZ	/* Default refresh interval */
+
+#define STATS_SHM_MAGIC		0x534c414bU	/* "KALS" */
+#define STATS_SHM_VERSION	1
+
+#define STATS_SHM_ALIGN		64		/* Records don't share cache lines */
+#define STATS_SHM_NAME_LEN	64
+#define STATS_SHM_IFNAME_LEN	16
+
+enum stats_shm_type {
+	STATS_SHM_VRRP = 1,
+	STATS_SHM_CHECKER,
+};
+
+/* Header flags */
+#define STATS_SHM_STALE		0x01
+
+typedef struct _stats_shm_hdr {
+	uint32_t		magic;
+	uint16_t		version;
+	uint16_t		type;			/* enum stats_shm_type */
+	uint32_t		hdr_size;		/* Offset of the first record */
+	uint32_t		rec_size;
+	uint32_t		num_recs;
+	uint32_t		flags;
+	int32_t			pid;			/* Process writing the file */
+	uint32_t		seq;			/* Protects update_time */
+	uint64_t		update_time;		/* usecs since the epoch of last refresh */
+} stats_shm_hdr_t;
+
+#define STATS_SHM_RX_INTERVAL_BUCKETS	7
+
+/* One per vrrp_instance, in configuration order */
+typedef struct _vrrp_shm_rec {
+	uint32_t		seq;
+	int32_t			state;			/* VRRP_STATE_* */
+	int32_t			wantstate;
+	uint8_t			vrid;
+	uint8_t			version;
+	uint8_t			base_priority;
+	uint8_t			effective_priority;
+	uint16_t		family;
+	uint16_t		pad;
+	char			iname[STATS_SHM_NAME_LEN];	/* Truncated if necessary */
+	char			ifname[STATS_SHM_IFNAME_LEN];
+	uint64_t		last_transition;	/* usecs since the epoch */
+
+	/* vrrp_stats */
+	uint64_t		advert_rcvd;
+	uint64_t		advert_sent;
+	uint64_t		become_master;
+	uint64_t		release_master;
+	uint64_t		packet_len_err;
+	uint64_t		advert_interval_err;
+	uint64_t		ip_ttl_err;
+	uint64_t		invalid_type_rcvd;
+	uint64_t		addr_list_err;
+	uint64_t		invalid_authtype;
+	uint64_t		authtype_mismatch;
+	uint64_t		auth_failure;
+	uint64_t		pri_zero_rcvd;
+	uint64_t		pri_zero_sent;
+	uint64_t		na_sent;
+	uint64_t		rx_interval_hist[STATS_SHM_RX_INTERVAL_BUCKETS];
+	uint64_t		rx_interval_max;	/* usecs */
+} vrrp_shm_rec_t;
+
+/* checker_shm_rec_t flags */
+#define STATS_SHM_RS_ALIVE	0x01
+#define STATS_SHM_RS_SET	0x02		/* In the IPVS table */
+#define STATS_SHM_RS_SORRY	0x04		/* Sorry server */
+#define STATS_SHM_VS_QUORUM_UP	0x08
+
+/* One per real server of each virtual_server, in configuration order */
+typedef struct _checker_shm_rec {
+	uint32_t		seq;
+	uint32_t		flags;
+	char			vs_name[STATS_SHM_NAME_LEN];	/* As logged, e.g. [10.0.0.1]:tcp:80 */
+	uint16_t		rs_family;
+	uint16_t		rs_port;
+	uint8_t			rs_addr[16];
+	int32_t			weight;			/* Current IPVS weight */
+	uint32_t		num_failed_checkers;
+	uint64_t		last_change;		/* usecs since the epoch */
+} checker_shm_rec_t;
+
+/* The reader side of the seqlock */
+static inline uint32_t
+stats_shm_read_begin(const uint32_t *seq)
+{
+	uint32_t s;
+
+	while ((s = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1);
+
+	return s;
+}
+
+static inline bool
+stats_shm_read_retry(const uint32_t *seq, uint32_t s)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(seq, __ATOMIC_RELAXED) != s;
+}
+
+/* The writer side, only ever used by one thread */
+static inline void
+stats_shm_write_begin(uint32_t *seq)
+{
+	__atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void
+stats_shm_write_end(uint32_t *seq)
+{
+	__atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t
+stats_shm_timeval(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000 + (uint64_t)tv->tv_usec;
+}
+
+typedef struct _stats_shm {
+	const char		*file_name;
+	stats_shm_hdr_t		*hdr;
+	size_t			size;
+} stats_shm_t;
+
+static inline void *
+stats_shm_rec(const stats_shm_t *shm, unsigned index)
+{
+	return (char *)shm->hdr + shm->hdr->hdr_size + (size_t)index * shm->hdr->rec_size;
+}
+
+/* Prototypes */
+extern stats_shm_t *stats_shm_create(const char *, enum stats_shm_type, size_t, unsigned);
+extern void stats_shm_close(stats_shm_t **, bool);
+extern void stats_shm_set_update_time(stats_shm_t *);
+
+#endif
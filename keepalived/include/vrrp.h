@@ -27,6 +27,7 @@
 #include "config.h"
 
 /* system include */
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <net/if.h>
@@ -47,6 +48,7 @@
 #include "vrrp_sock.h"
 #include "vrrp_track.h"
 #include "sockaddr.h"
+#include "stats_shm.h"
 
 struct _ip_address;
 
@@ -200,6 +202,17 @@ typedef struct _vrrp_sgroup {
 	list_head_t		e_list;
 } vrrp_sgroup_t;
 
+/* Histogram of master advert inter-arrival times. The buckets are bounded
+ * by percentages of the master's advert interval, see vrrp_rx_interval_pct.
+ * The number of buckets is part of the vrrp_stats_shm layout */
+#define VRRP_RX_INTERVAL_BUCKETS	STATS_SHM_RX_INTERVAL_BUCKETS
+
+#ifdef _NETWORK_TIMESTAMP_
+/* Histogram of kernel receive to processing lag. The first bucket is < 10us
+ * and each subsequent bucket is 10 times the previous one. */
+#define VRRP_RX_LAG_BUCKETS		6
+#endif
+
 /* Statistics */
 typedef struct _vrrp_stats {
 	uint64_t	advert_rcvd;
@@ -223,6 +236,16 @@ typedef struct _vrrp_stats {
 	uint64_t	pri_zero_rcvd;
 	uint64_t	pri_zero_sent;
 
+	uint64_t	na_sent;		/* Unsolicited NAs sent or queued */
+	uint32_t	na_sent_failover;	/* As above, since last becoming master */
+
+	uint64_t	rx_interval_hist[VRRP_RX_INTERVAL_BUCKETS];
+	uint32_t	rx_interval_max;	/* usecs */
+#ifdef _NETWORK_TIMESTAMP_
+	uint64_t	rx_lag_hist[VRRP_RX_LAG_BUCKETS];
+	uint32_t	rx_lag_max;		/* usecs */
+#endif
+
 #ifdef _WITH_SNMP_RFC_
 	uint32_t	chk_err;
 	uint32_t	vers_err;
@@ -267,8 +290,16 @@ typedef struct _unicast_peer_t {
 	unsigned char		min_ttl;
 	unsigned char		max_ttl;
 
+	/* Receive statistics */
+	uint64_t		advert_rcvd;
+	uint64_t		chksum_err;
+	timeval_t		last_rcvd;		/* Time last advert received */
+
 	/* Linked list member */
 	list_head_t		e_list;
+
+	/* Member of the instance's unicast_peer_tree, indexed by address */
+	rb_node_t		rb_peer;
 } unicast_peer_t;
 
 typedef enum vrrp_fault_fl {
@@ -283,17 +314,52 @@ typedef enum vrrp_fault_fl {
 } vrrp_fault_fl_t;
 
 /* parameters per virtual router -- rfc2338.6.1.2 */
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+/* Per instance state shared with the advert thread */
+typedef struct _advert_slot advert_slot_t;
+#endif
+
 typedef struct _vrrp_t {
+	/* The fields used when searching the sock_t trees and processing
+	 * received adverts and timeouts are kept together at the start, and
+	 * each RB tree node is next to the key it is sorted on, so that
+	 * the dispatcher touches as few cache lines as possible per instance. */
+
+	/* RB tree on a sock_t for receiving data */
+	rb_node_t		rb_vrid;
+	uint8_t			vrid;			/* virtual id. from 1(!) to 255 */
+	uint8_t			base_priority;		/* configured priority value */
+	uint8_t			effective_priority;	/* effective priority value */
+	int			state;			/* internal state (init/backup/master/fault) */
+	unsigned long		flags;
+	vrrp_stats		*stats;			/* Statistics */
+	vrrp_sgroup_t		*sync;			/* Sync group we belong to */
+
+	/* rfc2338.6.2 */
+	uint32_t		ms_down_timer;
+	unsigned		master_adver_int;	/* In v3, when we become BACKUP, we use the MASTER's
+							 * adver_int. If we become MASTER again, we use the
+							 * value we were originally configured with.
+							 * In v2, this will always be the configured adver_int.
+							 */
+
+	/* RB tree on a sock_t for vrrp sands */
+	rb_node_t		rb_sands;
+	timeval_t		sands;
+	int			wantstate;		/* user explicitly wants a state (back/mast) */
+	int			version;		/* VRRP version (2 or 3) */
+	sock_t			*sockets;		/* In and out socket descriptors */
 	sa_family_t		family;			/* AF_INET|AF_INET6 */
+	bool			multicast_pkt;		/* Last IPv6 packet received was multicast */
+	int			rx_ttl_hl;		/* Received TTL/hop limit returned */
+
+	/* Remaining, mostly configuration, data */
 	const char		*iname;			/* Instance Name */
-	vrrp_sgroup_t		*sync;			/* Sync group we belong to */
-	vrrp_stats		*stats;			/* Statistics */
 	interface_t		*ifp;			/* Interface we belong to */
 #ifdef _HAVE_VRF_
 	const interface_t	*vrf_ifp;		/* VRF interface if no interface specified */
 #endif
 	unsigned		strict_mode;		/* Enforces strict VRRP compliance */
-	unsigned long		flags;
 	vrrp_rlflags_t		rlflags;		/* Flags for rate-limiting log messages */
 #ifdef _HAVE_VRRP_VMAC_
 	char			vmac_ifname[IFNAMSIZ];	/* Name of VRRP VMAC interface */
@@ -319,12 +385,13 @@ typedef struct _vrrp_t {
 	unsigned long		flags_if_fault;		/* Flags of interface fault */
 	unsigned		num_script_init;	/* Number of scripts in init state */
 	bool			notifies_sent;		/* Set when initial notifies have been sent */
-	bool			multicast_pkt;		/* Last IPv6 packet received was multicast */
 	sockaddr_t		saddr;			/* Src IP address to use in VRRP IP header */
 	sockaddr_t		pkt_saddr;		/* Src IP address received in VRRP IP header */
 	sockaddr_t		mcast_daddr;		/* Multicast destination address */
-	int			rx_ttl_hl;		/* Received TTL/hop limit returned */
+	timeval_t		pkt_rx_time;		/* Time last packet received, kernel time if available */
+	timeval_t		master_rx_time;		/* Time last advert accepted from master */
 	list_head_t		unicast_peer;		/* unicast_peer_t - peers to send unicast advert to */
+	rb_root_t		unicast_peer_tree;	/* unicast_peer_t - peers indexed by address */
 	int			ttl;			/* TTL to send packet with if unicasting */
 #ifdef _WITH_UNICAST_CHKSUM_COMPAT_
 	chksum_compatibility_t	unicast_chksum_compat;	/* Whether v1.3.6 and earlier chksum is used */
@@ -335,6 +402,7 @@ typedef struct _vrrp_t {
 	sockaddr_t		master_saddr;		/* Store last heard Master address */
 	uint8_t			master_priority;	/* Store last heard priority */
 	timeval_t		last_transition;	/* Store transition time */
+	vrrp_shm_rec_t		*shm_rec;		/* Live stats record, if any */
 	unsigned		garp_delay;		/* Delay to launch gratuitous ARP */
 	timeval_t		garp_refresh;		/* Next scheduled gratuitous ARP refresh */
 	unsigned		garp_rep;		/* gratuitous ARP repeat value */
@@ -348,15 +416,15 @@ typedef struct _vrrp_t {
 #ifdef _HAVE_VRRP_VMAC_
 	timeval_t		vmac_garp_intvl;	/* Interval between GARPs on each VMAC */
 #endif
-	uint8_t			vrid;			/* virtual id. from 1(!) to 255 */
-	uint8_t			base_priority;		/* configured priority value */
-	uint8_t			effective_priority;	/* effective priority value */
 	int			total_priority;		/* base_priority +/- track_script, track_interface, track_bfd and track_file weights.
 							   effective_priority is this within the range [1,254]. */
 	uint8_t			highest_other_priority;	/* Used for timer_expired_backup */
 	bool			vipset;			/* All the vips are set ? */
 	list_head_t		vip;			/* ip_address_t - list of virtual ip addresses */
 	unsigned		vip_cnt;		/* size of vip list */
+	void			*vip_sorted;		/* VIP addresses in address order, for checking adverts */
+	void			*vip_last_rx;		/* Address list of the last advert that matched the VIPs */
+	bool			vip_last_rx_valid;
 	list_head_t		evip;			/* ip_address_t - list of protocol excluded VIPs.
 							 * Those VIPs will not be presents into the
 							 * VRRP adverts
@@ -364,11 +432,6 @@ typedef struct _vrrp_t {
 	list_head_t		vroutes;		/* ip_route_t - list of virtual routes */
 	list_head_t		vrules;			/* ip_rule_t - list of virtual rules */
 	unsigned		adver_int;		/* locally configured delay between advertisements*/
-	unsigned		master_adver_int;	/* In v3, when we become BACKUP, we use the MASTER's
-							 * adver_int. If we become MASTER again, we use the
-							 * value we were originally configured with.
-							 * In v2, this will always be the configured adver_int.
-							 */
 	timeval_t		last_advert_sent;	/* Time of sending last advert */
 	size_t			kernel_rx_buf_size;	/* Socket receive buffer size */
 
@@ -386,18 +449,13 @@ typedef struct _vrrp_t {
 							 * prio is allowed.  0 means no delay.
 							 */
 	timeval_t		preempt_time;		/* Time after which preemption can happen */
-	int			state;			/* internal state (init/backup/master/fault) */
 #ifdef _WITH_SNMP_VRRP_
 	int			configured_state;	/* the configured state of the instance */
 #endif
-	int			wantstate;		/* user explicitly wants a state (back/mast) */
 	bool			reload_master;		/* set if the instance is a master being reloaded */
-	sock_t			*sockets;		/* In and out socket descriptors */
 
 	int			debug;			/* Debug level 0-4 */
 
-	int			version;		/* VRRP version (2 or 3) */
-
 	/* State transition notification */
 	int			smtp_alert;
 	int			last_email_state;
@@ -412,10 +470,6 @@ typedef struct _vrrp_t {
 	notify_script_t		*script;
 	int			notify_priority_changes;
 
-	/* rfc2338.6.2 */
-	uint32_t		ms_down_timer;
-	timeval_t		sands;
-
 	/* Sending buffer */
 	char			*send_buffer;		/* Allocated send buffer */
 	size_t			send_buffer_size;
@@ -425,6 +479,7 @@ typedef struct _vrrp_t {
 	/* Authentication data (only valid for VRRPv2) */
 	uint8_t			auth_type;		/* authentification type. VRRP_AUTH_* */
 	uint8_t			auth_data[8];		/* authentification data */
+	hmac_md5_ctx_t		*auth_hmac;		/* HMAC state keyed with auth_data for AH */
 
 	/* IPSEC AH counter def (only valid for VRRPv2) --rfc2402.3.3.2 */
 	seq_counter_t		ipsecah_counter;
@@ -439,11 +494,10 @@ typedef struct _vrrp_t {
 	 */
 	int			ip_id;
 
-	/* RB tree on a sock_t for receiving data */
-	rb_node_t		rb_vrid;
-
-	/* RB tree on a sock_t for vrrp sands */
-	rb_node_t		rb_sands;
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	/* Set if the advert thread can send adverts for this instance */
+	advert_slot_t		*advert_slot;
+#endif
 
 	/* Sync group list member */
 	list_head_t		s_list;			/* vrrp_sgroup_t->vrrp_instances */
@@ -452,6 +506,21 @@ typedef struct _vrrp_t {
 	list_head_t		e_list;
 } vrrp_t;
 
+/* Stop later changes to vrrp_t silently moving the dispatcher's fields out
+ * of the first two cache lines */
+#define VRRP_HOT_FIELD(field)	(offsetof(vrrp_t, field) + sizeof(((vrrp_t *)NULL)->field) <= 128)
+_Static_assert(VRRP_HOT_FIELD(rb_vrid) && VRRP_HOT_FIELD(vrid) &&
+	       VRRP_HOT_FIELD(base_priority) && VRRP_HOT_FIELD(effective_priority) &&
+	       VRRP_HOT_FIELD(state) && VRRP_HOT_FIELD(flags) &&
+	       VRRP_HOT_FIELD(stats) && VRRP_HOT_FIELD(sync) &&
+	       VRRP_HOT_FIELD(ms_down_timer) && VRRP_HOT_FIELD(master_adver_int) &&
+	       VRRP_HOT_FIELD(rb_sands) && VRRP_HOT_FIELD(sands) &&
+	       VRRP_HOT_FIELD(wantstate) && VRRP_HOT_FIELD(version) &&
+	       VRRP_HOT_FIELD(sockets) && VRRP_HOT_FIELD(family) &&
+	       VRRP_HOT_FIELD(multicast_pkt) && VRRP_HOT_FIELD(rx_ttl_hl),
+	       "vrrp_t fields used by the dispatcher must be in its first 128 bytes");
+#undef VRRP_HOT_FIELD
+
 /* VRRP state machine -- rfc2338.6.4 */
 #define VRRP_STATE_INIT			0	/* rfc2338.6.4.1 */
 #define VRRP_STATE_BACK			1	/* rfc2338.6.4.2 */
@@ -510,10 +579,16 @@ extern bool do_network_timestamp;
 extern bool do_checksum_debug;
 #endif
 
+extern const unsigned vrrp_rx_interval_pct[VRRP_RX_INTERVAL_BUCKETS - 1];
+
 /* prototypes */
 extern void clear_summary_flags(void);
 extern size_t vrrp_adv_len(const vrrp_t *) __attribute__ ((pure));
 extern const vrrphdr_t *vrrp_get_header(sa_family_t, const char *, size_t);
+extern unicast_peer_t *vrrp_find_unicast_peer(vrrp_t *, const sockaddr_t *) __attribute__ ((pure));
+#ifdef _NETWORK_TIMESTAMP_
+extern void vrrp_rx_timestamp(vrrp_t *, const struct timespec *);
+#endif
 extern void open_sockpool_socket(sock_t *);
 extern int new_vrrp_socket(vrrp_t *);
 extern void vrrp_send_adv(vrrp_t *, uint8_t);
@@ -0,0 +1,48 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        vrrp_advert_thread.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _VRRP_ADVERT_THREAD_H
+#define _VRRP_ADVERT_THREAD_H
+
+/* system includes */
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/* local includes */
+#include "vrrp.h"
+
+/* Number of advert intervals the advert thread will keep sending for
+ * an instance without hearing from the main thread */
+#define ADVERT_THREAD_LEASE	10
+
+/* Prototypes */
+extern bool advert_thread_eligible(const vrrp_t *) __attribute__ ((pure));
+extern bool advert_thread_renew(vrrp_t *, uint8_t);
+extern void advert_thread_prepare(vrrp_t *, uint8_t);
+extern void advert_thread_add_msg(vrrp_t *, const struct msghdr *, int);
+extern void advert_thread_post(vrrp_t *);
+extern void advert_thread_release(vrrp_t *);
+extern void start_vrrp_advert_thread(void);
+extern void stop_vrrp_advert_thread(void);
+
+#endif
@@ -69,6 +69,8 @@ typedef struct ipoib_hdr {
 /* prototypes */
 extern bool gratuitous_arp_init(void);
 extern void gratuitous_arp_close(void);
+extern void gratuitous_arp_batch(void);
+extern void gratuitous_arp_flush(void);
 extern void send_gratuitous_arp(ip_address_t *, unsigned);
 extern ssize_t send_gratuitous_arp_immediate(interface_t *, ip_address_t *);
 #endif
@@ -71,6 +71,9 @@
 typedef uint32_t ifindex_t;
 
 /* Structure for delayed sending of gratuitous ARP/NA messages */
+/* Maximum burst size of a GARP/NA token bucket */
+#define GARP_MAX_BURST	65535
+
 typedef struct _garp_delay {
 	timeval_t		garp_interval;		/* Delay between sending gratuitous ARP messages on an interface */
 	bool			have_garp_interval;	/* True if delay */
@@ -79,6 +82,19 @@ typedef struct _garp_delay {
 	timeval_t		garp_next_time;		/* Time when next gratuitous ARP message can be sent */
 	timeval_t		gna_next_time;		/* Time when next gratuitous NA message can be sent */
 
+	/* Token bucket shared by GARPs and NAs, used instead of the intervals if rate is set */
+	unsigned		rate;			/* GARP/NA messages per second */
+	unsigned		burst;			/* Number of messages that can be sent back to back */
+	uint64_t		credit;			/* Bucket content, in usecs */
+	timeval_t		credit_time;		/* Time credit was last updated */
+	thread_ref_t		pacer_thread;
+	bool			pace_gna_next;		/* Send an NA next if both GARPs and NAs queued */
+	unsigned		queue_depth;		/* GARP/NA messages waiting to be sent */
+	unsigned		max_queue_depth;
+	timeval_t		drain_start;		/* Time messages were queued when the queues were empty */
+	unsigned long		last_drain_time;	/* usecs taken to empty the queues last time */
+	unsigned long		max_drain_time;
+
 	/* linked list of ip_address_t that have GARP/NAs pending */
 	list_head_t		garp_list;
 	list_head_t		gna_list;
@@ -39,6 +39,11 @@
 #include "vrrp_static_track.h"
 #include "utils.h"
 
+/* Size of the link layer frame cached with each address. This must be
+ * large enough for an infiniband gratuitous ARP (see vrrp_arp.c) and
+ * an infiniband unsolicited neighbour advert (see vrrp_ndisc.c). */
+#define IP_ADDR_FRAME_SIZE	112
+
 /* types definition */
 typedef struct _ip_address {
 	struct ifaddrmsg ifa;
@@ -79,6 +84,9 @@ typedef struct _ip_address {
 #endif
 	unsigned		garp_gna_pending;	/* Number of GARPs/GNAs still to be sent */
 	list_head_t		garp_gna_list;
+	uint8_t			frame_len;		/* Length of cached GARP/NA frame, 0 if none */
+	ifindex_t		frame_ifindex;		/* Interface the cached frame was built for */
+	char			frame[IP_ADDR_FRAME_SIZE];	/* Cached GARP/NA frame */
 	uint32_t		preferred_lft;		/* IPv6 preferred_lft (0 means address deprecated) */
 
 	/* linked list member */
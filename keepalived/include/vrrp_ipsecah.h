@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include <openssl/md5.h>
+#include <openssl/evp.h>
 #include <stdbool.h>
 
 /* Predefined values */
@@ -51,6 +52,15 @@ typedef struct _seq_counter {
 	uint32_t		seq_number;
 } seq_counter_t;
 
-extern void hmac_md5(const unsigned char *, size_t, const unsigned char *, size_t, const unsigned char *, size_t, unsigned char *);
+/* Keyed HMAC-MD5 state, computed once per key */
+typedef struct _hmac_md5_ctx {
+	EVP_MD_CTX		*inner;		/* MD5 state after hashing K XOR ipad */
+	EVP_MD_CTX		*outer;		/* MD5 state after hashing K XOR opad */
+	EVP_MD_CTX		*work;		/* Context for computing a digest */
+} hmac_md5_ctx_t;
+
+extern hmac_md5_ctx_t *hmac_md5_init(const unsigned char *, size_t);
+extern void hmac_md5_free(hmac_md5_ctx_t *);
+extern bool hmac_md5(const hmac_md5_ctx_t *, const unsigned char *, size_t, const unsigned char *, size_t, unsigned char *);
 
 #endif
@@ -63,7 +63,9 @@ struct ip6hdr {
 /* prototypes */
 extern bool ndisc_init(void);
 extern void ndisc_close(void);
-extern void ndisc_send_unsolicited_na(ip_address_t *, unsigned);
+extern void ndisc_batch(void);
+extern void ndisc_flush(void);
+extern bool ndisc_send_unsolicited_na(ip_address_t *, unsigned);
 extern void ndisc_send_unsolicited_na_immediate(interface_t *, ip_address_t *);
 
 #endif
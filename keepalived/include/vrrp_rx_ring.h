@@ -0,0 +1,42 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        vrrp_rx_ring.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _VRRP_RX_RING_H
+#define _VRRP_RX_RING_H
+
+/* system includes */
+#include <stdbool.h>
+
+/* local includes */
+#include "vrrp_sock.h"
+
+/* Defaults for vrrp_rx_ring */
+#define VRRP_RX_RING_BLOCK_SIZE	65536
+#define VRRP_RX_RING_BLOCK_NR	8
+#define VRRP_RX_RING_TIMEOUT	1	/* Block retire timeout in ms */
+
+/* Prototypes */
+extern int open_vrrp_rx_ring(sock_t *);
+extern void close_vrrp_rx_ring(sock_t *);
+extern bool vrrp_rx_ring_next(sock_t *, vrrp_rx_pkt_t *);
+
+#endif
@@ -34,6 +34,7 @@
 #include "vrrp_track.h"
 #include "vrrp_data.h"
 #include "vrrp.h"
+#include "vrrp_ipaddress.h"
 
 /* global vars */
 extern bool vrrp_initialised;
@@ -72,6 +73,11 @@ extern void vrrp_gratuitous_arp_vmac_update_thread(thread_ref_t);
 #endif
 extern void vrrp_arp_thread(thread_ref_t);
 extern void vrrp_gna_thread(thread_ref_t);
+extern bool garp_pacer_send_now(garp_delay_t *);
+extern void garp_pacer_queue(garp_delay_t *, ip_address_t *, list_head_t *);
+extern void garp_pacer_pending(garp_delay_t *);
+extern void garp_pacer_remove(garp_delay_t *, const ip_address_t *);
+extern void vrrp_garp_pacer_thread(thread_ref_t);
 extern void try_up_instance(vrrp_t *, bool, vrrp_fault_fl_t);
 #ifdef _WITH_DUMP_THREADS_
 extern void dump_threads(void);
@@ -27,6 +27,7 @@
 #include <stdbool.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <time.h>
 
 /* local includes */
 #include "scheduler.h"
@@ -53,9 +54,29 @@ typedef struct _sock {
 	thread_ref_t		thread;
 	rb_root_t		rb_vrid;
 	rb_root_cached_t	rb_sands;
+#ifdef _WITH_VRRP_RX_RING_
+	/* If fd_in is an AF_PACKET socket, its mmapped TPACKET_V3 ring */
+	char			*rx_ring;
+	unsigned		rx_ring_block_size;
+	unsigned		rx_ring_block_nr;
+	unsigned		rx_ring_block;		/* Block we are reading */
+	char			*rx_ring_pkt;		/* Next packet in block, NULL if not started */
+	unsigned		rx_ring_pkts_left;	/* Packets left in the block */
+#endif
 
 	/* Linked list member */
 	list_head_t		e_list;
 } sock_t;
 
+/* A received packet, with the information the kernel gave us about it */
+typedef struct _vrrp_rx_pkt {
+	const char		*buf;			/* IPv4 header, or VRRP header for IPv6 */
+	size_t			len;
+	sockaddr_t		src_addr;
+	int			ttl_hl;			/* IPv6 hop limit, -1 if not known */
+	bool			multicast;		/* IPv6 destination was multicast */
+	bool			have_ts;
+	struct timespec		ts;			/* Kernel receive time */
+} vrrp_rx_pkt_t;
+
 #endif
@@ -34,6 +34,7 @@
 #include "vrrp_if.h"
 #include "vrrp.h"
 #include "notify.h"
+#include "coprocess.h"
 #ifdef _WITH_BFD_
 #include "bfd.h"
 #endif
@@ -76,6 +77,8 @@ typedef struct _vrrp_script {
 	script_state_t		state;		/* current state of script */
 	script_init_state_t	init_state;	/* current initialisation state of script */
 	bool			insecure;	/* Set if script is run by root, but is non-root modifiable */
+	bool			persistent;	/* The script is run once and sent a request per check */
+	coprocess_req_t		req;		/* The request to a persistent script */
 
 	/* linked list member */
 	list_head_t		e_list;
@@ -92,6 +92,12 @@
 #ifdef _WITH_LVS_
 #include "ipvswrapper.h"
 #endif
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+#include "vrrp_advert_thread.h"
+#endif
+#ifdef _WITH_VRRP_RX_RING_
+#include "vrrp_rx_ring.h"
+#endif
 
 /* Ideally we would use a struct from a system header to determine the
  * size of a vlan tag, but there doesn't seem to be one exposed to
@@ -118,6 +124,10 @@ bool do_network_timestamp;
 bool do_checksum_debug;
 #endif
 
+/* Upper bounds of the master advert inter-arrival histogram buckets, as a
+ * percentage of the master advert interval */
+const unsigned vrrp_rx_interval_pct[VRRP_RX_INTERVAL_BUCKETS - 1] = { 90, 110, 150, 200, 250, 300 };
+
 static void
 vrrp_notify_fifo_script_exit(__attribute__((unused)) thread_ref_t thread)
 {
@@ -205,6 +215,10 @@ check_track_script_secure(vrrp_script_t *script, magic_t magic)
 	}
 	else if (!(flags & (SC_EXECUTABLE | SC_SYSTEM)))
 		script->insecure = true;
+	else if (script->persistent && !(script->script.flags & SC_EXECABLE)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "Track script %s cannot be run persistently since it cannot be exec'd - running per check", script->sname);
+		script->persistent = false;
+	}
 
 	return flags;
 }
@@ -378,7 +392,8 @@ expected_vrrp_pkt_len(const vrrphdr_t *vh, int family)
 	return len;
 }
 
-static void
+/* Returns false if the packet must not be sent */
+static bool
 vrrp_update_pkt(vrrp_t *vrrp, uint8_t prio, sockaddr_t *addr)
 {
 	char *bufptr = vrrp->send_buffer;
@@ -500,14 +515,18 @@ vrrp_update_pkt(vrrp_t *vrrp, uint8_t prio, sockaddr_t *addr)
 				   -- rfc2402.3.3.3.1.1.1 & rfc2401.5
 				 */
 				memset(&ah->auth_data, 0, sizeof(ah->auth_data));
-				hmac_md5(PTR_CAST_CONST(unsigned char, &iph), sizeof iph, PTR_CAST_CONST(unsigned char, ah),
-					 vrrp->send_buffer_size - sizeof(struct iphdr), vrrp->auth_data,
-					 sizeof(vrrp->auth_data), digest);
+				if (!hmac_md5(vrrp->auth_hmac, PTR_CAST_CONST(unsigned char, &iph), sizeof iph, PTR_CAST_CONST(unsigned char, ah),
+					      vrrp->send_buffer_size - sizeof(struct iphdr), digest)) {
+					log_message(LOG_INFO, "(%s) IPSEC-AH : unable to compute HMAC-MD5 - not sending advert", vrrp->iname);
+					return false;
+				}
 				memcpy(ah->auth_data, digest, HMAC_MD5_TRUNC);
 			}
 		}
 #endif
 	}
+
+	return true;
 }
 
 #ifdef _WITH_UNICAST_CHKSUM_COMPAT_
@@ -568,9 +587,12 @@ vrrp_in_chk_ipsecah(vrrp_t *vrrp, const struct iphdr *ip, const ipsec_ah_t *ah,
 	memset(digest, 0, MD5_DIGEST_LENGTH);
 
 	/* Compute the ICV */
-	hmac_md5((const unsigned char *)ip_tmp, hdr_len,
-		 (const unsigned char *)hd, buflen - ((const unsigned char *)hd - (const unsigned char *)ip)
-		 , vrrp->auth_data, sizeof (vrrp->auth_data) , digest);
+	if (!hmac_md5(vrrp->auth_hmac, (const unsigned char *)ip_tmp, hdr_len,
+		      (const unsigned char *)hd, buflen - ((const unsigned char *)hd - (const unsigned char *)ip),
+		      digest)) {
+		log_message(LOG_INFO, "(%s) IPSEC-AH : unable to compute HMAC-MD5", vrrp->iname);
+		return true;
+	}
 
 	if (memcmp_constant_time(ah->auth_data, digest, HMAC_MD5_TRUNC) != 0) {
 		log_message(LOG_INFO, "(%s) IPSEC-AH : invalid"
@@ -605,29 +627,119 @@ vrrp_in_chk_ipsecah(vrrp_t *vrrp, const struct iphdr *ip, const ipsec_ah_t *ah,
 }
 #endif
 
-/* check if ipaddr is present in VIP buffer */
-static bool __attribute__((pure))
-vrrp_in_chk_vips(const vrrp_t *vrrp, const ip_address_t *ipaddress, const void *buffer, unsigned naddr)
+static int
+vrrp_unicast_peer_cmp(const void *addr, const rb_node_t *a)
 {
-	size_t i;
-	const struct in_addr *addr4_buf;
-	const struct in6_addr *addr6_buf;
+	return inet_sockaddrcmp(addr, &rb_entry_const(a, unicast_peer_t, rb_peer)->address);
+}
 
-	if (vrrp->family == AF_INET) {
-		addr4_buf = buffer;
-		for (i = 0; i < naddr; i++) {
-			if (!memcmp(&ipaddress->u.sin.sin_addr.s_addr, &addr4_buf[i], sizeof (struct in_addr)))
-				return true;
-		}
-	} else if (vrrp->family == AF_INET6) {
-		addr6_buf = buffer;
-		for (i = 0; i < naddr; i++) {
-			if (!memcmp(&ipaddress->u.sin6_addr, &addr6_buf[i], sizeof (struct in6_addr)))
-				return true;
+static bool
+vrrp_unicast_peer_less(rb_node_t *a, const rb_node_t *b)
+{
+	return inet_sockaddrcmp(&rb_entry(a, unicast_peer_t, rb_peer)->address,
+				&rb_entry_const(b, unicast_peer_t, rb_peer)->address) < 0;
+}
+
+/* Find the unicast peer an advert was received from */
+unicast_peer_t *
+vrrp_find_unicast_peer(vrrp_t *vrrp, const sockaddr_t *addr)
+{
+	rb_node_t *node = rb_find(addr, &vrrp->unicast_peer_tree, vrrp_unicast_peer_cmp);
+
+	return node ? rb_entry(node, unicast_peer_t, rb_peer) : NULL;
+}
+
+#ifdef _NETWORK_TIMESTAMP_
+/* Record the kernel receive time of an advert, and the lag until we processed it */
+void
+vrrp_rx_timestamp(vrrp_t *vrrp, const struct timespec *ts)
+{
+	struct timespec now;
+	int64_t lag;
+	uint32_t bound;
+	unsigned i;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	lag = (now.tv_sec - ts->tv_sec) * TIMER_HZ + (now.tv_nsec - ts->tv_nsec) / 1000;
+	if (lag < 0)
+		lag = 0;
+
+	for (i = 0, bound = 10; i < VRRP_RX_LAG_BUCKETS - 1 && lag >= bound; i++, bound *= 10);
+	vrrp->stats->rx_lag_hist[i]++;
+	if (lag > vrrp->stats->rx_lag_max)
+		vrrp->stats->rx_lag_max = lag > UINT32_MAX ? UINT32_MAX : (uint32_t)lag;
+
+	vrrp->pkt_rx_time.tv_sec = ts->tv_sec;
+	vrrp->pkt_rx_time.tv_usec = ts->tv_nsec / 1000;
+}
+#endif
+
+/* Add the interval since the last advert accepted from the master to the histogram */
+static void
+vrrp_rx_interval_update(vrrp_t *vrrp, bool master_change)
+{
+	timeval_t interval;
+	unsigned long usecs;
+	unsigned long pct;
+	unsigned i;
+
+	if (!master_change && vrrp->master_rx_time.tv_sec && vrrp->master_adver_int) {
+		timersub(&vrrp->pkt_rx_time, &vrrp->master_rx_time, &interval);
+		usecs = interval.tv_sec < 0 ? 0 : timer_long(interval);
+
+		/* If the gap is longer than the down timer we must have left
+		 * backup state in the meantime, so it is not a master interval. */
+		if (usecs <= VRRP_MS_DOWN_TIMER(vrrp)) {
+			pct = usecs * 100 / vrrp->master_adver_int;
+			for (i = 0; i < VRRP_RX_INTERVAL_BUCKETS - 1 && pct >= vrrp_rx_interval_pct[i]; i++);
+			vrrp->stats->rx_interval_hist[i]++;
+			if (usecs > vrrp->stats->rx_interval_max)
+				vrrp->stats->rx_interval_max = (uint32_t)usecs;
 		}
 	}
 
-	return false;
+	vrrp->master_rx_time = vrrp->pkt_rx_time;
+}
+
+static int
+vrrp_addr4_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(struct in_addr));
+}
+
+static int
+vrrp_addr6_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(struct in6_addr));
+}
+
+/* Check that each VIP is present in the VIP buffer of an advert. Both the
+ * VIPs and a copy of the advert's addresses are sorted, so a single pass
+ * over them is needed. Returns a pointer to the first VIP in vip_sorted
+ * that is missing, or NULL if all are present. */
+static const void *
+vrrp_find_missing_vip(const vrrp_t *vrrp, const void *buffer, unsigned naddr)
+{
+	static char rx_sorted[VRRP_MAX_ADDR * sizeof(struct in6_addr)];
+	size_t addr_len = vrrp->family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+	int (*cmp)(const void *, const void *) = vrrp->family == AF_INET ? vrrp_addr4_cmp : vrrp_addr6_cmp;
+	const char *vip = vrrp->vip_sorted;
+	const char *rx = rx_sorted;
+	const char *rx_end = rx_sorted + naddr * addr_len;
+	unsigned i;
+
+	memcpy(rx_sorted, buffer, naddr * addr_len);
+	qsort(rx_sorted, naddr, addr_len, cmp);
+
+	for (i = 0; i < vrrp->vip_cnt; i++, vip += addr_len) {
+		while (rx < rx_end && cmp(rx, vip) < 0)
+			rx += addr_len;
+		if (rx == rx_end || cmp(rx, vip))
+			return vip;
+		rx += addr_len;
+	}
+
+	return NULL;
 }
 
 #ifdef _CHECKSUM_DEBUG_
@@ -839,7 +951,6 @@ vrrp_check_packet(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buffer, ssize_t
 	const ipsec_ah_t *ah;
 #endif
 	const void *vips;
-	ip_address_t *ipaddress;
 	char addr_str[INET6_ADDRSTRLEN];
 	ipv4_phdr_t ipv4_phdr;
 	uint32_t acc_csum = 0;
@@ -852,6 +963,9 @@ vrrp_check_packet(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buffer, ssize_t
 
 	buflen = (size_t)buflen_ret;
 
+	if (__test_bit(VRRP_FLAG_UNICAST, &vrrp->flags))
+		up_addr = vrrp_find_unicast_peer(vrrp, &vrrp->pkt_saddr);
+
 	/* IPv4 related */
 	if (vrrp->family == AF_INET) {
 		/* To begin with, we just concern ourselves with the protocol headers */
@@ -1104,6 +1218,8 @@ vrrp_check_packet(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buffer, ssize_t
 #endif
 				{
 					log_rate_limited_error(vrrp, VRRP_RLFLAG_BAD_CHECKSUM, "(%s) Invalid VRRPv3 checksum from %s", vrrp->iname, inet_sockaddrtos(&vrrp->pkt_saddr));
+					if (up_addr)
+						++up_addr->chksum_err;
 #ifdef _WITH_SNMP_RFC_
 					vrrp->stats->chk_err++;
 #ifdef _WITH_SNMP_RFCV3_
@@ -1130,6 +1246,8 @@ vrrp_check_packet(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buffer, ssize_t
 
 			if (csum_calc) {
 				log_rate_limited_error(vrrp, VRRP_RLFLAG_BAD_CHECKSUM, "(%s) Invalid VRRPv2 checksum from %s", vrrp->iname, inet_sockaddrtos(&vrrp->pkt_saddr));
+				if (up_addr)
+					++up_addr->chksum_err;
 #ifdef _WITH_SNMP_RFC_
 				vrrp->stats->chk_err++;
 #ifdef _WITH_SNMP_RFCV3_
@@ -1167,6 +1285,10 @@ vrrp_check_packet(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buffer, ssize_t
 
 	/* Correct type, version, and length. Count as VRRP advertisement */
 	++vrrp->stats->advert_rcvd;
+	if (up_addr) {
+		++up_addr->advert_rcvd;
+		up_addr->last_rcvd = time_now;
+	}
 
 	/* pointer to vrrp vips pkt zone */
 	vips = (const char *)hd + sizeof(vrrphdr_t);
@@ -1180,25 +1302,27 @@ vrrp_check_packet(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buffer, ssize_t
 		 * MAY verify that the IP address(es) associated with the
 		 * VRID are valid
 		 */
-		bool addr_ok = true;
+		size_t list_len = hd->naddr * (vrrp->family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr));
+		const void *missing_vip;
 
-		/* We have checked that the number of VIPs match, and since
+		/* Adverts from the same master normally carry the same list,
+		 * so if it is unchanged since the last valid advert there is
+		 * nothing more to check.
+		 * We have checked that the number of VIPs match, and since
 		 * all VIPs are different, if every VIP is in the advert, then
 		 * the two lists must have exactly the same entries. */
-		list_for_each_entry(ipaddress, &vrrp->vip, e_list) {
-			if (!vrrp_in_chk_vips(vrrp, ipaddress, vips, hd->naddr)) {
-				log_rate_limited_error(vrrp, VRRP_RLFLAG_VIPS_MISMATCH, "(%s) ip address associated with VRID %d"
-						      " not present in advert from %s: %s"
-						    , vrrp->iname, vrrp->vrid, inet_sockaddrtos(&vrrp->pkt_saddr)
-						    , inet_ntop(vrrp->family, vrrp->family == AF_INET6 ? &ipaddress->u.sin6_addr : (void *)&ipaddress->u.sin.sin_addr.s_addr,
-						      addr_str, sizeof(addr_str)));
-				if (addr_ok) {
-					++vrrp->stats->addr_list_err;
-					addr_ok = false;
-				}
-			}
-			if (!addr_ok)
-				break;
+		if (!hd->naddr ||
+		    (vrrp->vip_last_rx_valid && !memcmp(vips, vrrp->vip_last_rx, list_len)))
+			;
+		else if ((missing_vip = vrrp_find_missing_vip(vrrp, vips, hd->naddr))) {
+			log_rate_limited_error(vrrp, VRRP_RLFLAG_VIPS_MISMATCH, "(%s) ip address associated with VRID %d"
+					      " not present in advert from %s: %s"
+					    , vrrp->iname, vrrp->vrid, inet_sockaddrtos(&vrrp->pkt_saddr)
+					    , inet_ntop(vrrp->family, missing_vip, addr_str, sizeof(addr_str)));
+			++vrrp->stats->addr_list_err;
+		} else {
+			memcpy(vrrp->vip_last_rx, vips, list_len);
+			vrrp->vip_last_rx_valid = true;
 		}
 	}
 
@@ -1206,40 +1330,14 @@ vrrp_check_packet(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buffer, ssize_t
 	if (__test_bit(VRRP_FLAG_UNICAST, &vrrp->flags) &&
 	    (global_data->vrrp_check_unicast_src ||
 	     __test_bit(VRRP_FLAG_CHECK_UNICAST_SRC, &vrrp->flags))) {
-		struct in_addr *saddr4 = NULL;	/* Avoid compiler warnings */
-		struct in6_addr *saddr6 = NULL;
-		bool found_match = false;
-
-		if (vrrp->family == AF_INET6) {
-			saddr6 = &PTR_CAST(struct sockaddr_in6, &vrrp->pkt_saddr)->sin6_addr;
-			list_for_each_entry(up_addr, &vrrp->unicast_peer, e_list) {
-				if (IN6_ARE_ADDR_EQUAL(saddr6, &PTR_CAST(struct sockaddr_in6, &up_addr->address)->sin6_addr)) {
-					if (!check_ttl_hl(vrrp, up_addr))
-						return VRRP_PACKET_DROP;
-					found_match = true;
-					break;
-				}
-			}
-		} else {
-			saddr4 = &PTR_CAST(struct sockaddr_in, &vrrp->pkt_saddr)->sin_addr;
-			list_for_each_entry(up_addr, &vrrp->unicast_peer, e_list) {
-				if (saddr4->s_addr == PTR_CAST(struct sockaddr_in, &up_addr->address)->sin_addr.s_addr) {
-					if (!check_ttl_hl(vrrp, up_addr))
-						return VRRP_PACKET_DROP;
-					found_match = true;
-					break;
-				}
-			}
-		}
-
-		if (!found_match) {
+		if (!up_addr) {
 			log_rate_limited_error(vrrp, VRRP_RLFLAG_UNKNOWN_UNICAST_SRC, "(%s) unicast source address %s not a unicast peer",
-				vrrp->iname,
-				inet_ntop(vrrp->family,
-					  vrrp->family == AF_INET6 ? (void *)saddr6 : (void *)saddr4,
-					  addr_str, sizeof(addr_str)));
+				vrrp->iname, inet_sockaddrtos(&vrrp->pkt_saddr));
 			return VRRP_PACKET_KO;
 		}
+
+		if (!check_ttl_hl(vrrp, up_addr))
+			return VRRP_PACKET_DROP;
 	}
 
 	if (hd->priority == 0)
@@ -1321,8 +1419,8 @@ vrrp_build_ipsecah(vrrp_t * vrrp, char *buffer, size_t buflen)
 	   => No padding needed.
 	   -- rfc2402.3.3.3.1.1.1 & rfc2401.5
 	 */
-	hmac_md5(PTR_CAST(unsigned char, buffer), buflen, NULL, 0, vrrp->auth_data, sizeof (vrrp->auth_data), digest);
-	memcpy(ah->auth_data, digest, HMAC_MD5_TRUNC);
+	if (hmac_md5(vrrp->auth_hmac, PTR_CAST(unsigned char, buffer), buflen, NULL, 0, digest))
+		memcpy(ah->auth_data, digest, HMAC_MD5_TRUNC);
 }
 #endif
 
@@ -1566,6 +1664,12 @@ vrrp_send_pkt(vrrp_t * vrrp, unicast_peer_t *peer)
 		check_tx_checksum(vrrp, peer);
 #endif
 
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	/* Keep a copy for the advert thread to repeat */
+	if (vrrp->advert_slot)
+		advert_thread_add_msg(vrrp, &msg, (peer) ? 0 : MSG_DONTROUTE);
+#endif
+
 	/* Send the packet */
 	return sendmsg(vrrp->sockets->fd_out, &msg, (peer) ? 0 : MSG_DONTROUTE);
 }
@@ -1579,6 +1683,30 @@ vrrp_alloc_send_buffer(vrrp_t * vrrp)
 	vrrp->send_buffer = MALLOC(vrrp->send_buffer_size);
 }
 
+/* Build the sorted VIP array used for checking the addresses in adverts */
+static void
+vrrp_alloc_vip_check(vrrp_t *vrrp)
+{
+	size_t addr_len = vrrp->family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+	ip_address_t *ip_addr;
+	char *p;
+
+	if (list_empty(&vrrp->vip))
+		return;
+
+	vrrp->vip_sorted = MALLOC(vrrp->vip_cnt * addr_len);
+	vrrp->vip_last_rx = MALLOC(vrrp->vip_cnt * addr_len);
+
+	p = vrrp->vip_sorted;
+	list_for_each_entry(ip_addr, &vrrp->vip, e_list) {
+		memcpy(p, vrrp->family == AF_INET ? (void *)&ip_addr->u.sin.sin_addr : (void *)&ip_addr->u.sin6_addr, addr_len);
+		p += addr_len;
+	}
+
+	qsort(vrrp->vip_sorted, vrrp->vip_cnt, addr_len,
+	      vrrp->family == AF_INET ? vrrp_addr4_cmp : vrrp_addr6_cmp);
+}
+
 /* send VRRP advertisement */
 void
 vrrp_send_adv(vrrp_t * vrrp, uint8_t prio)
@@ -1604,8 +1732,14 @@ vrrp_send_adv(vrrp_t * vrrp, uint8_t prio)
 	}
 #endif
 
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	if (vrrp->advert_slot)
+		advert_thread_prepare(vrrp, prio);
+#endif
+
 	/* build the packet */
-	vrrp_update_pkt(vrrp, prio, NULL);
+	if (!vrrp_update_pkt(vrrp, prio, NULL))
+		return;
 
 	/* Send the packet, but don't log an error if it is a prio 0 message
 	 * and the interface is down. */
@@ -1617,8 +1751,9 @@ vrrp_send_adv(vrrp_t * vrrp, uint8_t prio)
 			log_message(LOG_INFO, "(%s): send advert error %d (%m)", vrrp->iname, errno);
 	} else {
 		list_for_each_entry(peer, &vrrp->unicast_peer, e_list) {
-			if (vrrp->family == AF_INET)
-				vrrp_update_pkt(vrrp, prio, &peer->address);
+			if (vrrp->family == AF_INET &&
+			    !vrrp_update_pkt(vrrp, prio, &peer->address))
+				continue;
 			if (vrrp_send_pkt(vrrp, peer) == -1 &&
 			    (prio != VRRP_PRIO_STOP || errno != ENETUNREACH || (vrrp->ifp && IF_FLAGS_UP(vrrp->ifp))))
 				log_message(LOG_INFO, "(%s) Cant send advert to %s (%m)"
@@ -1626,6 +1761,11 @@ vrrp_send_adv(vrrp_t * vrrp, uint8_t prio)
 		}
 	}
 
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	if (vrrp->advert_slot)
+		advert_thread_post(vrrp);
+#endif
+
 	++vrrp->stats->advert_sent;
 }
 
@@ -1651,8 +1791,10 @@ vrrp_send_update(vrrp_t * vrrp, ip_address_t * ipaddress, bool log_msg, unsigned
 
 	if (!IP_IS6(ipaddress))
 		send_gratuitous_arp(ipaddress, rep);
-	else
-		ndisc_send_unsolicited_na(ipaddress, rep);
+	else if (ndisc_send_unsolicited_na(ipaddress, rep)) {
+		++vrrp->stats->na_sent;
+		++vrrp->stats->na_sent_failover;
+	}
 }
 
 void
@@ -1668,7 +1810,12 @@ vrrp_send_link_update(vrrp_t * vrrp, unsigned rep)
 	/* send gratuitous arp for each virtual ip.
 	 * Looping rep times through all VIPs of the vrrp instance doesn't
 	 * seem very efficient, but I haven't thought of a better way when
-	 * the GARP/NA may either be sent or queued. */
+	 * the GARP/NA may either be sent or queued.
+	 * The GARPs/NAs that are sent rather than queued go to the kernel
+	 * in one batch once all VIPs have been processed. */
+	gratuitous_arp_batch();
+	ndisc_batch();
+
 	for (j = 0; j < rep; j++) {
 		list_for_each_entry(ip_addr, &vrrp->vip, e_list)
 			vrrp_send_update(vrrp, ip_addr, !j, rep);
@@ -1676,6 +1823,9 @@ vrrp_send_link_update(vrrp_t * vrrp, unsigned rep)
 		list_for_each_entry(ip_addr, &vrrp->evip, e_list)
 			vrrp_send_update(vrrp, ip_addr, !j, rep);
 	}
+
+	gratuitous_arp_flush();
+	ndisc_flush();
 }
 
 #ifdef _HAVE_VRRP_VMAC_
@@ -1735,19 +1885,25 @@ vrrp_send_vmac_update(vrrp_t *vrrp)
 #endif
 
 static void
-vrrp_remove_delayed_arp(vrrp_t *vrrp)
+vrrp_remove_delayed_arp_list(list_head_t *l)
 {
 	ip_address_t *ip_addr;
+	garp_delay_t *gd;
 
-	list_for_each_entry(ip_addr, &vrrp->vip, e_list) {
+	list_for_each_entry(ip_addr, l, e_list) {
+		if (!list_empty(&ip_addr->garp_gna_list) &&
+		    (gd = IF_BASE_IFP(ip_addr->ifp)->garp_delay) && gd->rate)
+			garp_pacer_remove(gd, ip_addr);
 		ip_addr->garp_gna_pending = 0;
 		list_del_init(&ip_addr->garp_gna_list);
 	}
+}
 
-	list_for_each_entry(ip_addr, &vrrp->evip, e_list) {
-		ip_addr->garp_gna_pending = 0;
-		list_del_init(&ip_addr->garp_gna_list);
-	}
+static void
+vrrp_remove_delayed_arp(vrrp_t *vrrp)
+{
+	vrrp_remove_delayed_arp_list(&vrrp->vip);
+	vrrp_remove_delayed_arp_list(&vrrp->evip);
 }
 
 /* becoming master */
@@ -1755,6 +1911,7 @@ static void
 vrrp_state_become_master(vrrp_t * vrrp)
 {
 	++vrrp->stats->become_master;
+	vrrp->stats->na_sent_failover = 0;
 
 	/* If both us and another system claim to be the address owner then
 	 * we may have reduced our priority to 254 to ensure there are not
@@ -2094,6 +2251,8 @@ vrrp_state_backup(vrrp_t *vrrp, const vrrphdr_t *hd, const char *buf, ssize_t bu
 			    (!vrrp->preempt_time.tv_sec ||
 			     timercmp(&vrrp->preempt_time, &time_now, >)))) {
 			/* We are accepting the advert */
+			vrrp_rx_interval_update(vrrp, master_change);
+
 			if (vrrp->version == VRRP_VERSION_3) {
 				master_adver_int = V3_PKT_ADVER_INT_NTOH(hd->v3.adver_int) * TIMER_CENTI_HZ;
 				/* As per RFC5798, set Master_Adver_Interval to Adver Interval contained
@@ -2173,7 +2332,11 @@ vrrp_state_master_tx(vrrp_t * vrrp)
 	 * remove the VIPs before we send the gratuitous ARPs, so send
 	 * the advert first.
 	 */
-	vrrp_send_adv(vrrp, vrrp->effective_priority);
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	/* If the advert thread is already sending our adverts, just renew its lease */
+	if (!vrrp->advert_slot || !advert_thread_renew(vrrp, vrrp->effective_priority))
+#endif
+		vrrp_send_adv(vrrp, vrrp->effective_priority);
 
 	if (!VRRP_VIP_ISSET(vrrp)) {
 		log_message(LOG_INFO, "(%s) Entering MASTER STATE"
@@ -2790,11 +2953,15 @@ open_sockpool_socket(sock_t *sock)
 	} else if (sock->mcast_daddr && sock->mcast_daddr->ss_family == AF_INET6)
 		PTR_CAST(struct sockaddr_in6, sock->mcast_daddr)->sin6_scope_id = sock->ifp->ifindex;
 
-	sock->fd_in = open_vrrp_read_socket(sock->family, sock->proto, sock->ifp,
+#ifdef _WITH_VRRP_RX_RING_
+	if (!global_data->vrrp_rx_ring ||
+	    (sock->fd_in = open_vrrp_rx_ring(sock)) == -1)
+#endif
+		sock->fd_in = open_vrrp_read_socket(sock->family, sock->proto, sock->ifp,
 #ifdef _HAVE_VRF_
-					    sock->vrf_ifp,
+						    sock->vrf_ifp,
 #endif
-					    sock->mcast_daddr, sock->unicast_src, sock->rx_buf_size);
+						    sock->mcast_daddr, sock->unicast_src, sock->rx_buf_size);
 
 	if (sock->fd_in == -2) {
 		rb_for_each_entry(vrrp, &sock->rb_vrid, rb_vrid) {
@@ -2816,6 +2983,18 @@ open_sockpool_socket(sock_t *sock)
 						     sock->vrf_ifp,
 #endif
 						     sock->unicast_src);
+
+#ifdef _WITH_VRRP_RX_RING_
+	/* The receive ring only adds a link layer multicast address, so join
+	 * the group on the send socket for the IGMP/MLD reports to be sent.
+	 * The send socket discards anything it receives. */
+	if (sock->rx_ring && !sock->unicast_src && sock->fd_out != -1 &&
+	    if_join_vrrp_group(sock->family, &sock->fd_out, sock->ifp, sock->mcast_daddr) == -1) {
+		close_vrrp_rx_ring(sock);
+		close(sock->fd_in);
+		sock->fd_in = -1;
+	}
+#endif
 }
 
 /* Try to find a VRRP instance */
@@ -3125,6 +3304,7 @@ vrrp_complete_instance(vrrp_t * vrrp)
 #endif
 	ip_route_t *route;
 	ip_rule_t *rule;
+	unicast_peer_t *peer;
 
 	if (vrrp->strict_mode == PARAMETER_UNSET)
 		vrrp->strict_mode = global_data->vrrp_strict;
@@ -4277,9 +4457,22 @@ vrrp_complete_instance(vrrp_t * vrrp)
 		}
 	}
 
+#ifdef _WITH_VRRP_AUTH_
+	if (vrrp->auth_type == VRRP_AUTH_AH &&
+	    !(vrrp->auth_hmac = hmac_md5_init(vrrp->auth_data, sizeof(vrrp->auth_data)))) {
+		report_config_error(CONFIG_GENERAL_ERROR, "(%s) Unable to initialise IPSEC-AH HMAC-MD5", vrrp->iname);
+		return false;
+	}
+#endif
+
 	/* alloc send buffer */
 	vrrp_alloc_send_buffer(vrrp);
 	vrrp_build_pkt(vrrp);
+	vrrp_alloc_vip_check(vrrp);
+
+	/* Index the unicast peers for looking up the source of adverts */
+	list_for_each_entry(peer, &vrrp->unicast_peer, e_list)
+		rb_add(&peer->rb_peer, &vrrp->unicast_peer_tree, vrrp_unicast_peer_less);
 
 	return true;
 }
@@ -4958,7 +5151,7 @@ vrrp_complete_init(void)
 			 vrrp_notify_fifo_script_exit, "vrrp_");
 
 	/* If we have a global garp_delay add it to any interfaces without a garp_delay */
-	if (global_data->vrrp_garp_interval || global_data->vrrp_gna_interval)
+	if (global_data->vrrp_garp_interval || global_data->vrrp_gna_interval || global_data->vrrp_garp_rate)
 		set_default_garp_delay();
 
 	/* See if any static routes or rules need monitoring */
@@ -0,0 +1,578 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Real-time thread sending periodic adverts for master instances.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+/* The main thread remains in charge of the VRRP state machine. Once an
+ * instance is master, each advert it sends is also copied into an "image"
+ * (one prebuilt packet per destination) which is handed to the advert
+ * thread through a per instance mailbox. The advert thread then repeats
+ * the image every advert interval from its own timer, so a busy main
+ * loop no longer delays adverts.
+ *
+ * The main thread renews a lease on each pass through
+ * vrrp_state_master_tx(), posts a new image if the priority or source
+ * address change, and releases the instance whenever it stops being
+ * master. If the lease is not renewed within ADVERT_THREAD_LEASE advert
+ * intervals the advert thread stops sending for that instance.
+ *
+ * All communication between the threads is via atomic variables. The
+ * advert thread never allocates or frees memory, nor logs; images it has
+ * finished with are queued for the main thread to free.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/ip.h>
+#include <sys/eventfd.h>
+
+#include "vrrp_advert_thread.h"
+#include "vrrp_data.h"
+#include "global_data.h"
+#include "logger.h"
+#include "memory.h"
+#include "timer.h"
+#include "utils.h"
+
+typedef struct _advert_image advert_image_t;
+
+/* A prebuilt advert for one destination */
+typedef struct _advert_dest {
+	sockaddr_t		addr;
+	struct iovec		iov;
+	char			cbuf[CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(unsigned))]
+					__attribute__((aligned(__alignof__(struct cmsghdr))));
+} advert_dest_t;
+
+/* Everything the advert thread needs to send an instance's adverts */
+struct _advert_image {
+	advert_image_t		*next;		/* Retired images list */
+	int			fd;		/* dup() of the instance's send socket */
+	int			flags;		/* sendmmsg flags */
+	bool			ipv4;		/* The thread updates the IP id */
+	uint16_t		ip_id;
+	uint64_t		interval;	/* nsecs */
+	uint64_t		posted;		/* CLOCK_MONOTONIC nsecs when last sent by main thread */
+	unsigned		num_dest;
+	unsigned		max_dest;
+	size_t			pkt_len;
+	struct mmsghdr		*msgs;
+	advert_dest_t		*dests;
+	char			*pkts;
+};
+
+struct _advert_slot {
+	/* Written by the main thread, read by the advert thread */
+	_Atomic(advert_image_t *) mailbox;
+	_Atomic uint64_t	lease_end;	/* CLOCK_MONOTONIC nsecs, 0 if released */
+
+	/* Written by the advert thread, read by the main thread */
+	atomic_uint		sent;
+	atomic_uint		errors;
+	atomic_int		last_errno;
+
+	/* Only accessed by the advert thread */
+	advert_image_t		*image;
+	uint64_t		next_send;
+
+	/* Only accessed by the main thread */
+	advert_image_t		*building;
+	bool			active;
+	uint8_t			prio;
+	sockaddr_t		saddr;
+};
+
+/* Global vars */
+static pthread_t advert_thread;
+static bool advert_thread_running;
+static int advert_thread_efd = -1;
+static atomic_bool advert_thread_stop;
+static advert_slot_t *advert_slots;
+static unsigned num_advert_slots;
+static _Atomic(advert_image_t *) retired_images;
+
+static uint64_t
+advert_time_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Advert thread side
+ */
+static void
+advert_image_send(advert_slot_t *slot)
+{
+	advert_image_t *image = slot->image;
+	struct iphdr *ip;
+	unsigned i;
+	int ret;
+
+	if (image->ipv4) {
+		/* kernel will fill in ID if left to 0, so we overflow to 1 */
+		if (!++image->ip_id)
+			++image->ip_id;
+		for (i = 0; i < image->num_dest; i++) {
+			ip = PTR_CAST(struct iphdr, image->dests[i].iov.iov_base);
+			ip->id = htons(image->ip_id);
+		}
+	}
+
+	ret = sendmmsg(image->fd, image->msgs, image->num_dest, image->flags);
+	if (ret < 0) {
+		atomic_store_explicit(&slot->last_errno, errno, memory_order_relaxed);
+		ret = 0;
+	}
+	if ((unsigned)ret < image->num_dest)
+		atomic_fetch_add_explicit(&slot->errors, image->num_dest - (unsigned)ret, memory_order_relaxed);
+
+	/* The main thread counts adverts, not packets */
+	atomic_fetch_add_explicit(&slot->sent, 1, memory_order_relaxed);
+}
+
+static void
+advert_image_retire(advert_image_t *image)
+{
+	image->next = atomic_load_explicit(&retired_images, memory_order_relaxed);
+	while (!atomic_compare_exchange_weak_explicit(&retired_images, &image->next, image,
+						      memory_order_release, memory_order_relaxed));
+}
+
+static void *
+advert_thread_main(__attribute__((unused)) void *arg)
+{
+	struct pollfd pfd = { .fd = advert_thread_efd, .events = POLLIN };
+	struct timespec ts;
+	advert_slot_t *slot;
+	advert_image_t *image;
+	uint64_t now, next, lease;
+	uint64_t val;
+	unsigned i;
+
+	while (!atomic_load(&advert_thread_stop)) {
+		now = advert_time_now();
+		next = now + NSEC_PER_SEC;
+
+		for (i = 0, slot = advert_slots; i < num_advert_slots; i++, slot++) {
+			if ((image = atomic_exchange_explicit(&slot->mailbox, NULL, memory_order_acquire))) {
+				if (slot->image)
+					advert_image_retire(slot->image);
+				slot->image = image;
+				slot->next_send = image->posted + image->interval;
+			}
+
+			if (!slot->image)
+				continue;
+
+			lease = atomic_load_explicit(&slot->lease_end, memory_order_relaxed);
+			if (lease <= now)
+				continue;
+
+			if (slot->next_send <= now) {
+				/* Recheck the lease immediately before sending, to minimise
+				 * the window after the main thread releases the instance */
+				if (atomic_load_explicit(&slot->lease_end, memory_order_acquire) <= now)
+					continue;
+
+				advert_image_send(slot);
+
+				slot->next_send += slot->image->interval;
+				if (slot->next_send <= now)
+					slot->next_send = now + slot->image->interval;
+			}
+
+			if (slot->next_send < next)
+				next = slot->next_send;
+		}
+
+		now = advert_time_now();
+		if (next > now) {
+			ts.tv_sec = (time_t)((next - now) / NSEC_PER_SEC);
+			ts.tv_nsec = (long)((next - now) % NSEC_PER_SEC);
+		} else
+			ts.tv_sec = ts.tv_nsec = 0;
+
+		if (ppoll(&pfd, 1, &ts, NULL) > 0 &&
+		    read(advert_thread_efd, &val, sizeof(val)) == -1) {
+			/* Nothing to do, the eventfd is just a wakeup */
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Main thread side
+ */
+static void
+free_advert_image(advert_image_t *image)
+{
+	if (image->fd != -1)
+		close(image->fd);
+	FREE(image->msgs);
+	FREE(image->dests);
+	FREE(image->pkts);
+	FREE(image);
+}
+
+static void
+free_retired_images(void)
+{
+	advert_image_t *image, *next;
+
+	for (image = atomic_exchange_explicit(&retired_images, NULL, memory_order_acquire); image; image = next) {
+		next = image->next;
+		free_advert_image(image);
+	}
+}
+
+static void
+advert_thread_wakeup(void)
+{
+	uint64_t val = 1;
+
+	if (write(advert_thread_efd, &val, sizeof(val)) == -1)
+		log_message(LOG_INFO, "advert thread wakeup error %d (%m)", errno);
+}
+
+static void
+advert_thread_harvest(vrrp_t *vrrp)
+{
+	advert_slot_t *slot = vrrp->advert_slot;
+	unsigned errors;
+
+	vrrp->stats->advert_sent += atomic_exchange_explicit(&slot->sent, 0, memory_order_relaxed);
+
+	if ((errors = atomic_exchange_explicit(&slot->errors, 0, memory_order_relaxed))) {
+		errno = atomic_load_explicit(&slot->last_errno, memory_order_relaxed);
+		log_message(LOG_INFO, "(%s): advert thread had %u send errors, last %d (%m)", vrrp->iname, errors, errno);
+	}
+}
+
+bool
+advert_thread_eligible(const vrrp_t *vrrp)
+{
+#ifdef _WITH_VRRP_AUTH_
+	/* The IPSEC-AH sequence number and ICV change with each advert */
+	if (vrrp->auth_type == VRRP_AUTH_AH)
+		return false;
+#endif
+
+	return vrrp->adver_int != 0;
+}
+
+/* Called from vrrp_state_master_tx(). Returns true if the advert thread
+ * is sending the current adverts for the instance, otherwise the caller
+ * should send the advert itself. */
+bool
+advert_thread_renew(vrrp_t *vrrp, uint8_t prio)
+{
+	advert_slot_t *slot = vrrp->advert_slot;
+
+	free_retired_images();
+
+	if (!slot->active ||
+	    slot->prio != prio ||
+	    (vrrp->saddr.ss_family && inet_sockaddrcmp(&vrrp->saddr, &slot->saddr)))
+		return false;
+
+	atomic_store_explicit(&slot->lease_end, advert_time_now() + (uint64_t)vrrp->adver_int * (NSEC_PER_SEC / TIMER_HZ) * ADVERT_THREAD_LEASE, memory_order_relaxed);
+
+	advert_thread_harvest(vrrp);
+	vrrp->last_advert_sent = time_now;
+
+	return true;
+}
+
+/* Called by vrrp_send_adv() before it builds and sends the adverts */
+void
+advert_thread_prepare(vrrp_t *vrrp, uint8_t prio)
+{
+	advert_slot_t *slot = vrrp->advert_slot;
+	advert_image_t *image;
+	unsigned num_dest = 1;
+	unicast_peer_t *peer;
+
+	if (prio == VRRP_PRIO_STOP || vrrp->state != VRRP_STATE_MAST) {
+		advert_thread_release(vrrp);
+		return;
+	}
+
+	/* If the advert thread already has the same adverts there is nothing to do */
+	if (slot->active && slot->prio == prio &&
+	    (!vrrp->saddr.ss_family || !inet_sockaddrcmp(&vrrp->saddr, &slot->saddr)))
+		return;
+
+	if (__test_bit(VRRP_FLAG_UNICAST, &vrrp->flags)) {
+		num_dest = 0;
+		list_for_each_entry(peer, &vrrp->unicast_peer, e_list)
+			num_dest++;
+		if (!num_dest)
+			return;
+	}
+
+	if (slot->building)
+		free_advert_image(slot->building);
+
+	PMALLOC(image);
+	image->fd = dup(vrrp->sockets->fd_out);
+	if (image->fd == -1) {
+		log_message(LOG_INFO, "(%s): unable to dup socket for advert thread - %d (%m)", vrrp->iname, errno);
+		FREE(image);
+		slot->building = NULL;
+		return;
+	}
+	image->flags = __test_bit(VRRP_FLAG_UNICAST, &vrrp->flags) ? 0 : MSG_DONTROUTE;
+	image->ipv4 = vrrp->family == AF_INET;
+	image->ip_id = (uint16_t)vrrp->ip_id;
+	image->interval = (uint64_t)vrrp->adver_int * (NSEC_PER_SEC / TIMER_HZ);
+	image->max_dest = num_dest;
+	image->pkt_len = vrrp->send_buffer_size;
+	image->msgs = MALLOC(num_dest * sizeof(*image->msgs));
+	image->dests = MALLOC(num_dest * sizeof(*image->dests));
+	image->pkts = MALLOC(num_dest * image->pkt_len);
+
+	slot->building = image;
+	slot->prio = prio;
+	slot->saddr = vrrp->saddr;
+}
+
+/* Called by vrrp_send_pkt() for each message it sends */
+void
+advert_thread_add_msg(vrrp_t *vrrp, const struct msghdr *msg, int flags)
+{
+	advert_image_t *image = vrrp->advert_slot->building;
+	advert_dest_t *dest;
+	struct msghdr *hdr;
+
+	if (!image || image->num_dest >= image->max_dest ||
+	    msg->msg_iov[0].iov_len != image->pkt_len ||
+	    msg->msg_namelen > sizeof(dest->addr) ||
+	    msg->msg_controllen > sizeof(dest->cbuf) ||
+	    flags != image->flags)
+		return;
+
+	dest = &image->dests[image->num_dest];
+	hdr = &image->msgs[image->num_dest].msg_hdr;
+
+	dest->iov.iov_base = image->pkts + image->num_dest * image->pkt_len;
+	dest->iov.iov_len = image->pkt_len;
+	memcpy(dest->iov.iov_base, msg->msg_iov[0].iov_base, image->pkt_len);
+	memcpy(&dest->addr, msg->msg_name, msg->msg_namelen);
+
+	hdr->msg_name = &dest->addr;
+	hdr->msg_namelen = msg->msg_namelen;
+	hdr->msg_iov = &dest->iov;
+	hdr->msg_iovlen = 1;
+	if (msg->msg_controllen) {
+		memcpy(dest->cbuf, msg->msg_control, msg->msg_controllen);
+		hdr->msg_control = dest->cbuf;
+		hdr->msg_controllen = msg->msg_controllen;
+	}
+
+	image->num_dest++;
+}
+
+/* Called by vrrp_send_adv() once the adverts have been sent */
+void
+advert_thread_post(vrrp_t *vrrp)
+{
+	advert_slot_t *slot = vrrp->advert_slot;
+	advert_image_t *image = slot->building;
+
+	free_retired_images();
+
+	if (!image)
+		return;
+
+	slot->building = NULL;
+
+	/* If not all the adverts were captured, leave it to the main thread */
+	if (image->num_dest != image->max_dest) {
+		free_advert_image(image);
+		advert_thread_release(vrrp);
+		return;
+	}
+
+	image->posted = advert_time_now();
+	atomic_store_explicit(&slot->lease_end, image->posted + image->interval * ADVERT_THREAD_LEASE, memory_order_relaxed);
+
+	/* If the advert thread hasn't collected the previous image, it never will */
+	if ((image = atomic_exchange_explicit(&slot->mailbox, image, memory_order_release)))
+		free_advert_image(image);
+
+	slot->active = true;
+
+	advert_thread_wakeup();
+}
+
+void
+advert_thread_release(vrrp_t *vrrp)
+{
+	advert_slot_t *slot = vrrp->advert_slot;
+
+	if (!slot || !slot->active)
+		return;
+
+	atomic_store_explicit(&slot->lease_end, 0, memory_order_release);
+	slot->active = false;
+
+	advert_thread_harvest(vrrp);
+}
+
+void
+start_vrrp_advert_thread(void)
+{
+	pthread_attr_t attr;
+	struct sched_param param = { .sched_priority = 0 };
+	sigset_t sigset, cursigset;
+	unsigned num_slots = 0;
+	unsigned i;
+	vrrp_t *vrrp;
+	int max_priority;
+	int ret;
+
+	if (!global_data->vrrp_advert_thread || advert_thread_running)
+		return;
+
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list) {
+		if (advert_thread_eligible(vrrp))
+			num_slots++;
+	}
+
+	if (!num_slots)
+		return;
+
+	if ((advert_thread_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		log_message(LOG_INFO, "Unable to create advert thread eventfd - %d (%m)", errno);
+		return;
+	}
+
+	advert_slots = MALLOC(num_slots * sizeof(*advert_slots));
+	num_advert_slots = num_slots;
+
+	i = 0;
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list) {
+		if (advert_thread_eligible(vrrp))
+			vrrp->advert_slot = &advert_slots[i++];
+	}
+
+	/* Default to running just above the vrrp process real-time priority */
+	max_priority = sched_get_priority_max(SCHED_FIFO);
+	if (global_data->vrrp_advert_thread_priority)
+		param.sched_priority = (int)global_data->vrrp_advert_thread_priority;
+	else if (global_data->vrrp_realtime_priority)
+		param.sched_priority = (int)global_data->vrrp_realtime_priority < max_priority ? (int)global_data->vrrp_realtime_priority + 1 : max_priority;
+	else
+		param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+
+	atomic_store(&advert_thread_stop, false);
+
+	/* Block signals (all) we don't want the new thread to process */
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_SETMASK, &sigset, &cursigset);
+
+	ret = pthread_create(&advert_thread, &attr, &advert_thread_main, NULL);
+	if (ret == EPERM) {
+		log_message(LOG_INFO, "Unable to set advert thread real-time priority %d, using standard scheduling", param.sched_priority);
+		param.sched_priority = 0;
+		ret = pthread_create(&advert_thread, NULL, &advert_thread_main, NULL);
+	}
+
+	/* Reenable our signals */
+	pthread_sigmask(SIG_SETMASK, &cursigset, NULL);
+
+	pthread_attr_destroy(&attr);
+
+	if (ret) {
+		errno = ret;
+		log_message(LOG_INFO, "Unable to create advert thread - %d (%m)", ret);
+		list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list)
+			vrrp->advert_slot = NULL;
+		FREE(advert_slots);
+		num_advert_slots = 0;
+		close(advert_thread_efd);
+		advert_thread_efd = -1;
+		return;
+	}
+
+	advert_thread_running = true;
+
+	log_message(LOG_INFO, "Started advert thread for %u instance%s, priority %d", num_slots, num_slots == 1 ? "" : "s", param.sched_priority);
+}
+
+void
+stop_vrrp_advert_thread(void)
+{
+	advert_slot_t *slot;
+	advert_image_t *image;
+	vrrp_t *vrrp;
+	unsigned i;
+
+	if (!advert_thread_running)
+		return;
+
+	atomic_store(&advert_thread_stop, true);
+	advert_thread_wakeup();
+	pthread_join(advert_thread, NULL);
+	advert_thread_running = false;
+
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list) {
+		if (!vrrp->advert_slot)
+			continue;
+		advert_thread_harvest(vrrp);
+		vrrp->advert_slot = NULL;
+	}
+
+	for (i = 0, slot = advert_slots; i < num_advert_slots; i++, slot++) {
+		if (slot->image)
+			free_advert_image(slot->image);
+		if ((image = atomic_load(&slot->mailbox)))
+			free_advert_image(image);
+		if (slot->building)
+			free_advert_image(slot->building);
+	}
+	free_retired_images();
+
+	FREE(advert_slots);
+	num_advert_slots = 0;
+	close(advert_thread_efd);
+	advert_thread_efd = -1;
+
+	log_message(LOG_INFO, "Stopped advert thread");
+}
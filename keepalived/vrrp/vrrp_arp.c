@@ -32,6 +32,7 @@
 #include <linux/if_packet.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <sys/socket.h>
 
 /* local includes */
 #include "logger.h"
@@ -42,30 +43,70 @@
 #include "vrrp_arp.h"
 
 /*
- * The size of the garp_buffer should be the large enough to hold
+ * The gratuitous ARP frame for each address is built once and cached in
+ * ipaddress->frame. IP_ADDR_FRAME_SIZE must be large enough to hold
  * the largest arp packet to be sent + the size of the link layer header
- * for the corresponding protocol
+ * for the corresponding protocol, i.e.
+ *   sizeof(inf_arphdr_t) + sizeof(ipoib_hdr_t) + INFINIBAND_ALEN
  * For infiniband the link layer header consists of the destination MAC
  * address(20 bytes) and protocol identifier of the encapsulated
  * datagram(4 bytes). This is larger than the space required for Ethernet
  */
-#define GARP_BUFFER_SIZE (sizeof(inf_arphdr_t) + sizeof (ipoib_hdr_t) +\
-			  (INFINIBAND_ALEN))
+
+/* Maximum number of frames handed to the kernel in one sendmmsg() call */
+#define GARP_BATCH_SIZE	64
 
 /* static vars */
-static char *garp_buffer;
 static int garp_fd = -1;
 
+/* Frames queued while batching, sent by gratuitous_arp_flush() */
+static bool garp_batching;
+static unsigned garp_batch_len;
+static struct mmsghdr garp_msgs[GARP_BATCH_SIZE];
+static struct iovec garp_iovs[GARP_BATCH_SIZE];
+static struct sockaddr_large_ll garp_dests[GARP_BATCH_SIZE];
+static ip_address_t *garp_addrs[GARP_BATCH_SIZE];
+
+static void
+log_send_arp_error(const ip_address_t *ipaddress)
+{
+	/* coverity[bad_printf_format_string] */
+	log_message(LOG_INFO, "Error %d (%m) sending gratuitous ARP on %s for %s", errno,
+		    IF_NAME(ipaddress->ifp), inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
+}
+
+static void
+garp_batch_send(void)
+{
+	unsigned sent = 0;
+	int ret;
+
+	while (sent < garp_batch_len) {
+		ret = sendmmsg(garp_fd, garp_msgs + sent, garp_batch_len - sent, 0);
+		if (ret < 0) {
+			/* The frame at sent failed; report it and carry on with the rest */
+			log_send_arp_error(garp_addrs[sent]);
+			sent++;
+		} else
+			sent += (unsigned)ret;
+	}
+
+	garp_batch_len = 0;
+}
+
 /* Send the gratuitous ARP message */
-static ssize_t send_arp(ip_address_t *ipaddress, ssize_t pack_len)
+static ssize_t send_arp(ip_address_t *ipaddress)
 {
 	interface_t *ifp = ipaddress->ifp;
-	struct sockaddr_storage ss;
-	struct sockaddr_large_ll *sll = PTR_CAST(struct sockaddr_large_ll, &ss);
+	struct sockaddr_large_ll *sll;
 	ssize_t len;
 
+	if (garp_batching && garp_batch_len == GARP_BATCH_SIZE)
+		garp_batch_send();
+
 	/* Build the dst device */
-	memset(&ss, 0, sizeof(ss));
+	sll = &garp_dests[garp_batch_len];
+	memset(sll, 0, sizeof(*sll));
 	sll->sll_family = AF_PACKET;
 	sll->sll_hatype = ifp->hw_type;
 	sll->sll_protocol = htons(ETHERTYPE_ARP);
@@ -81,30 +122,50 @@ static ssize_t send_arp(ip_address_t *ipaddress, ssize_t pack_len)
 			    ifp->ifname,
 			    inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
 
+	if (garp_batching) {
+		/* The frame stays in ipaddress->frame until the batch is flushed */
+		garp_iovs[garp_batch_len].iov_base = ipaddress->frame;
+		garp_iovs[garp_batch_len].iov_len = ipaddress->frame_len;
+		garp_msgs[garp_batch_len].msg_hdr = (struct msghdr){
+			.msg_name = sll,
+			.msg_namelen = sizeof(*sll),
+			.msg_iov = &garp_iovs[garp_batch_len],
+			.msg_iovlen = 1,
+		};
+		garp_addrs[garp_batch_len++] = ipaddress;
+
+		return ipaddress->frame_len;
+	}
+
 	/* Send packet */
-	len = sendto(garp_fd, garp_buffer, pack_len, 0,
+	len = sendto(garp_fd, ipaddress->frame, ipaddress->frame_len, 0,
 		     PTR_CAST(struct sockaddr, sll), sizeof(*sll));
-	if (len < 0) {
-		/* coverity[bad_printf_format_string] */
-		log_message(LOG_INFO, "Error %d (%m) sending gratuitous ARP on %s for %s", errno,
-			    IF_NAME(ipaddress->ifp), inet_ntop2(ipaddress->u.sin.sin_addr.s_addr));
-	}
+	if (len < 0)
+		log_send_arp_error(ipaddress);
+
 	return len;
 }
 
-/* Build a gratuitous ARP message over a specific interface */
-ssize_t send_gratuitous_arp_immediate(interface_t *ifp, ip_address_t *ipaddress)
+/* Offset of the sender hardware address in a GARP frame built for ifp */
+static size_t
+garp_sha_offset(const interface_t *ifp)
+{
+	if (ifp->hw_type == ARPHRD_INFINIBAND)
+		return ifp->hw_addr_len + sizeof(ipoib_hdr_t) + sizeof(struct arphdr);
+
+	return ETHER_HDR_LEN + sizeof(struct arphdr);
+}
+
+/* Build the gratuitous ARP frame for ipaddress into its frame cache */
+static void
+build_garp_frame(interface_t *ifp, ip_address_t *ipaddress)
 {
 	char *hwaddr = PTR_CAST(char, IF_HWADDR(ipaddress->ifp));
+	char *garp_buffer = ipaddress->frame;
 	struct arphdr *arph;
 	char *arp_ptr;
-	ssize_t len, pack_len;
-
-	if (ifp->hw_addr_len == 0)
-		return -1;
 
-	if (!garp_buffer)
-		return -1;
+	memset(garp_buffer, 0, sizeof(ipaddress->frame));
 
 	/* Setup link layer header */
 	if (ifp->hw_type == ARPHRD_INFINIBAND) {
@@ -145,16 +206,34 @@ ssize_t send_gratuitous_arp_immediate(interface_t *ifp, ip_address_t *ipaddress)
 	       sizeof(struct in_addr));
 	arp_ptr += sizeof(struct in_addr);
 
-	pack_len = arp_ptr - garp_buffer;
-	len = send_arp(ipaddress, pack_len);
+	ipaddress->frame_len = (uint8_t)(arp_ptr - garp_buffer);
+	ipaddress->frame_ifindex = ifp->ifindex;
+}
+
+/* Send a gratuitous ARP message over a specific interface */
+ssize_t send_gratuitous_arp_immediate(interface_t *ifp, ip_address_t *ipaddress)
+{
+	ssize_t len;
+
+	if (ifp->hw_addr_len == 0)
+		return -1;
+
+	if (garp_fd == -1)
+		return -1;
+
+	/* The cached frame is only valid if it was built for this interface
+	 * and the interface MAC address has not changed since */
+	if (!ipaddress->frame_len ||
+	    ipaddress->frame_ifindex != ifp->ifindex ||
+	    memcmp(ipaddress->frame + garp_sha_offset(ifp), IF_HWADDR(ipaddress->ifp), ifp->hw_addr_len))
+		build_garp_frame(ifp, ipaddress);
+
+	len = send_arp(ipaddress);
 
 	/* If we have to delay between sending garps, note the next time we can */
 	if (ifp->garp_delay && ifp->garp_delay->have_garp_interval)
 		ifp->garp_delay->garp_next_time = timer_add_now(ifp->garp_delay->garp_interval);
 
-	/* Cleanup room for next round */
-	memset(garp_buffer, 0, GARP_BUFFER_SIZE);
-
 	return len;
 }
 
@@ -170,6 +249,25 @@ queue_garp(interface_t *ifp, ip_address_t *ipaddress)
 	list_add_tail(&ipaddress->garp_gna_list, &ifp->garp_delay->garp_list);
 }
 
+/* Gratuitous ARPs sent between gratuitous_arp_batch() and gratuitous_arp_flush()
+ * are held back and handed to the kernel together. Rate limiting by garp_delay
+ * is unaffected, since it is applied before a frame is added to the batch. */
+void
+gratuitous_arp_batch(void)
+{
+	if (garp_fd != -1)
+		garp_batching = true;
+}
+
+void
+gratuitous_arp_flush(void)
+{
+	if (garp_batch_len)
+		garp_batch_send();
+
+	garp_batching = false;
+}
+
 void
 send_gratuitous_arp(ip_address_t *ipaddress, unsigned rep)
 {
@@ -180,13 +278,27 @@ send_gratuitous_arp(ip_address_t *ipaddress, unsigned rep)
 		return;
 
 	if (ipaddress->garp_gna_pending) {
-		if (ipaddress->garp_gna_pending < rep)
+		if (ipaddress->garp_gna_pending < rep) {
 			ipaddress->garp_gna_pending++;
+			if (ifp->garp_delay && ifp->garp_delay->rate)
+				garp_pacer_pending(ifp->garp_delay);
+		}
 		return;
 	}
 
 	set_time_now();
 
+	/* If rate limited by a token bucket, send now if a token is available */
+	if (ifp->garp_delay && ifp->garp_delay->rate) {
+		if (garp_pacer_send_now(ifp->garp_delay))
+			send_gratuitous_arp_immediate(ifp, ipaddress);
+		else {
+			ipaddress->garp_gna_pending = 1;
+			garp_pacer_queue(ifp->garp_delay, ipaddress, &ifp->garp_delay->garp_list);
+		}
+		return;
+	}
+
 	/* Do we need to delay sending the garp? */
 	if (ifp->garp_delay &&
 	    ifp->garp_delay->have_garp_interval &&
@@ -203,7 +315,7 @@ send_gratuitous_arp(ip_address_t *ipaddress, unsigned rep)
 bool
 gratuitous_arp_init(void)
 {
-	if (garp_buffer)
+	if (garp_fd != -1)
 		return true;
 
 	/* Create the socket descriptor */
@@ -220,18 +332,13 @@ gratuitous_arp_init(void)
 	/* We don't want to receive any data on this socket */
 	if_setsockopt_no_receive(&garp_fd);
 
-	/* Initalize shared buffer */
-	garp_buffer = PTR_CAST(char, MALLOC(GARP_BUFFER_SIZE));
-
 	return true;
 }
 
 void gratuitous_arp_close(void)
 {
-	if (garp_buffer) {
-		FREE(garp_buffer);
-		garp_buffer = NULL;
-	}
+	garp_batching = false;
+	garp_batch_len = 0;
 
 	if (garp_fd != -1) {
 		close(garp_fd);
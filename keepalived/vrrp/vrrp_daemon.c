@@ -41,6 +41,7 @@
 #include "scheduler.h"
 #include "smtp.h"
 #include "vrrp_track.h"
+#include "coprocess.h"
 #endif
 #include "vrrp_daemon.h"
 #include "vrrp_scheduler.h"
@@ -52,6 +53,7 @@
 #include "vrrp_parser.h"
 #include "vrrp.h"
 #include "vrrp_print.h"
+#include "vrrp_stats_shm.h"
 #include "global_data.h"
 #include "pidfile.h"
 #include "logger.h"
@@ -75,6 +77,9 @@
 #ifdef _WITH_JSON_
 #include "vrrp_json.h"
 #endif
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+#include "vrrp_advert_thread.h"
+#endif
 #ifdef _WITH_BFD_
 #include "bfd_daemon.h"
 #endif
@@ -303,6 +308,7 @@ vrrp_terminate_phase2(int exit_status)
 #endif
 
 	kernel_netlink_close_cmd();
+	coprocess_release();
 	thread_destroy_master(master);
 	master = NULL;
 	gratuitous_arp_close();
@@ -324,6 +330,8 @@ vrrp_terminate_phase2(int exit_status)
 	if (global_data->disable_local_igmp)
 		reset_disable_local_igmp();
 
+	vrrp_stats_shm_close();
+
 	free_global_data(&global_data);
 	free_vrrp_data(&vrrp_data);
 	free_vrrp_buffer();
@@ -410,6 +418,11 @@ vrrp_terminate_phase1(bool schedule_next_thread)
 
 	kernel_netlink_close_monitor();
 
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	/* The main thread must send the final adverts */
+	stop_vrrp_advert_thread();
+#endif
+
 #ifdef _NETLINK_TIMERS_
 	if (do_netlink_timers)
 		report_and_clear_netlink_timers("Start shutdown");
@@ -705,6 +718,9 @@ start_vrrp(data_t *prev_global_data)
 	netlink_rtlist(&vrrp_data->static_routes, IPROUTE_ADD, false);
 	netlink_rulelist(&vrrp_data->static_rules, IPRULE_ADD, false);
 
+	/* Create or replace the live statistics file */
+	vrrp_stats_shm_init();
+
 	/* Dump configuration */
 	if (__test_bit(DUMP_CONF_BIT, &debug))
 		dump_data_vrrp(NULL);
@@ -834,6 +850,11 @@ reload_vrrp_thread(__attribute__((unused)) thread_ref_t thread)
 	/* Use standard scheduling while reloading */
 	reset_priority();
 
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	/* The sockets and instances are about to be replaced */
+	stop_vrrp_advert_thread();
+#endif
+
 #ifndef _ONE_PROCESS_DEBUG_
 	save_config(false, "vrrp", dump_data_vrrp);
 #endif
@@ -871,6 +892,7 @@ reload_vrrp_thread(__attribute__((unused)) thread_ref_t thread)
 	cancel_vrrp_threads();
 #endif
 	cancel_kernel_netlink_threads();
+	coprocess_release();
 	thread_cleanup_master(master, true);
 	thread_add_base_threads(master, with_snmp);
 
@@ -983,6 +1005,7 @@ register_vrrp_thread_addresses(void)
 	register_scheduler_addresses();
 	register_signal_thread_addresses();
 	register_notify_addresses();
+	register_coprocess_addresses();
 
 	register_smtp_addresses();
 	register_keepalived_netlink_addresses();
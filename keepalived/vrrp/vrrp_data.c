@@ -42,6 +42,9 @@
 #include "vrrp_iproute.h"
 #include "vrrp_track.h"
 #include "vrrp_sock.h"
+#ifdef _WITH_VRRP_RX_RING_
+#include "vrrp_rx_ring.h"
+#endif
 #ifdef _WITH_SNMP_RFCV3_
 #include "vrrp_snmp.h"
 #endif
@@ -312,6 +315,9 @@ dump_vscript(FILE *fp, const vrrp_script_t *vscript)
 	conf_write(fp, "   Fall = %d", vscript->fall);
 	conf_write(fp, "   Result = %d", vscript->result);
 	conf_write(fp, "   Insecure = %s", vscript->insecure ? "yes" : "no");
+	conf_write(fp, "   Persistent = %s", vscript->persistent ? "yes" : "no");
+	if (vscript->persistent)
+		dump_coprocess_req(fp, &vscript->req);
 
 	switch (vscript->init_state) {
 	case SCRIPT_INIT_STATE_INIT:
@@ -456,6 +462,9 @@ free_sock(sock_t *sock)
 		thread_cancel(sock->thread);
 
 	/* Close related socket */
+#ifdef _WITH_VRRP_RX_RING_
+	close_vrrp_rx_ring(sock);
+#endif
 	if (sock->fd_in > 0)
 		close(sock->fd_in);
 	if (sock->fd_out > 0)
@@ -508,6 +517,10 @@ dump_sock_pool(FILE *fp, const list_head_t *l)
 		conf_write(fp, "   Family = %s", sock->family == AF_INET ? "IPv4" : sock->family == AF_INET6 ? "IPv6" : "unknown");
 		conf_write(fp, "   Protocol = %s", sock->proto == IPPROTO_AH ? "AH" : sock->proto == IPPROTO_VRRP ? "VRRP" : "unknown");
 		conf_write(fp, "   Type = %sicast", sock->unicast_src ? "Un" : "Mult");
+#ifdef _WITH_VRRP_RX_RING_
+		if (sock->rx_ring)
+			conf_write(fp, "   Receive ring = %u blocks of %u bytes", sock->rx_ring_block_nr, sock->rx_ring_block_size);
+#endif
 		if (sock->unicast_src)	// Also for mcast once can specify
 			conf_write(fp, "   Address = %s", inet_sockaddrtos(sock->unicast_src));
 		conf_write(fp, "   Rx buf size = %d", sock->rx_buf_size);
@@ -537,6 +550,8 @@ dump_unicast_peer(FILE *fp, const void *data)
 	const unicast_peer_t *peer = data;
 
 	conf_write(fp, "     %s min_ttl %u max_ttl %u", inet_sockaddrtos(&peer->address), peer->min_ttl, peer->max_ttl);
+	conf_write(fp, "       adverts received %" PRIu64 ", checksum errors %" PRIu64 ", last received %" PRI_tv_sec ".%6.6" PRI_tv_usec,
+		   peer->advert_rcvd, peer->chksum_err, peer->last_rcvd.tv_sec, peer->last_rcvd.tv_usec);
 #ifdef _CHECKSUM_DEBUG_
 	conf_write(fp, "       last rx checksum = 0x%4.4x, priority %d", peer->chk.last_rx_checksum, peer->chk.last_rx_priority);
 	conf_write(fp, "       last tx checksum = 0x%4.4x, priority %d", peer->chk.last_tx_checksum, peer->chk.last_tx_priority);
@@ -559,6 +574,12 @@ free_vrrp(vrrp_t *vrrp)
 	FREE_PTR(vrrp->ipvlan_addr);
 #endif
 	FREE_PTR(vrrp->send_buffer);
+	FREE_PTR(vrrp->vip_sorted);
+	FREE_PTR(vrrp->vip_last_rx);
+#ifdef _WITH_VRRP_AUTH_
+	if (vrrp->auth_hmac)
+		hmac_md5_free(vrrp->auth_hmac);
+#endif
 	free_notify_script(&vrrp->script_backup);
 	free_notify_script(&vrrp->script_master);
 	free_notify_script(&vrrp->script_fault);
@@ -955,6 +976,8 @@ alloc_vrrp_stats(void)
 	new->ip_ttl_err = 0;
 	new->pri_zero_rcvd = 0;
 	new->pri_zero_sent = 0;
+	new->na_sent = 0;
+	new->na_sent_failover = 0;
 	new->invalid_type_rcvd = 0;
 	new->addr_list_err = 0;
 #ifdef _WITH_SNMP_RFCV3_
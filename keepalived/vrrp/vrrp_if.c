@@ -69,6 +69,9 @@
 #ifdef _WITH_FIREWALL_
 #include "vrrp_firewall.h"
 #endif
+#ifdef _WITH_VRRP_RX_RING_
+#include "vrrp_rx_ring.h"
+#endif
 
 
 /* Local vars */
@@ -431,9 +434,17 @@ dump_garp_delay(FILE *fp, const garp_delay_t *gd)
 			strcpy(time_str, "invalid time ");
 		conf_write(fp, " GNA next time %" PRI_tv_sec ".%6.6" PRI_tv_usec " (%.19s.%6.6" PRI_tv_usec ")", gd->gna_next_time.tv_sec, gd->gna_next_time.tv_usec, time_str, gd->gna_next_time.tv_usec);
 	}
-	else if (!gd->have_garp_interval)
+	else if (!gd->have_garp_interval && !gd->rate)
 		conf_write(fp, " No configuration");
 
+	if (gd->rate) {
+		conf_write(fp, " GARP/NA rate = %u/s, burst %u", gd->rate, gd->burst);
+		conf_write(fp, " Queue depth = %u, max %u", gd->queue_depth, gd->max_queue_depth);
+		conf_write(fp, " Queue drain time = %lu.%6.6lu, max %lu.%6.6lu",
+			   gd->last_drain_time / TIMER_HZ, gd->last_drain_time % TIMER_HZ,
+			   gd->max_drain_time / TIMER_HZ, gd->max_drain_time % TIMER_HZ);
+	}
+
 	conf_write(fp, " Interfaces");
 	list_for_each_entry(ifp, &if_queue, e_list) {
 		if (ifp->garp_delay == gd)
@@ -472,6 +483,8 @@ set_garp_delay(interface_t *ifp, const garp_delay_t *delay)
 	ifp->garp_delay->have_garp_interval = delay->have_garp_interval;
 	ifp->garp_delay->gna_interval = delay->gna_interval;
 	ifp->garp_delay->have_gna_interval = delay->have_gna_interval;
+	ifp->garp_delay->rate = delay->rate;
+	ifp->garp_delay->burst = delay->burst;
 }
 
 void
@@ -494,6 +507,8 @@ set_default_garp_delay(void)
 		default_delay.gna_interval.tv_usec = global_data->vrrp_gna_interval % TIMER_HZ;
 		default_delay.have_gna_interval = true;
 	}
+	default_delay.rate = global_data->vrrp_garp_rate;
+	default_delay.burst = global_data->vrrp_garp_burst;
 
 	/* Allocate a delay structure to each physical interface that doesn't have one and
 	 * is being used by a VRRP instance */
@@ -514,7 +529,8 @@ set_default_garp_delay(void)
 
 		/* We don't need a delay if there isn't a delay for the
 		 * address family we are using */
-		if (!((have_ipv4 && global_data->vrrp_garp_interval) ||
+		if (!global_data->vrrp_garp_rate &&
+		    !((have_ipv4 && global_data->vrrp_garp_interval) ||
 		      (have_ipv6 && global_data->vrrp_gna_interval)))
 			continue;
 
@@ -718,6 +734,10 @@ dump_if(FILE *fp, const interface_t *ifp)
 			conf_write(fp, "   Gratuitous NA interval %" PRI_time_t "ms",
 				    ifp->garp_delay->gna_interval.tv_sec * 1000 +
 				     ifp->garp_delay->gna_interval.tv_usec / (TIMER_HZ / 1000));
+
+		if (ifp->garp_delay->rate)
+			conf_write(fp, "   Gratuitous ARP/NA rate %u/s, burst %u",
+				    ifp->garp_delay->rate, ifp->garp_delay->burst);
 	}
 
 #ifdef _HAVE_VRRP_VMAC_
@@ -1503,6 +1523,9 @@ cleanup_lost_interface(interface_t *ifp)
 		if (vrrp->sockets) {
 			if (vrrp->sockets->fd_in != -1) {
 				thread_cancel_read(master, vrrp->sockets->fd_in);
+#ifdef _WITH_VRRP_RX_RING_
+				close_vrrp_rx_ring(vrrp->sockets);
+#endif
 				close(vrrp->sockets->fd_in);
 				vrrp->sockets->fd_in = -1;
 			}
@@ -1657,6 +1680,12 @@ void update_mtu(interface_t *ifp)
 		    sock->fd_in == -1)
 			continue;
 
+#ifdef _WITH_VRRP_RX_RING_
+		/* The ring is sized by the configuration, not the MTU */
+		if (sock->rx_ring)
+			continue;
+#endif
+
 		if (!updated_vrrp_buffer) {
 			alloc_vrrp_buffer(ifp->mtu);
 			updated_vrrp_buffer = true;
@@ -28,38 +28,41 @@
 #include <string.h>
 
 #include "vrrp_ipsecah.h"
+#include "memory.h"
 
 #define	BLOCK_SIZE	64
 
-/* hmac_md5 computation according to the RFCs 2085 & 2104 */
-void
-hmac_md5(const unsigned char *buffer1, size_t buffer1_len, const unsigned char *buffer2, size_t buffer2_len,
-	 const unsigned char *key, size_t key_len, unsigned char *digest)
+/* Precompute the keyed HMAC-MD5 state according to the RFCs 2085 & 2104.
+ * The key only affects the first MD5 block of the inner and outer hashes,
+ * so we hash those once here and copy the resulting states for each packet.
+ * Returns NULL if the state cannot be computed. */
+hmac_md5_ctx_t *
+hmac_md5_init(const unsigned char *key, size_t key_len)
 {
-	EVP_MD_CTX *context;
-	unsigned char k_ipad[BLOCK_SIZE+1];	/* inner padding - key XORd with ipad */
-	unsigned char k_opad[BLOCK_SIZE+1];	/* outer padding - key XORd with opad */
+	hmac_md5_ctx_t *ctx;
+	unsigned char k_ipad[BLOCK_SIZE];	/* inner padding - key XORd with ipad */
+	unsigned char k_opad[BLOCK_SIZE];	/* outer padding - key XORd with opad */
 	unsigned char tk[MD5_DIGEST_LENGTH];
 	int i;
 
-	/* Initialize data */
-	memset(k_ipad, 0, sizeof (k_ipad));
-	memset(k_opad, 0, sizeof (k_opad));
-	memset(tk, 0, sizeof (tk));
-
 	/* If the key is longer than 64 bytes => set it to key=MD5(key) */
 	if (key_len > BLOCK_SIZE) {
 		EVP_MD_CTX *tctx = EVP_MD_CTX_new();
+		bool ok;
 
 		/* Compute the MD5 digest */
-		EVP_DigestInit_ex(tctx, EVP_md5(), NULL);
-		EVP_DigestUpdate(tctx, key, key_len);
-		EVP_DigestFinal_ex(tctx, tk, NULL);
+		ok = tctx &&
+		     EVP_DigestInit_ex(tctx, EVP_md5(), NULL) &&
+		     EVP_DigestUpdate(tctx, key, key_len) &&
+		     EVP_DigestFinal_ex(tctx, tk, NULL);
+
+		EVP_MD_CTX_free(tctx);
+
+		if (!ok)
+			return NULL;
 
 		key = tk;
 		key_len = MD5_DIGEST_LENGTH;
-
-		EVP_MD_CTX_free(tctx);
 	}
 
 	/* The global HMAC_MD5 algo looks like (rfc2085.2.2) :
@@ -80,21 +83,51 @@ hmac_md5(const unsigned char *buffer1, size_t buffer1_len, const unsigned char *
 		k_opad[i] ^= 0x5c;
 	}
 
+	PMALLOC(ctx);
+	ctx->inner = EVP_MD_CTX_new();
+	ctx->outer = EVP_MD_CTX_new();
+	ctx->work = EVP_MD_CTX_new();
+
+	if (!ctx->inner || !ctx->outer || !ctx->work ||
+	    !EVP_DigestInit_ex(ctx->inner, EVP_md5(), NULL) ||
+	    !EVP_DigestUpdate(ctx->inner, k_ipad, BLOCK_SIZE) ||	/* start with inner pad */
+	    !EVP_DigestInit_ex(ctx->outer, EVP_md5(), NULL) ||
+	    !EVP_DigestUpdate(ctx->outer, k_opad, BLOCK_SIZE)) {	/* start with outer pad */
+		hmac_md5_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+void
+hmac_md5_free(hmac_md5_ctx_t *ctx)
+{
+	EVP_MD_CTX_free(ctx->inner);
+	EVP_MD_CTX_free(ctx->outer);
+	EVP_MD_CTX_free(ctx->work);
+	FREE(ctx);
+}
+
+/* hmac_md5 computation using precomputed keyed state.
+ * Returns false if the digest could not be computed. */
+bool
+hmac_md5(const hmac_md5_ctx_t *ctx, const unsigned char *buffer1, size_t buffer1_len,
+	 const unsigned char *buffer2, size_t buffer2_len, unsigned char *digest)
+{
 	/* Compute inner MD5 */
-	context = EVP_MD_CTX_new();
-	EVP_DigestInit_ex(context, EVP_md5(), NULL);		/* Init context for 1st pass */
-	EVP_DigestUpdate(context, k_ipad, BLOCK_SIZE);		/* start with inner pad */
-	EVP_DigestUpdate(context, buffer1, buffer1_len);	/* next with buffer datagram */
-	if (buffer2)
-		EVP_DigestUpdate(context, buffer2, buffer2_len); /* next with buffer datagram */
-	EVP_DigestFinal_ex(context, digest, NULL);		/* Finish 1st pass */
+	if (!EVP_MD_CTX_copy_ex(ctx->work, ctx->inner) ||		/* Keyed state for 1st pass */
+	    !EVP_DigestUpdate(ctx->work, buffer1, buffer1_len) ||	/* next with buffer datagram */
+	    (buffer2 &&
+	     !EVP_DigestUpdate(ctx->work, buffer2, buffer2_len)) ||	/* next with buffer datagram */
+	    !EVP_DigestFinal_ex(ctx->work, digest, NULL))		/* Finish 1st pass */
+		return false;
 
 	/* Compute outer MD5 */
-	EVP_MD_CTX_reset(context);
-	EVP_DigestInit_ex(context, EVP_md5(), NULL);		/* Init context for 2nd pass */
-	EVP_DigestUpdate(context, k_opad, BLOCK_SIZE);		/* start with inner pad */
-	EVP_DigestUpdate(context, digest, MD5_DIGEST_LENGTH);	/* next result of 1st pass */
-	EVP_DigestFinal_ex(context, digest, NULL);		/* Finish 2nd pass */
+	if (!EVP_MD_CTX_copy_ex(ctx->work, ctx->outer) ||		/* Keyed state for 2nd pass */
+	    !EVP_DigestUpdate(ctx->work, digest, MD5_DIGEST_LENGTH) ||	/* next result of 1st pass */
+	    !EVP_DigestFinal_ex(ctx->work, digest, NULL))		/* Finish 2nd pass */
+		return false;
 
-	EVP_MD_CTX_free(context);
+	return true;
 }
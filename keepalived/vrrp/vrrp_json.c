@@ -237,6 +237,11 @@ static int
 vrrp_json_stats_dump(json_writer_t *wr, vrrp_t *vrrp)
 {
 	vrrp_stats *stats = vrrp->stats;
+	unicast_peer_t *peer;
+	unsigned i;
+#ifdef _NETWORK_TIMESTAMP_
+	unsigned bound;
+#endif
 
 	if (!stats)
 		return -1;
@@ -260,6 +265,45 @@ vrrp_json_stats_dump(json_writer_t *wr, vrrp_t *vrrp)
 #endif
 	jsonw_uint_field(wr, "pri_zero_rcvd", stats->pri_zero_rcvd);
 	jsonw_uint_field(wr, "pri_zero_sent", stats->pri_zero_sent);
+	jsonw_uint_field(wr, "na_sent", stats->na_sent);
+	jsonw_uint_field(wr, "na_sent_failover", stats->na_sent_failover);
+	jsonw_name(wr, "rx_interval_hist");
+	jsonw_start_array(wr);
+	for (i = 0; i < VRRP_RX_INTERVAL_BUCKETS; i++) {
+		jsonw_start_object(wr);
+		jsonw_uint_field(wr, "from_pct", i ? vrrp_rx_interval_pct[i - 1] : 0);
+		jsonw_uint_field(wr, "count", stats->rx_interval_hist[i]);
+		jsonw_end_object(wr);
+	}
+	jsonw_end_array(wr);
+	jsonw_uint_field(wr, "rx_interval_max", stats->rx_interval_max);
+#ifdef _NETWORK_TIMESTAMP_
+	if (do_network_timestamp) {
+		jsonw_name(wr, "rx_lag_hist");
+		jsonw_start_array(wr);
+		for (i = 0, bound = 1; i < VRRP_RX_LAG_BUCKETS; i++, bound *= 10) {
+			jsonw_start_object(wr);
+			jsonw_uint_field(wr, "from_usecs", i ? bound : 0);
+			jsonw_uint_field(wr, "count", stats->rx_lag_hist[i]);
+			jsonw_end_object(wr);
+		}
+		jsonw_end_array(wr);
+		jsonw_uint_field(wr, "rx_lag_max", stats->rx_lag_max);
+	}
+#endif
+	if (!list_empty(&vrrp->unicast_peer)) {
+		jsonw_name(wr, "unicast_peers");
+		jsonw_start_array(wr);
+		list_for_each_entry(peer, &vrrp->unicast_peer, e_list) {
+			jsonw_start_object(wr);
+			jsonw_string_field(wr, "address", inet_sockaddrtos(&peer->address));
+			jsonw_uint_field(wr, "advert_rcvd", peer->advert_rcvd);
+			jsonw_uint_field(wr, "chksum_err", peer->chksum_err);
+			jsonw_float_field_fmt(wr, "last_rcvd", "%f", timeval_to_double(&peer->last_rcvd));
+			jsonw_end_object(wr);
+		}
+		jsonw_end_array(wr);
+	}
 	jsonw_end_object(wr);
 	return 0;
 }
@@ -36,6 +36,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <sys/socket.h>
 
 /* local includes */
 #include "vrrp_ndisc.h"
@@ -47,9 +48,20 @@
 #include "bitops.h"
 
 
+/* Maximum number of adverts handed to the kernel in one sendmmsg() call */
+#define NDISC_BATCH_SIZE	64
+
 /* static vars */
 static int ndisc_fd = -1;
 
+/* Adverts queued while batching, sent by ndisc_flush() */
+static bool ndisc_batching;
+static unsigned ndisc_batch_len;
+static struct mmsghdr ndisc_msgs[NDISC_BATCH_SIZE];
+static struct iovec ndisc_iovs[NDISC_BATCH_SIZE];
+static struct sockaddr_large_ll ndisc_dests[NDISC_BATCH_SIZE];
+static ip_address_t *ndisc_addrs[NDISC_BATCH_SIZE];
+
 /*
  * See RFC 4391(Section 4 ) and RFC 4392 for details
  * This is modified by the IPoIB driver to add the P_key
@@ -60,31 +72,74 @@ static unsigned char  ipv6_bcast_addr[] = {
 	0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff
 };
 
+static void
+log_send_na_error(const ip_address_t *ipaddress, const char *addr_str)
+{
+	char buf[INET6_ADDRSTRLEN];
+
+	if (!addr_str || !addr_str[0])
+		addr_str = inet_ntop(AF_INET6, &ipaddress->u.sin6_addr, buf, sizeof(buf));
+	log_message(LOG_INFO, "Error %d sending ndisc unsolicited neighbour advert on %s for %s",
+		    errno, IF_NAME(ipaddress->ifp), addr_str);
+}
+
+static void
+ndisc_batch_send(void)
+{
+	unsigned sent = 0;
+	int ret;
+
+	while (sent < ndisc_batch_len) {
+		ret = sendmmsg(ndisc_fd, ndisc_msgs + sent, ndisc_batch_len - sent, 0);
+		if (ret < 0) {
+			/* The advert at sent failed; report it and carry on with the rest */
+			log_send_na_error(ndisc_addrs[sent], NULL);
+			sent++;
+		} else
+			sent += (unsigned)ret;
+	}
+
+	ndisc_batch_len = 0;
+}
+
 /*
  *	Neighbour Advertisement sending routine.
  */
 static void
-ndisc_send_na(ip_address_t *ipaddress, struct iovec *iov, int iovlen)
+ndisc_send_na(ip_address_t *ipaddress)
 {
-	struct sockaddr_large_ll sll;
+	struct sockaddr_large_ll *sll;
 	ssize_t len;
 	char addr_str[INET6_ADDRSTRLEN] = "";
 	interface_t *ifp = ipaddress->ifp;
-	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iovlen };
+	struct msghdr *msg;
+
+	if (ndisc_batching && ndisc_batch_len == NDISC_BATCH_SIZE)
+		ndisc_batch_send();
 
 	/* Build the dst device */
-	memset(&sll, 0, sizeof (sll));
-	sll.sll_family = AF_PACKET;
-	sll.sll_ifindex = (int)IF_INDEX(ifp);
+	sll = &ndisc_dests[ndisc_batch_len];
+	memset(sll, 0, sizeof (*sll));
+	sll->sll_family = AF_PACKET;
+	sll->sll_ifindex = (int)IF_INDEX(ifp);
 
 	/* The values in sll_ha_type, sll_addr and sll_halen appear to be ignored */
-	sll.sll_hatype = ifp->hw_type;
-	sll.sll_halen = ifp->hw_addr_len;
-	sll.sll_protocol = htons(ETH_P_IPV6);
-	memcpy(sll.sll_addr, IF_HWADDR(ifp), ifp->hw_addr_len);
-
-	msg.msg_name = &sll;
-	msg.msg_namelen = sizeof(sll);
+	sll->sll_hatype = ifp->hw_type;
+	sll->sll_halen = ifp->hw_addr_len;
+	sll->sll_protocol = htons(ETH_P_IPV6);
+	memcpy(sll->sll_addr, IF_HWADDR(ifp), ifp->hw_addr_len);
+
+	/* The frame stays in ipaddress->frame until it is sent */
+	ndisc_iovs[ndisc_batch_len].iov_base = ipaddress->frame;
+	ndisc_iovs[ndisc_batch_len].iov_len = ipaddress->frame_len;
+
+	msg = &ndisc_msgs[ndisc_batch_len].msg_hdr;
+	*msg = (struct msghdr){
+		.msg_name = sll,
+		.msg_namelen = sizeof(*sll),
+		.msg_iov = &ndisc_iovs[ndisc_batch_len],
+		.msg_iovlen = 1,
+	};
 
 	if (__test_bit(LOG_DETAIL_BIT, &debug)) {
 		inet_ntop(AF_INET6, &ipaddress->u.sin6_addr, addr_str, sizeof(addr_str));
@@ -92,14 +147,15 @@ ndisc_send_na(ip_address_t *ipaddress, struct iovec *iov, int iovlen)
 			    IF_NAME(ifp), addr_str);
 	}
 
-	/* Send packet */
-	len = sendmsg(ndisc_fd, &msg, 0);
-	if (len < 0) {
-		if (!addr_str[0])
-			inet_ntop(AF_INET6, &ipaddress->u.sin6_addr, addr_str, sizeof(addr_str));
-		log_message(LOG_INFO, "Error %d sending ndisc unsolicited neighbour advert on %s for %s",
-			    errno, IF_NAME(ifp), addr_str);
+	if (ndisc_batching) {
+		ndisc_addrs[ndisc_batch_len++] = ipaddress;
+		return;
 	}
+
+	/* Send packet */
+	len = sendmsg(ndisc_fd, msg, 0);
+	if (len < 0)
+		log_send_na_error(ipaddress, addr_str);
 }
 
 /*
@@ -156,14 +212,26 @@ ndisc_icmp6_cksum(const struct ip6hdr *ip6, struct iovec *iov, int iovcnt)
 	return ~sum & 0xffff;
 }
 
+/* Length of the link layer header of an advert sent on ifp */
+static size_t
+ndisc_link_hdr_len(const interface_t *ifp)
+{
+	if (ifp->hw_type == ARPHRD_INFINIBAND)
+		return sizeof(ipv6_bcast_addr) + sizeof(ipoib_hdr_t);
+
+	return sizeof(struct ether_header);
+}
+
 /*
  *	Build an unsolicited Neighbour Advertisement.
  *	As explained in rfc4861.4.4, a node sends unsolicited
  *	Neighbor Advertisements in order to (unreliably) propagate
  *	new information quickly.
+ *	The complete frame, including the ICMPv6 checksum, is built
+ *	into ipaddress->frame so that it can be resent unchanged.
  */
-void
-ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
+static void
+build_unsolicited_na(interface_t *ifp, ip_address_t *ipaddress)
 {
 	struct ether_header eth = { .ether_type = htons(ETHERTYPE_IPV6) };
 	ipoib_hdr_t ipoib = { .proto = htons(ETHERTYPE_IPV6) };
@@ -174,6 +242,8 @@ ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
 	struct iovec iov[7];
 	unsigned num_iov;
 	unsigned icmp6_iov;
+	unsigned i;
+	size_t len = 0;
 
 	/* For Infiniband see vrrp_arp.c and RFC2461 4.4, RFC4391, RFC4392 9.3 and
 	 * https://datatracker.ietf.org/doc/html/draft-kashyap-ipoib-ipv6-over-infiniband-00 */
@@ -211,10 +281,7 @@ ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
 
 	/* ICMPv6 Header */
 
-	/* Set the router flag if necessary. We recheck each interface if not
-	 * checked in the last 5 seconds. */
-	if (timer_cmp_now_diff(ifp->last_gna_router_check, 5 * TIMER_HZ))
-		set_ipv6_forwarding(ifp);
+	/* Set the router flag if necessary */
 	if (ifp->gna_router)
 		ndh.nd_na_flags_reserved |= ND_NA_FLAG_ROUTER;
 
@@ -254,8 +321,49 @@ ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
 	/* Compute checksum - ICMP6 header onwards*/
 	ndh.nd_na_hdr.icmp6_cksum = ndisc_icmp6_cksum(&ip6h, &iov[icmp6_iov], num_iov - icmp6_iov);
 
+	for (i = 0; i < num_iov; i++) {
+		memcpy(ipaddress->frame + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+
+	ipaddress->frame_len = (uint8_t)len;
+	ipaddress->frame_ifindex = ifp->ifindex;
+}
+
+/* Check if the cached advert of ipaddress can be sent on ifp. It cannot if
+ * it was built for a different interface, or the router flag or the MAC
+ * address of the interface have changed since it was built. */
+static bool
+unsolicited_na_cached(const interface_t *ifp, const ip_address_t *ipaddress)
+{
+	struct nd_neighbor_advert ndh;
+
+	if (!ipaddress->frame_len ||
+	    ipaddress->frame_ifindex != ifp->ifindex)
+		return false;
+
+	memcpy(&ndh, ipaddress->frame + ndisc_link_hdr_len(ifp) + sizeof(struct ip6hdr), sizeof(ndh));
+	if (!(ndh.nd_na_flags_reserved & ND_NA_FLAG_ROUTER) != !ifp->gna_router)
+		return false;
+
+	/* The MAC address is at the end of the target link-layer address option */
+	return !memcmp(ipaddress->frame + ipaddress->frame_len - ipaddress->ifp->hw_addr_len,
+		       ipaddress->ifp->hw_addr, ipaddress->ifp->hw_addr_len);
+}
+
+void
+ndisc_send_unsolicited_na_immediate(interface_t *ifp, ip_address_t *ipaddress)
+{
+	/* Check if the router flag needs setting. We recheck each interface if
+	 * not checked in the last 5 seconds. */
+	if (timer_cmp_now_diff(ifp->last_gna_router_check, 5 * TIMER_HZ))
+		set_ipv6_forwarding(ifp);
+
+	if (!unsolicited_na_cached(ifp, ipaddress))
+		build_unsolicited_na(ifp, ipaddress);
+
 	/* Send the neighbor advertisement message */
-	ndisc_send_na(ipaddress, iov, num_iov);
+	ndisc_send_na(ipaddress);
 
 	/* If we have to delay between sending NAs, note the next time we can */
 	if (ifp->garp_delay && ifp->garp_delay->have_gna_interval)
@@ -273,23 +381,58 @@ queue_ndisc(interface_t *ifp, ip_address_t *ipaddress)
         list_add_tail(&ipaddress->garp_gna_list, &ifp->garp_delay->gna_list);
 }
 
+/* Adverts sent between ndisc_batch() and ndisc_flush() are held back
+ * and handed to the kernel together. Rate limiting by garp_delay is
+ * unaffected, since it is applied before an advert is added to the batch. */
 void
+ndisc_batch(void)
+{
+	if (ndisc_fd != -1)
+		ndisc_batching = true;
+}
+
+void
+ndisc_flush(void)
+{
+	if (ndisc_batch_len)
+		ndisc_batch_send();
+
+	ndisc_batching = false;
+}
+
+/* Returns true if an advert has been sent or queued */
+bool
 ndisc_send_unsolicited_na(ip_address_t *ipaddress, unsigned rep)
 {
 	interface_t *ifp = IF_BASE_IFP(ipaddress->ifp);
 
 	/* If the interface doesn't support NDISC, don't try sending */
 	if (ifp->ifi_flags & IFF_NOARP)
-		return;
+		return false;
 
 	if (ipaddress->garp_gna_pending) {
-                if (ipaddress->garp_gna_pending < rep)
+                if (ipaddress->garp_gna_pending < rep) {
 			ipaddress->garp_gna_pending++;
-                return;
+			if (ifp->garp_delay && ifp->garp_delay->rate)
+				garp_pacer_pending(ifp->garp_delay);
+			return true;
+		}
+                return false;
         }
 
 	set_time_now();
 
+	/* If rate limited by a token bucket, send now if a token is available */
+	if (ifp->garp_delay && ifp->garp_delay->rate) {
+		if (garp_pacer_send_now(ifp->garp_delay))
+			ndisc_send_unsolicited_na_immediate(ifp, ipaddress);
+		else {
+			ipaddress->garp_gna_pending = 1;
+			garp_pacer_queue(ifp->garp_delay, ipaddress, &ifp->garp_delay->gna_list);
+		}
+		return true;
+	}
+
 	/* Do we need to delay sending the ndisc? */
 	if (ifp->garp_delay &&
 	    ifp->garp_delay->have_gna_interval &&
@@ -298,6 +441,8 @@ ndisc_send_unsolicited_na(ip_address_t *ipaddress, unsigned rep)
 		queue_ndisc(ifp, ipaddress);
 	else
 		ndisc_send_unsolicited_na_immediate(ifp, ipaddress);
+
+	return true;
 }
 
 /*
@@ -329,6 +474,9 @@ ndisc_init(void)
 void
 ndisc_close(void)
 {
+	ndisc_batching = false;
+	ndisc_batch_len = 0;
+
 	if (ndisc_fd != -1) {
 		close(ndisc_fd);
 		ndisc_fd = -1;
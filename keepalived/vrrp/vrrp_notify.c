@@ -30,9 +30,13 @@
 /* local include */
 #include "vrrp_notify.h"
 #include "vrrp_data.h"
+#include "vrrp_stats_shm.h"
 #ifdef _WITH_DBUS_
 #include "vrrp_dbus.h"
 #endif
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+#include "vrrp_advert_thread.h"
+#endif
 #include "global_data.h"
 #include "notify.h"
 #include "logger.h"
@@ -272,6 +276,15 @@ send_instance_notifies(vrrp_t *vrrp)
 	notify_script_t *script = get_iscript(vrrp);
 	notify_script_t *gscript = get_igscript(vrrp);
 
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	/* Every state change comes through here, so make sure the advert
+	 * thread stops sending for us once we are no longer master */
+	if (vrrp->state != VRRP_STATE_MAST)
+		advert_thread_release(vrrp);
+#endif
+
+	vrrp_stats_shm_update(vrrp);
+
 	if (vrrp->notifies_sent && vrrp->sync && vrrp->state == vrrp->sync->state) {
 		/* We are already in the required state due to our sync group,
 		 * so don't send further notifies. */
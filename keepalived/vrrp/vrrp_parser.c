@@ -1672,6 +1672,12 @@ vrrp_vscript_end_handler(void)
 		return;
 	}
 
+	if (current_vscr->persistent && !coprocess_script_valid(&current_vscr->script)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "vrrp_script %s persistent script parameters cannot contain newlines - running per check"
+							, current_vscr->sname);
+		current_vscr->persistent = false;
+	}
+
 	list_add_tail(&current_vscr->e_list, &vrrp_data->vrrp_script);
 }
 
@@ -1880,6 +1886,11 @@ vrrp_vscript_init_fail_handler(__attribute__((unused)) const vector_t *strvec)
 	current_vscr->init_state = SCRIPT_INIT_STATE_FAILED;
 }
 static void
+vrrp_vscript_persistent_handler(__attribute__((unused)) const vector_t *strvec)
+{
+	current_vscr->persistent = true;
+}
+static void
 vrrp_version_handler(const vector_t *strvec)
 {
 	int version;
@@ -1960,6 +1971,25 @@ garp_group_gna_interval_handler(const vector_t *strvec)
 		log_message(LOG_INFO, "The gna_interval is very large - %s seconds", strvec_slot(strvec,1));
 }
 static void
+garp_group_rate_handler(const vector_t *strvec)
+{
+	unsigned rate, burst = 1;
+
+	if (!read_unsigned_strvec(strvec, 1, &rate, 1, TIMER_HZ, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "garp_group rate '%s' invalid", strvec_slot(strvec, 1));
+		return;
+	}
+
+	if (vector_size(strvec) >= 3 &&
+	    !read_unsigned_strvec(strvec, 2, &burst, 1, GARP_MAX_BURST, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "garp_group rate burst '%s' invalid", strvec_slot(strvec, 2));
+		return;
+	}
+
+	current_ggd->rate = rate;
+	current_ggd->burst = burst;
+}
+static void
 garp_group_interface_handler(const vector_t *strvec)
 {
 	interface_t *ifp = if_get_by_ifname(strvec_slot(strvec, 1), IF_CREATE_IF_DYNAMIC);
@@ -2030,7 +2060,7 @@ garp_group_end_handler(void)
 	interface_t *ifp;
 	list_head_t *ifq;
 
-	if (!current_ggd->have_garp_interval && !current_ggd->have_gna_interval) {
+	if (!current_ggd->have_garp_interval && !current_ggd->have_gna_interval && !current_ggd->rate) {
 		report_config_error(CONFIG_GENERAL_ERROR, "garp group %u does not have any delay set - removing", cur_aggregation_group);
 
 		/* Remove the garp_delay from any interfaces that are using it */
@@ -2141,6 +2171,7 @@ init_vrrp_keywords(bool active)
 	install_keyword_root("garp_group", &garp_group_handler, active, VPP &current_ggd);
 	install_keyword("garp_interval", &garp_group_garp_interval_handler);
 	install_keyword("gna_interval", &garp_group_gna_interval_handler);
+	install_keyword("rate", &garp_group_rate_handler);
 	install_keyword("interface", &garp_group_interface_handler);
 	install_keyword("interfaces", &garp_group_interfaces_handler);
 	install_level_end_handler(&garp_group_end_handler);
@@ -2258,6 +2289,7 @@ init_vrrp_keywords(bool active)
 	install_keyword("fall", &vrrp_vscript_fall_handler);
 	install_keyword("user", &vrrp_vscript_user_handler);
 	install_keyword("init_fail", &vrrp_vscript_init_fail_handler);
+	install_keyword("persistent", &vrrp_vscript_persistent_handler);
 	install_level_end_handler(&vrrp_vscript_end_handler);
 
 #ifdef _WITH_TRACK_PROCESS_
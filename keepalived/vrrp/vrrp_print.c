@@ -57,7 +57,12 @@ vrrp_print_stats(bool clear_stats)
 {
 	FILE *file;
 	vrrp_t *vrrp;
+	unicast_peer_t *peer;
 	const char *stats_file;
+	unsigned i;
+#ifdef _NETWORK_TIMESTAMP_
+	unsigned bound;
+#endif
 
 	stats_file = make_tmp_filename("keepalived.stats");
 
@@ -100,6 +105,46 @@ vrrp_print_stats(bool clear_stats)
 		fprintf(file, "  Priority Zero:\n");
 		fprintf(file, "    Received: %" PRIu64 "\n", vrrp->stats->pri_zero_rcvd);
 		fprintf(file, "    Sent: %" PRIu64 "\n", vrrp->stats->pri_zero_sent);
+		fprintf(file, "  Unsolicited Neighbour Adverts:\n");
+		fprintf(file, "    Sent: %" PRIu64 "\n", vrrp->stats->na_sent);
+		fprintf(file, "    Sent since became master: %u\n", vrrp->stats->na_sent_failover);
+		fprintf(file, "  Master advert intervals:\n");
+		for (i = 0; i < VRRP_RX_INTERVAL_BUCKETS; i++) {
+			if (i == VRRP_RX_INTERVAL_BUCKETS - 1)
+				fprintf(file, "    >= %u.%2.2ux", vrrp_rx_interval_pct[i - 1] / 100, vrrp_rx_interval_pct[i - 1] % 100);
+			else
+				fprintf(file, "    < %u.%2.2ux", vrrp_rx_interval_pct[i] / 100, vrrp_rx_interval_pct[i] % 100);
+			fprintf(file, ": %" PRIu64 "\n", vrrp->stats->rx_interval_hist[i]);
+		}
+		fprintf(file, "    Max: %u usecs\n", vrrp->stats->rx_interval_max);
+#ifdef _NETWORK_TIMESTAMP_
+		if (do_network_timestamp) {
+			fprintf(file, "  Receive lag:\n");
+			for (i = 0, bound = 10; i < VRRP_RX_LAG_BUCKETS; i++, bound *= 10) {
+				if (i == VRRP_RX_LAG_BUCKETS - 1)
+					fprintf(file, "    >= %u usecs", bound / 10);
+				else
+					fprintf(file, "    < %u usecs", bound);
+				fprintf(file, ": %" PRIu64 "\n", vrrp->stats->rx_lag_hist[i]);
+			}
+			fprintf(file, "    Max: %u usecs\n", vrrp->stats->rx_lag_max);
+		}
+#endif
+		if (!list_empty(&vrrp->unicast_peer)) {
+			fprintf(file, "  Unicast peers:\n");
+			list_for_each_entry(peer, &vrrp->unicast_peer, e_list) {
+				fprintf(file, "    %s:\n", inet_sockaddrtos(&peer->address));
+				fprintf(file, "      Received: %" PRIu64 "\n", peer->advert_rcvd);
+				fprintf(file, "      Checksum errors: %" PRIu64 "\n", peer->chksum_err);
+				fprintf(file, "      Last received: %" PRI_tv_sec ".%6.6" PRI_tv_usec "\n",
+					peer->last_rcvd.tv_sec, peer->last_rcvd.tv_usec);
+
+				if (clear_stats) {
+					peer->advert_rcvd = 0;
+					peer->chksum_err = 0;
+				}
+			}
+		}
 
 		if (clear_stats)
 			memset(vrrp->stats, 0, sizeof(*vrrp->stats));
@@ -0,0 +1,349 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Receiving VRRP adverts via a memory mapped packet ring.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+/* Instead of a raw IP socket, a socket in the socket pool can receive
+ * adverts via an AF_PACKET socket bound to the interface with a TPACKET_V3
+ * receive ring. A BPF filter only passes incoming packets of the socket's
+ * protocol sent to its multicast group (or unicast source address), so the
+ * ring holds the same packets the raw socket would have received.
+ *
+ * The kernel fills a block of the ring with packets and hands the block
+ * to us when it is full or the retire timeout expires, so we are woken
+ * once per block rather than once per packet, and the packets are
+ * processed in place in the ring rather than being copied out.
+ *
+ * Since the packets have not been through the IP stack, we check the
+ * IPv4 header checksum and the IPv6 VRRP checksum here; the latter is
+ * otherwise checked by the kernel via IPV6_CHECKSUM.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <net/if_arp.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+#include "vrrp_rx_ring.h"
+#include "vrrp.h"
+#include "global_data.h"
+#include "logger.h"
+#include "utils.h"
+
+#define RX_RING_FRAME_SIZE	2048
+#define RX_RING_SNAPLEN		0xffffffff
+
+/* Build the BPF program passing the packets the raw socket would receive.
+ * The filter sees the packet from the network header. */
+static int
+set_rx_ring_filter(int fd, const sock_t *sock)
+{
+	const sockaddr_t *daddr = sock->unicast_src ? sock->unicast_src : sock->mcast_daddr;
+	struct sock_filter filter[14];
+	struct sock_fprog bpf = { .filter = filter };
+	const uint32_t *addr6;
+	unsigned drop, i;
+
+	drop = sock->family == AF_INET ? 7 : 13;
+
+	/* Ignore our own transmitted packets */
+	filter[0] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE);
+	filter[1] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, drop - 2, 0);
+
+	if (sock->family == AF_INET) {
+		filter[2] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, offsetof(struct iphdr, protocol));
+		filter[3] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)sock->proto, 0, drop - 4);
+		filter[4] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct iphdr, daddr));
+		filter[5] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+							 ntohl(PTR_CAST_CONST(struct sockaddr_in, daddr)->sin_addr.s_addr), 0, drop - 6);
+	} else {
+		filter[2] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, offsetof(struct ip6_hdr, ip6_nxt));
+		filter[3] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)sock->proto, 0, drop - 4);
+
+		addr6 = PTR_CAST_CONST(uint32_t, &PTR_CAST_CONST(struct sockaddr_in6, daddr)->sin6_addr);
+		for (i = 0; i < 4; i++) {
+			filter[4 + 2 * i] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct ip6_hdr, ip6_dst) + i * sizeof(uint32_t));
+			filter[5 + 2 * i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(addr6[i]), 0, drop - 6 - 2 * i);
+		}
+	}
+
+	filter[drop - 1] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, RX_RING_SNAPLEN);
+	filter[drop] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+	bpf.len = drop + 1;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &bpf, sizeof(bpf))) {
+		log_message(LOG_INFO, "rx ring %s - SO_ATTACH_FILTER failed %d (%m)", sock->ifp->ifname, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Ask the interface to pass up the multicast group's link layer address */
+static int
+add_rx_ring_membership(int fd, const sock_t *sock)
+{
+	struct packet_mreq mreq = { .mr_ifindex = (int)sock->ifp->ifindex, .mr_type = PACKET_MR_MULTICAST, .mr_alen = ETH_ALEN };
+	const unsigned char *addr;
+
+	if (sock->family == AF_INET) {
+		addr = PTR_CAST_CONST(unsigned char, &PTR_CAST_CONST(struct sockaddr_in, sock->mcast_daddr)->sin_addr);
+		mreq.mr_address[0] = 0x01;
+		mreq.mr_address[1] = 0x00;
+		mreq.mr_address[2] = 0x5e;
+		mreq.mr_address[3] = addr[1] & 0x7f;
+		mreq.mr_address[4] = addr[2];
+		mreq.mr_address[5] = addr[3];
+	} else {
+		addr = PTR_CAST_CONST(unsigned char, &PTR_CAST_CONST(struct sockaddr_in6, sock->mcast_daddr)->sin6_addr);
+		mreq.mr_address[0] = 0x33;
+		mreq.mr_address[1] = 0x33;
+		memcpy(&mreq.mr_address[2], addr + 12, 4);
+	}
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq))) {
+		log_message(LOG_INFO, "rx ring %s - PACKET_ADD_MEMBERSHIP failed %d (%m)", sock->ifp->ifname, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Open an AF_PACKET socket with a receive ring for the socket pool entry.
+ * Returns -1 if the ring cannot be used, in which case the caller opens
+ * a raw socket instead. */
+int
+open_vrrp_rx_ring(sock_t *sock)
+{
+	int fd;
+	int version = TPACKET_V3;
+	long page_size = sysconf(_SC_PAGESIZE);
+	struct tpacket_req3 req = { 0 };
+	struct sockaddr_ll sll = { .sll_family = AF_PACKET };
+	unsigned block_size;
+	void *ring;
+
+	if (!sock->ifp || !sock->ifp->ifindex || sock->ifp->hw_type != ARPHRD_ETHER)
+		return -1;
+
+	/* The block size must be a multiple of the page size */
+	block_size = global_data->vrrp_rx_ring_block_size;
+	if (page_size > 0 && block_size % page_size)
+		block_size += page_size - block_size % page_size;
+
+	/* Don't bind to a protocol until the filter is attached, so that we
+	 * don't queue any unfiltered packets. */
+	fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		log_message(LOG_INFO, "rx ring %s - can't open packet socket %d (%m)", sock->ifp->ifname, errno);
+		return -1;
+	}
+
+	if (set_rx_ring_filter(fd, sock) ||
+	    (!sock->unicast_src && add_rx_ring_membership(fd, sock)))
+		goto err;
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version))) {
+		log_message(LOG_INFO, "rx ring %s - PACKET_VERSION failed %d (%m)", sock->ifp->ifname, errno);
+		goto err;
+	}
+
+	req.tp_block_size = block_size;
+	req.tp_block_nr = global_data->vrrp_rx_ring_block_nr;
+	req.tp_frame_size = RX_RING_FRAME_SIZE;
+	req.tp_frame_nr = block_size / RX_RING_FRAME_SIZE * req.tp_block_nr;
+	req.tp_retire_blk_tov = global_data->vrrp_rx_ring_timeout;
+	if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req))) {
+		log_message(LOG_INFO, "rx ring %s - PACKET_RX_RING failed %d (%m)", sock->ifp->ifname, errno);
+		goto err;
+	}
+
+	ring = mmap(NULL, (size_t)block_size * req.tp_block_nr, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		log_message(LOG_INFO, "rx ring %s - mmap failed %d (%m)", sock->ifp->ifname, errno);
+		goto err;
+	}
+
+	sll.sll_protocol = htons(sock->family == AF_INET ? ETH_P_IP : ETH_P_IPV6);
+	sll.sll_ifindex = (int)sock->ifp->ifindex;
+	if (bind(fd, PTR_CAST(struct sockaddr, &sll), sizeof(sll))) {
+		log_message(LOG_INFO, "rx ring %s - bind failed %d (%m)", sock->ifp->ifname, errno);
+		munmap(ring, (size_t)block_size * req.tp_block_nr);
+		goto err;
+	}
+
+	sock->rx_ring = ring;
+	sock->rx_ring_block_size = block_size;
+	sock->rx_ring_block_nr = req.tp_block_nr;
+	sock->rx_ring_block = 0;
+	sock->rx_ring_pkt = NULL;
+	sock->rx_ring_pkts_left = 0;
+
+	return fd;
+
+err:
+	close(fd);
+	return -1;
+}
+
+void
+close_vrrp_rx_ring(sock_t *sock)
+{
+	if (!sock->rx_ring)
+		return;
+
+	munmap(sock->rx_ring, (size_t)sock->rx_ring_block_size * sock->rx_ring_block_nr);
+	sock->rx_ring = NULL;
+}
+
+static bool
+parse_rx_ring_ipv4(const struct tpacket3_hdr *ppd, vrrp_rx_pkt_t *pkt)
+{
+	const struct iphdr *iph = PTR_CAST_CONST(struct iphdr, (const char *)ppd + ppd->tp_net);
+	size_t ihl, tot_len;
+
+	if (ppd->tp_snaplen < sizeof(struct iphdr) || iph->version != 4)
+		return false;
+
+	ihl = iph->ihl << 2;
+	tot_len = ntohs(iph->tot_len);
+	if (ihl < sizeof(struct iphdr) || tot_len < ihl || tot_len > ppd->tp_snaplen)
+		return false;
+
+	/* Adverts are never fragmented, and the kernel would have reassembled them */
+	if (iph->frag_off & htons(IP_MF | IP_OFFMASK))
+		return false;
+
+	if (in_csum(iph, ihl, 0, NULL))
+		return false;
+
+	pkt->buf = (const char *)iph;
+	pkt->len = tot_len;		/* Remove any Ethernet padding */
+	PTR_CAST(struct sockaddr_in, &pkt->src_addr)->sin_family = AF_INET;
+	PTR_CAST(struct sockaddr_in, &pkt->src_addr)->sin_addr.s_addr = iph->saddr;
+
+	return true;
+}
+
+static bool
+parse_rx_ring_ipv6(const sock_t *sock, const struct tpacket3_hdr *ppd, vrrp_rx_pkt_t *pkt)
+{
+	const struct ip6_hdr *ip6h = PTR_CAST_CONST(struct ip6_hdr, (const char *)ppd + ppd->tp_net);
+	struct sockaddr_in6 *src = PTR_CAST(struct sockaddr_in6, &pkt->src_addr);
+	size_t plen;
+	uint32_t sum;
+	struct {
+		struct in6_addr src;
+		struct in6_addr dst;
+		uint32_t	len;
+		uint8_t		zero[3];
+		uint8_t		nxt;
+	} ph;
+
+	if (ppd->tp_snaplen < sizeof(struct ip6_hdr) || (ip6h->ip6_vfc >> 4) != 6)
+		return false;
+
+	plen = ntohs(ip6h->ip6_plen);
+	if (plen > ppd->tp_snaplen - sizeof(struct ip6_hdr))
+		return false;
+
+	/* Verify the VRRP checksum, which for raw sockets is done by the kernel */
+	memset(&ph, 0, sizeof(ph));
+	ph.src = ip6h->ip6_src;
+	ph.dst = ip6h->ip6_dst;
+	ph.len = htonl(plen);
+	ph.nxt = ip6h->ip6_nxt;
+	in_csum(&ph, sizeof(ph), 0, &sum);
+	if (in_csum(ip6h + 1, plen, sum, NULL))
+		return false;
+
+	pkt->buf = (const char *)(ip6h + 1);
+	pkt->len = plen;
+	pkt->ttl_hl = ip6h->ip6_hlim;
+	pkt->multicast = IN6_IS_ADDR_MULTICAST(&ip6h->ip6_dst);
+	src->sin6_family = AF_INET6;
+	src->sin6_addr = ip6h->ip6_src;
+	if (IN6_IS_ADDR_LINKLOCAL(&src->sin6_addr))
+		src->sin6_scope_id = sock->ifp->ifindex;
+
+	return true;
+}
+
+/* Get the next packet from the ring, returning blocks we have finished
+ * with to the kernel. Returns false if there are no more packets. */
+bool
+vrrp_rx_ring_next(sock_t *sock, vrrp_rx_pkt_t *pkt)
+{
+	struct tpacket_block_desc *pbd;
+	const struct tpacket3_hdr *ppd;
+	bool valid;
+
+	for (;;) {
+		pbd = PTR_CAST(struct tpacket_block_desc, sock->rx_ring + (size_t)sock->rx_ring_block * sock->rx_ring_block_size);
+
+		if (!sock->rx_ring_pkt) {
+			if (!(__atomic_load_n(&pbd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+				return false;
+
+			sock->rx_ring_pkt = (char *)pbd + pbd->hdr.bh1.offset_to_first_pkt;
+			sock->rx_ring_pkts_left = pbd->hdr.bh1.num_pkts;
+		}
+
+		if (!sock->rx_ring_pkts_left) {
+			/* Hand the block back to the kernel */
+			__atomic_store_n(&pbd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+			sock->rx_ring_pkt = NULL;
+			if (++sock->rx_ring_block == sock->rx_ring_block_nr)
+				sock->rx_ring_block = 0;
+			continue;
+		}
+
+		ppd = PTR_CAST_CONST(struct tpacket3_hdr, sock->rx_ring_pkt);
+		sock->rx_ring_pkt += ppd->tp_next_offset;
+		sock->rx_ring_pkts_left--;
+
+		/* Skip anything truncated */
+		if (ppd->tp_snaplen != ppd->tp_len)
+			continue;
+
+		memset(pkt, 0, sizeof(*pkt));
+		pkt->ttl_hl = -1;
+		pkt->have_ts = true;
+		pkt->ts.tv_sec = ppd->tp_sec;
+		pkt->ts.tv_nsec = ppd->tp_nsec;
+
+		if (sock->family == AF_INET)
+			valid = parse_rx_ring_ipv4(ppd, pkt);
+		else
+			valid = parse_rx_ring_ipv6(sock, ppd, pkt);
+
+		if (valid)
+			return true;
+	}
+}
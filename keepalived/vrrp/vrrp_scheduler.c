@@ -30,6 +30,8 @@
 #endif
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <inttypes.h>
 
 #include <assert.h>
@@ -61,6 +63,12 @@
 #include "bfd_event.h"
 #include "bfd_daemon.h"
 #endif
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+#include "vrrp_advert_thread.h"
+#endif
+#ifdef _WITH_VRRP_RX_RING_
+#include "vrrp_rx_ring.h"
+#endif
 #ifdef THREAD_DUMP
 #include "scheduler.h"
 #endif
@@ -122,6 +130,7 @@ static thread_ref_t bfd_thread;		 /* BFD control pipe read thread */
 
 static void vrrp_script_child_thread(thread_ref_t);
 static void vrrp_script_thread(thread_ref_t);
+static void vrrp_script_coprocess_done(void *, int, bool);
 #ifdef _WITH_BFD_
 static void vrrp_bfd_thread(thread_ref_t);
 #endif
@@ -303,6 +312,62 @@ vrrp_init_state(list_head_t *l)
 /* Declare vrrp_timer_less() rbtree compare function */
 RB_TIMER_LESS(vrrp, rb_sands);
 
+static inline uint64_t
+vrrp_align_mix(uint64_t x)
+{
+	/* splitmix64 finaliser */
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+
+	return x;
+}
+
+/* With vrrp_advert_align, the deadlines of masters sharing a socket and
+ * advert interval are placed on a common grid, so that they all expire
+ * together and are sent in one pass of vrrp_dispatcher_read_timeout().
+ * The grid phase is derived from the socket and interval, and a per
+ * process random seed so that we don't line up with other routers. */
+static timeval_t
+vrrp_aligned_sands(const vrrp_t *vrrp)
+{
+	static uint64_t align_seed;
+	const sock_t *sock = vrrp->sockets;
+	uint64_t now, key, period, next, jitter;
+	timeval_t sands;
+
+	if (!align_seed)
+		align_seed = vrrp_align_mix(((uint64_t)random() << 32) ^ (uint64_t)random() ^ (uint64_t)getpid()) | 1;
+
+	now = (uint64_t)time_now.tv_sec * TIMER_HZ + (uint64_t)time_now.tv_usec;
+	key = vrrp_align_mix(align_seed ^
+			     ((uint64_t)sock->family << 56) ^ ((uint64_t)sock->proto << 48) ^
+			     ((uint64_t)(sock->ifp ? sock->ifp->ifindex : 0) << 24) ^
+			     (uint64_t)vrrp->adver_int);
+
+	jitter = global_data->vrrp_advert_align_jitter;
+	if (jitter > vrrp->adver_int / 4)
+		jitter = vrrp->adver_int / 4;
+
+	/* Find the first grid point after now. Jitter moves a grid point
+	 * earlier, and all members of a group must compute the same jitter
+	 * for a given period. */
+	for (period = (now - key % vrrp->adver_int) / vrrp->adver_int + 1; ; period++) {
+		next = period * vrrp->adver_int + key % vrrp->adver_int;
+		if (jitter)
+			next -= vrrp_align_mix(key ^ period) % (jitter + 1);
+		if (next > now)
+			break;
+	}
+
+	sands.tv_sec = (time_t)(next / TIMER_HZ);
+	sands.tv_usec = (suseconds_t)(next % TIMER_HZ);
+
+	return sands;
+}
+
 /* Compute the new instance sands */
 void
 vrrp_init_instance_sands(vrrp_t *vrrp)
@@ -312,6 +377,8 @@ vrrp_init_instance_sands(vrrp_t *vrrp)
 	if (vrrp->state == VRRP_STATE_MAST) {
 		if (vrrp->reload_master)
 			vrrp->sands = time_now;
+		else if (global_data->vrrp_advert_align)
+			vrrp->sands = vrrp_aligned_sands(vrrp);
 		else
 			vrrp->sands = timer_add_long(time_now, vrrp->adver_int);
 	}
@@ -611,6 +678,10 @@ vrrp_dispatcher_init(__attribute__((unused)) thread_ref_t thread)
 	if (__test_bit(LOG_DETAIL_BIT, &debug))
 		dump_sock_list(NULL, &vrrp_data->vrrp_socket_pool);
 
+#ifdef _WITH_VRRP_ADVERT_THREAD_
+	start_vrrp_advert_thread();
+#endif
+
 	vrrp_initialised = true;
 	UNSET_RELOAD;
 }
@@ -918,15 +989,167 @@ vrrp_dispatcher_read_timeout(sock_t *sock)
 	return sock->fd_in;
 }
 
+/* Process one received advert. Returns true if no more adverts should be
+ * read from the socket in this pass */
+static bool
+vrrp_dispatcher_process(sock_t *sock, const vrrphdr_t *hd, const vrrp_rx_pkt_t *pkt, unsigned long *rx_vrid_map)
+{
+	vrrp_t *vrrp;
+	rb_node_t *vrrp_node;
+	int prev_state = 0;
+	bool terminate_receiving = false;
+	const struct iphdr *iph;
+
+	vrrp_node = rb_find(&hd->vrid, &sock->rb_vrid, vrrp_vrid_cmp);
+
+	/* No instance found => ignore the advert */
+	if (!vrrp_node) {
+		if (global_data->log_unknown_vrids)
+			log_message(LOG_INFO, "Unknown VRID(%d) received on interface(%s). ignoring..."
+					    , hd->vrid, IF_NAME(sock->ifp));
+		return false;
+	}
+	vrrp = rb_entry(vrrp_node, vrrp_t, rb_vrid);
+
+	/* Defense strategy here is to handle no more than one advert
+	 * per VRID in order to flush socket rcvq...
+	 * This is a best effort mitigation */
+	if (__test_and_set_bit_array(hd->vrid, rx_vrid_map))
+		terminate_receiving = true;
+
+	if (__test_bit(VRRP_FLAG_UNICAST_DUPLICATE_VRID, &vrrp->flags)) {
+		rb_node_t *first = vrrp_node;	/* Save for second loop */
+
+		/* First check the address we last received an advert from. This is
+		 * an optimisation since we are most likely to receive an advert from
+		 * the same address as last time, and it saves searching all the peers. */
+		for (; vrrp_node; vrrp_node = rb_next_match(&hd->vrid, vrrp_node, vrrp_vrid_cmp)) {
+			vrrp = rb_entry(vrrp_node, vrrp_t, rb_vrid);
+			if (!inet_sockaddrcmp(&pkt->src_addr, &vrrp->pkt_saddr))
+				break;
+		}
+
+		if (!vrrp_node) {
+			/* Loop through VRRP instances matching hd->vrid if unicast to match
+			 * src address of packet against configured peers */
+			for (vrrp_node = first; vrrp_node; vrrp_node = rb_next_match(&hd->vrid, vrrp_node, vrrp_vrid_cmp)) {
+				vrrp = rb_entry(vrrp_node, vrrp_t, rb_vrid);
+
+				/* We have found the matching peer */
+				if (vrrp_find_unicast_peer(vrrp, &pkt->src_addr))
+					break;
+			}
+
+			if (!vrrp_node) {
+				/* Do nothing and fail because we didn't match any good instance */
+				if (global_data->log_unknown_vrids)
+					log_message(LOG_INFO, "Unknown VRID(%d) received on interface(%s) from %s. ignoring..."
+							    , hd->vrid, IF_NAME(sock->ifp), inet_sockaddrtos(&pkt->src_addr));
+
+				return terminate_receiving;
+			}
+		}
+	}
+
+	if (vrrp->state == VRRP_STATE_FAULT || vrrp->state == VRRP_STATE_INIT) {
+		/* We just ignore a message received when we are in fault state or
+		 * not yet fully initialised */
+		return terminate_receiving;
+	}
+
+	/* Save non packet data */
+	vrrp->pkt_saddr = pkt->src_addr;
+	vrrp->pkt_rx_time = time_now;
+	if (sock->family == AF_INET) {
+		iph = PTR_CAST_CONST(struct iphdr, pkt->buf);
+		vrrp->multicast_pkt = IN_MULTICAST(htonl(iph->daddr));
+		vrrp->rx_ttl_hl = iph->ttl;
+	} else {
+		vrrp->multicast_pkt = pkt->multicast;
+		vrrp->rx_ttl_hl = pkt->ttl_hl;
+	}
+#ifdef _NETWORK_TIMESTAMP_
+	if (pkt->have_ts && do_network_timestamp)
+		vrrp_rx_timestamp(vrrp, &pkt->ts);
+#endif
+
+	/* For multicast, we attempt to bind the socket to ::1 to stop receiving any (non ::1)
+	 * unicast packets, but if that fails we will receive unicast packets on the multicast socket,
+	 * so just discard them here.
+	 * For unicast sockets, if any other instance on the same interface is using multicast we
+	 * will also receive the multicast packets, so also discard them here. */
+	if (sock->family == AF_INET6 && vrrp->multicast_pkt == __test_bit(VRRP_FLAG_UNICAST, &vrrp->flags)) {
+		if (__test_bit(LOG_DETAIL_BIT, &debug))
+			log_message(LOG_INFO, "(%s) discarding %sicast packet on %sicast instance", vrrp->iname,
+					vrrp->multicast_pkt ? "mult" : "un", __test_bit(VRRP_FLAG_UNICAST, &vrrp->flags) ? "un" : "mult");
+		return terminate_receiving;
+	}
+
+	prev_state = vrrp->state;
+
+	if (vrrp->state == VRRP_STATE_BACK)
+		vrrp_state_backup(vrrp, hd, pkt->buf, pkt->len);
+	else if (vrrp->state == VRRP_STATE_MAST) {
+		if (vrrp_state_master_rx(vrrp, hd, pkt->buf, pkt->len))
+			vrrp_state_leave_master(vrrp, false);
+	} else
+		log_message(LOG_INFO, "(%s) In dispatcher_read with state %d"
+				    , vrrp->iname, vrrp->state);
+
+
+	/* handle instance synchronization */
+#ifdef _TSM_DEBUG_
+	if (do_tsm_debug)
+		log_message(LOG_INFO, "Read [%s] TSM transition : [%d,%d] Wantstate = [%d]"
+				    , vrrp->iname, prev_state, vrrp->state, vrrp->wantstate);
+#endif
+	VRRP_TSM_HANDLE(prev_state, vrrp);
+
+	/* If we have sent an advert, reset the timer */
+	if (vrrp->state != VRRP_STATE_MAST || !vrrp->lower_prio_no_advert)
+		vrrp_init_instance_sands(vrrp);
+
+	return terminate_receiving;
+}
+
+#ifdef _WITH_VRRP_RX_RING_
+/* Handle adverts queued in the socket's receive ring */
+static int
+vrrp_dispatcher_read_ring(sock_t *sock)
+{
+	const vrrphdr_t *hd;
+	vrrp_rx_pkt_t pkt;
+	unsigned long rx_vrid_map[BIT_WORD(256 + BIT_PER_LONG - 1)] = { 0 };
+	bool terminate_receiving = false;
+
+	/* The same one advert per VRID per pass strategy as for recvmsg applies,
+	 * and any adverts left in the ring are picked up on the next pass */
+	while (!terminate_receiving && vrrp_rx_ring_next(sock, &pkt)) {
+#ifdef _RECVMSG_DEBUG_
+		if (do_recvmsg_debug_dump)
+			log_buffer("Received data", pkt.buf, pkt.len);
+#endif
+
+		if (vrrp_delayed_start_time.tv_sec)
+			continue;
+
+		if (!(hd = vrrp_get_header(sock->family, pkt.buf, pkt.len)))
+			continue;
+
+		terminate_receiving = vrrp_dispatcher_process(sock, hd, &pkt, rx_vrid_map);
+	}
+
+	return sock->fd_in;
+}
+#endif
+
 /* Handle dispatcher read packet */
 static int
 vrrp_dispatcher_read(sock_t *sock)
 {
-	vrrp_t *vrrp;
-	rb_node_t *vrrp_node;
 	const vrrphdr_t *hd;
 	ssize_t len = 0;
-	int prev_state = 0;
+	vrrp_rx_pkt_t pkt;
 	sockaddr_t src_addr = { .ss_family = AF_UNSPEC };
 #ifdef _NETWORK_TIMESTAMP_
 	char control_buf[128] __attribute__((aligned(__alignof__(struct cmsghdr))));
@@ -945,8 +1168,11 @@ vrrp_dispatcher_read(sock_t *sock)
 #ifdef DEBUG_RECVMSG
 	unsigned recv_data_count = 0;
 #endif
-	const struct iphdr *iph;
-	unicast_peer_t *unicast_peer;
+
+#ifdef _WITH_VRRP_RX_RING_
+	if (sock->rx_ring)
+		return vrrp_dispatcher_read_ring(sock);
+#endif
 
 	/* Strategy here is to handle incoming adverts pending into socket recvq
 	 * but stop if receive 2nd advert for a VRID on socket (this applies to
@@ -1043,81 +1269,13 @@ vrrp_dispatcher_read(sock_t *sock)
 		if (!(hd = vrrp_get_header(sock->family, vrrp_buffer, len)))
 			break;
 
-		vrrp_node = rb_find(&hd->vrid, &sock->rb_vrid, vrrp_vrid_cmp);
-
-		/* No instance found => ignore the advert */
-		if (!vrrp_node) {
-			if (global_data->log_unknown_vrids)
-				log_message(LOG_INFO, "Unknown VRID(%d) received on interface(%s). ignoring..."
-						    , hd->vrid, IF_NAME(sock->ifp));
-			continue;
-		}
-		vrrp = rb_entry(vrrp_node, vrrp_t, rb_vrid);
-
-		/* Defense strategy here is to handle no more than one advert
-		 * per VRID in order to flush socket rcvq...
-		 * This is a best effort mitigation */
-		if (__test_and_set_bit_array(hd->vrid, rx_vrid_map))
-			terminate_receiving = true;
-
-		if (__test_bit(VRRP_FLAG_UNICAST_DUPLICATE_VRID, &vrrp->flags)) {
-			rb_node_t *first = vrrp_node;	/* Save for second loop */
-
-			/* First check the address we last received an advert from. This is
-			 * an optimisation since we are most likely to receive an advert from
-			 * the same address as last time, and it saves searching all the peers. */
-			for (; vrrp_node; vrrp_node = rb_next_match(&hd->vrid, vrrp_node, vrrp_vrid_cmp)) {
-				vrrp = rb_entry(vrrp_node, vrrp_t, rb_vrid);
-				if (!inet_sockaddrcmp(&src_addr, &vrrp->pkt_saddr))
-					break;
-			}
-
-			if (!vrrp_node) {
-				/* Loop through VRRP instances matching hd->vrid if unicast to match
-				 * src address of packet against configured peers */
-				for (vrrp_node = first; vrrp_node; vrrp_node = rb_next_match(&hd->vrid, vrrp_node, vrrp_vrid_cmp)) {
-					vrrp = rb_entry(vrrp_node, vrrp_t, rb_vrid);
-
-					list_for_each_entry(unicast_peer, &vrrp->unicast_peer, e_list) {
-						if (inet_sockaddrcmp(&src_addr, &unicast_peer->address) == 0)
-							break;
-						if (list_is_last(&unicast_peer->e_list, &vrrp->unicast_peer)) {
-							unicast_peer = NULL;
-							break;
-						}
-					}
-
-					/* We have found the matching peer */
-					if (unicast_peer)
-						break;
-				}
-
-				if (!vrrp_node) {
-					/* Do nothing and fail because we didn't match any good instance */
-					if (global_data->log_unknown_vrids)
-						log_message(LOG_INFO, "Unknown VRID(%d) received on interface(%s) from %s. ignoring..."
-								    , hd->vrid, IF_NAME(sock->ifp), inet_sockaddrtos(&src_addr));
-
-					continue;
-				}
-			}
-		}
-
-		if (vrrp->state == VRRP_STATE_FAULT || vrrp->state == VRRP_STATE_INIT) {
-			/* We just ignore a message received when we are in fault state or
-			 * not yet fully initialised */
-			continue;
-		}
-
 		/* Save non packet data */
-		vrrp->pkt_saddr = src_addr;
-		vrrp->rx_ttl_hl = -1;           /* Default to not received */
-		if (sock->family == AF_INET) {
-			iph = PTR_CAST_CONST(struct iphdr, vrrp_buffer);
-			vrrp->multicast_pkt = IN_MULTICAST(htonl(iph->daddr));
-			vrrp->rx_ttl_hl = iph->ttl;
-		} else
-			vrrp->multicast_pkt = false;
+		pkt.buf = vrrp_buffer;
+		pkt.len = (size_t)len;
+		pkt.src_addr = src_addr;
+		pkt.ttl_hl = -1;           /* Default to not received */
+		pkt.multicast = false;
+		pkt.have_ts = false;
 		for (cmsg = CMSG_FIRSTHDR(&msghdr); cmsg; cmsg = CMSG_NXTHDR(&msghdr, cmsg)) {
 			expected_cmsg = false;
 			if (cmsg->cmsg_level == IPPROTO_IPV6) {
@@ -1125,11 +1283,11 @@ vrrp_dispatcher_read(sock_t *sock)
 
 				if (cmsg->cmsg_type == IPV6_HOPLIMIT &&
 				    cmsg->cmsg_len - sizeof(struct cmsghdr) == sizeof(unsigned int))
-					vrrp->rx_ttl_hl = *PTR_CAST(unsigned int, CMSG_DATA(cmsg));
+					pkt.ttl_hl = *PTR_CAST(unsigned int, CMSG_DATA(cmsg));
 				else
 				if (cmsg->cmsg_type == IPV6_PKTINFO &&
 				    cmsg->cmsg_len - sizeof(struct cmsghdr) == sizeof(struct in6_pktinfo))
-					vrrp->multicast_pkt = IN6_IS_ADDR_MULTICAST(&(PTR_CAST(struct in6_pktinfo, CMSG_DATA(cmsg)))->ipi6_addr);
+					pkt.multicast = IN6_IS_ADDR_MULTICAST(&(PTR_CAST(struct in6_pktinfo, CMSG_DATA(cmsg)))->ipi6_addr);
 				else
 					expected_cmsg = false;
 			}
@@ -1140,6 +1298,8 @@ vrrp_dispatcher_read(sock_t *sock)
 
 				expected_cmsg = true;
 				if (cmsg->cmsg_type == SO_TIMESTAMPNS) {
+					pkt.have_ts = true;
+					pkt.ts = *ts;
 					strftime(time_buf, sizeof time_buf, "%T", localtime(&ts->tv_sec));
 					log_message(LOG_INFO, "TIMESTAMPNS (socket %d - VRID %u) %s.%9.9" PRI_ts_nsec
 							    , sock->fd_in, hd->vrid, time_buf, ts->tv_nsec);
@@ -1167,41 +1327,7 @@ vrrp_dispatcher_read(sock_t *sock)
 						    , cmsg->cmsg_level, cmsg->cmsg_type);
 		}
 
-		/* For multicast, we attempt to bind the socket to ::1 to stop receiving any (non ::1)
-		 * unicast packets, but if that fails we will receive unicast packets on the multicast socket,
-		 * so just discard them here.
-		 * For unicast sockets, if any other instance on the same interface is using multicast we
-		 * will also receive the multicast packets, so also discard them here. */
-		if (sock->family == AF_INET6 && vrrp->multicast_pkt == __test_bit(VRRP_FLAG_UNICAST, &vrrp->flags)) {
-			if (__test_bit(LOG_DETAIL_BIT, &debug))
-				log_message(LOG_INFO, "(%s) discarding %sicast packet on %sicast instance", vrrp->iname,
-						vrrp->multicast_pkt ? "mult" : "un", __test_bit(VRRP_FLAG_UNICAST, &vrrp->flags) ? "un" : "mult");
-			continue;
-		}
-
-		prev_state = vrrp->state;
-
-		if (vrrp->state == VRRP_STATE_BACK)
-			vrrp_state_backup(vrrp, hd, vrrp_buffer, len);
-		else if (vrrp->state == VRRP_STATE_MAST) {
-			if (vrrp_state_master_rx(vrrp, hd, vrrp_buffer, len))
-				vrrp_state_leave_master(vrrp, false);
-		} else
-			log_message(LOG_INFO, "(%s) In dispatcher_read with state %d"
-					    , vrrp->iname, vrrp->state);
-
-
-		/* handle instance synchronization */
-#ifdef _TSM_DEBUG_
-		if (do_tsm_debug)
-			log_message(LOG_INFO, "Read [%s] TSM transition : [%d,%d] Wantstate = [%d]"
-					    , vrrp->iname, prev_state, vrrp->state, vrrp->wantstate);
-#endif
-		VRRP_TSM_HANDLE(prev_state, vrrp);
-
-		/* If we have sent an advert, reset the timer */
-		if (vrrp->state != VRRP_STATE_MAST || !vrrp->lower_prio_no_advert)
-			vrrp_init_instance_sands(vrrp);
+		terminate_receiving = vrrp_dispatcher_process(sock, hd, &pkt, rx_vrid_map);
 	}
 
 	return sock->fd_in;
@@ -1246,6 +1372,14 @@ vrrp_script_thread(thread_ref_t thread)
 		return;
 	}
 
+	if (vscript->persistent) {
+		if (coprocess_request(thread->master, &vscript->req, &vscript->script,
+				      (vscript->timeout) ? vscript->timeout : vscript->interval,
+				      vrrp_script_coprocess_done, vscript))
+			vscript->state = SCRIPT_STATE_RUNNING;
+		return;
+	}
+
 	/* Execute the script in a child process. Parent returns, child doesn't */
 #ifdef _SCRIPT_DEBUG_
 	if (do_script_debug)
@@ -1258,6 +1392,82 @@ vrrp_script_thread(thread_ref_t thread)
 		vscript->state = SCRIPT_STATE_RUNNING;
 }
 
+/* Handle the exit status of the script, or the reply of a persistent script */
+static void
+vrrp_script_result(vrrp_script_t *vscript, int wait_status)
+{
+	const char *script_exit_type = NULL;
+	bool script_success;
+	const char *reason = NULL;
+	int reason_code;
+
+	if (WIFEXITED(wait_status)) {
+		int status = WEXITSTATUS(wait_status);
+
+		/* Report if status has changed */
+		if (status != vscript->last_status)
+			log_message(LOG_INFO, "Script `%s` now returning %d", vscript->sname, status);
+
+		if (status == 0) {
+			/* success */
+			script_exit_type = "succeeded";
+			script_success = true;
+		} else {
+			/* failure */
+			script_exit_type = "failed";
+			script_success = false;
+			reason = "exited with status";
+			reason_code = status;
+		}
+
+		vscript->last_status = status;
+	}
+	else if (WIFSIGNALED(wait_status)) {
+		/* We treat forced termination as a failure */
+		if ((vscript->state == SCRIPT_STATE_REQUESTING_TERMINATION && WTERMSIG(wait_status) == SIGTERM) ||
+		    (vscript->state == SCRIPT_STATE_FORCING_TERMINATION && (WTERMSIG(wait_status) == SIGKILL || WTERMSIG(wait_status) == SIGTERM)))
+			script_exit_type = "timed_out";
+		else {
+			script_exit_type = "failed";
+			reason = "due to signal";
+			reason_code = WTERMSIG(wait_status);
+		}
+		script_success = false;
+	}
+
+	if (script_exit_type) {
+		if (script_success) {
+			if (vscript->result < vscript->rise - 1) {
+				vscript->result++;
+			} else if (vscript->result != vscript->rise + vscript->fall - 1) {
+				if (vscript->result < vscript->rise) {	/* i.e. == vscript->rise - 1 */
+					log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
+					update_script_priorities(vscript, true);
+				}
+				vscript->result = vscript->rise + vscript->fall - 1;
+			}
+		} else {
+			if (vscript->result > vscript->rise) {
+				vscript->result--;
+			} else {
+				if (vscript->result == vscript->rise ||
+				    vscript->init_state == SCRIPT_INIT_STATE_INIT ||
+				    vscript->init_state == SCRIPT_INIT_STATE_INIT_RELOAD) {
+					if (reason)
+						log_message(LOG_INFO, "VRRP_Script(%s) %s (%s %d)", vscript->sname, script_exit_type, reason, reason_code);
+					else
+						log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
+					update_script_priorities(vscript, false);
+				}
+				vscript->result = 0;
+			}
+		}
+	}
+
+	vscript->state = SCRIPT_STATE_IDLE;
+	vscript->init_state = SCRIPT_INIT_STATE_DONE;
+}
+
 static void
 vrrp_script_child_thread(thread_ref_t thread)
 {
@@ -1266,10 +1476,6 @@ vrrp_script_child_thread(thread_ref_t thread)
 	vrrp_script_t *vscript = THREAD_ARG(thread);
 	int sig_num;
 	unsigned timeout = 0;
-	const char *script_exit_type = NULL;
-	bool script_success;
-	const char *reason = NULL;
-	int reason_code;
 
 	if (thread->type == THREAD_CHILD_TIMEOUT) {
 		pid = THREAD_CHILD_PID(thread);
@@ -1339,93 +1545,39 @@ vrrp_script_child_thread(thread_ref_t thread)
 
 	wait_status = THREAD_CHILD_STATUS(thread);
 
-	if (WIFEXITED(wait_status)) {
-		int status = WEXITSTATUS(wait_status);
-
 #ifdef _SCRIPT_DEBUG_
-		if (do_script_debug)
-			log_message(LOG_INFO, "pid %d exited with status %d", THREAD_CHILD_PID(thread), status);
+	if (do_script_debug) {
+		if (WIFEXITED(wait_status))
+			log_message(LOG_INFO, "pid %d exited with status %d", THREAD_CHILD_PID(thread), WEXITSTATUS(wait_status));
+		else if (WIFSIGNALED(wait_status))
+			log_message(LOG_INFO, "pid %d exited due to signal %d (%s)", THREAD_CHILD_PID(thread), WTERMSIG(wait_status), strsignal(WTERMSIG(wait_status)));
+		else
+			log_message(LOG_INFO, "wait for pid %d exited with exit code 0x%x", THREAD_CHILD_PID(thread), (unsigned)wait_status);
+	}
 #endif
 
-		/* Report if status has changed */
-		if (status != vscript->last_status)
-			log_message(LOG_INFO, "Script `%s` now returning %d", vscript->sname, status);
-
-		if (status == 0) {
-			/* success */
-			script_exit_type = "succeeded";
-			script_success = true;
-		} else {
-			/* failure */
-			script_exit_type = "failed";
-			script_success = false;
-			reason = "exited with status";
-			reason_code = status;
-		}
-
-		vscript->last_status = status;
+	if (WIFSIGNALED(wait_status) &&
+	    vscript->state == SCRIPT_STATE_REQUESTING_TERMINATION && WTERMSIG(wait_status) == SIGTERM) {
+		/* The script terminated due to a SIGTERM, and we sent it a SIGTERM to
+		 * terminate the process. Now make sure any children it created have
+		 * died too. */
+		pid = THREAD_CHILD_PID(thread);
+		kill(-pid, SIGKILL);
 	}
-	else if (WIFSIGNALED(wait_status)) {
-#ifdef _SCRIPT_DEBUG_
-		if (do_script_debug)
-			log_message(LOG_INFO, "pid %d exited due to signal %d (%s)", THREAD_CHILD_PID(thread), WTERMSIG(wait_status), strsignal(WTERMSIG(wait_status)));
-#endif
 
-		if (vscript->state == SCRIPT_STATE_REQUESTING_TERMINATION && WTERMSIG(wait_status) == SIGTERM) {
-			/* The script terminated due to a SIGTERM, and we sent it a SIGTERM to
-			 * terminate the process. Now make sure any children it created have
-			 * died too. */
-			pid = THREAD_CHILD_PID(thread);
-			kill(-pid, SIGKILL);
-		}
+	vrrp_script_result(vscript, wait_status);
+}
 
-		/* We treat forced termination as a failure */
-		if ((vscript->state == SCRIPT_STATE_REQUESTING_TERMINATION && WTERMSIG(wait_status) == SIGTERM) ||
-		    (vscript->state == SCRIPT_STATE_FORCING_TERMINATION && (WTERMSIG(wait_status) == SIGKILL || WTERMSIG(wait_status) == SIGTERM)))
-			script_exit_type = "timed_out";
-		else {
-			script_exit_type = "failed";
-			reason = "due to signal";
-			reason_code = WTERMSIG(wait_status);
-		}
-		script_success = false;
-	}
-#ifdef _SCRIPT_DEBUG_
-	else if (do_script_debug)
-		log_message(LOG_INFO, "wait for pid %d exited with exit code 0x%x", THREAD_CHILD_PID(thread), (unsigned)wait_status);
-#endif
+static void
+vrrp_script_coprocess_done(void *arg, int status, bool timed_out)
+{
+	vrrp_script_t *vscript = arg;
 
-	if (script_exit_type) {
-		if (script_success) {
-			if (vscript->result < vscript->rise - 1) {
-				vscript->result++;
-			} else if (vscript->result != vscript->rise + vscript->fall - 1) {
-				if (vscript->result < vscript->rise) {	/* i.e. == vscript->rise - 1 */
-					log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
-					update_script_priorities(vscript, true);
-				}
-				vscript->result = vscript->rise + vscript->fall - 1;
-			}
-		} else {
-			if (vscript->result > vscript->rise) {
-				vscript->result--;
-			} else {
-				if (vscript->result == vscript->rise ||
-				    vscript->init_state == SCRIPT_INIT_STATE_INIT ||
-				    vscript->init_state == SCRIPT_INIT_STATE_INIT_RELOAD) {
-					if (reason)
-						log_message(LOG_INFO, "VRRP_Script(%s) %s (%s %d)", vscript->sname, script_exit_type, reason, reason_code);
-					else
-						log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
-					update_script_priorities(vscript, false);
-				}
-				vscript->result = 0;
-			}
-		}
-	}
+	/* The helper has been killed, so report it the same way as a script we killed */
+	if (timed_out)
+		vscript->state = SCRIPT_STATE_FORCING_TERMINATION;
 
-	vscript->state = SCRIPT_STATE_IDLE;
-	vscript->init_state = SCRIPT_INIT_STATE_DONE;
+	vrrp_script_result(vscript, status);
 }
 
 /* Thread to send gratuitous ARPs when the sending is rate limited */
@@ -1478,6 +1630,158 @@ vrrp_gna_thread(thread_ref_t thread)
 		thread_add_timer(master, vrrp_gna_thread, ifp, timer_long(timer_sub_now(ifp->garp_delay->gna_next_time)));
 }
 
+/*
+ * GARP/NA token bucket. If a garp_delay has a rate set, GARPs and NAs on all
+ * the interfaces using it share one bucket holding up to burst messages, which
+ * is refilled at rate messages per second. The credit is kept in usecs, each
+ * message costing TIMER_HZ / rate.
+ */
+static void
+garp_pacer_refill(garp_delay_t *gd)
+{
+	uint64_t max_credit = (uint64_t)(TIMER_HZ / gd->rate) * gd->burst;
+	timeval_t elapsed;
+
+	if (!timerisset(&gd->credit_time) ||
+	    timercmp(&time_now, &gd->credit_time, <))
+		gd->credit = max_credit;
+	else {
+		timersub(&time_now, &gd->credit_time, &elapsed);
+		gd->credit += timer_long(elapsed);
+		if (gd->credit > max_credit)
+			gd->credit = max_credit;
+	}
+	gd->credit_time = time_now;
+}
+
+static bool
+garp_pacer_take_token(garp_delay_t *gd)
+{
+	garp_pacer_refill(gd);
+
+	if (gd->credit < TIMER_HZ / gd->rate)
+		return false;
+
+	gd->credit -= TIMER_HZ / gd->rate;
+
+	return true;
+}
+
+/* usecs until the next token is available */
+static unsigned long
+garp_pacer_wait(garp_delay_t *gd)
+{
+	garp_pacer_refill(gd);
+
+	if (gd->credit >= TIMER_HZ / gd->rate)
+		return 0;
+
+	return TIMER_HZ / gd->rate - (unsigned long)gd->credit;
+}
+
+static inline bool
+garp_pacer_idle(const garp_delay_t *gd)
+{
+	return list_empty(&gd->garp_list) && list_empty(&gd->gna_list);
+}
+
+/* Returns true if a GARP/NA can be sent now without queueing it */
+bool
+garp_pacer_send_now(garp_delay_t *gd)
+{
+	return garp_pacer_idle(gd) && garp_pacer_take_token(gd);
+}
+
+/* Queue a GARP/NA until the token bucket allows it to be sent */
+void
+garp_pacer_queue(garp_delay_t *gd, ip_address_t *ipaddress, list_head_t *queue)
+{
+	if (garp_pacer_idle(gd))
+		gd->drain_start = time_now;
+
+	list_add_tail(&ipaddress->garp_gna_list, queue);
+	garp_pacer_pending(gd);
+
+	if (!gd->pacer_thread)
+		gd->pacer_thread = thread_add_timer(master, vrrp_garp_pacer_thread, gd,
+						    garp_pacer_wait(gd));
+}
+
+/* Note that one more message is waiting to be sent */
+void
+garp_pacer_pending(garp_delay_t *gd)
+{
+	if (++gd->queue_depth > gd->max_queue_depth)
+		gd->max_queue_depth = gd->queue_depth;
+}
+
+/* Note that an address's waiting messages are no longer to be sent */
+void
+garp_pacer_remove(garp_delay_t *gd, const ip_address_t *ipaddress)
+{
+	if (gd->queue_depth > ipaddress->garp_gna_pending)
+		gd->queue_depth -= ipaddress->garp_gna_pending;
+	else
+		gd->queue_depth = 0;
+}
+
+/* Thread to send queued GARPs and NAs as the token bucket allows. The
+ * queued addresses are sent round robin, so that all instances using
+ * the interfaces make progress, alternating between GARPs and NAs. */
+void
+vrrp_garp_pacer_thread(thread_ref_t thread)
+{
+	garp_delay_t *gd = THREAD_ARG(thread);
+	list_head_t *queue;
+	ip_address_t *ip_addr;
+	timeval_t drain_time;
+
+	gd->pacer_thread = NULL;
+
+	set_time_now();
+
+	gratuitous_arp_batch();
+	ndisc_batch();
+
+	while (!garp_pacer_idle(gd) && garp_pacer_take_token(gd)) {
+		if (list_empty(&gd->gna_list) ||
+		    (!list_empty(&gd->garp_list) && !gd->pace_gna_next))
+			queue = &gd->garp_list;
+		else
+			queue = &gd->gna_list;
+		gd->pace_gna_next = queue == &gd->garp_list;
+
+		ip_addr = list_first_entry(queue, ip_address_t, garp_gna_list);
+
+		if (queue == &gd->garp_list)
+			send_gratuitous_arp_immediate(IF_BASE_IFP(ip_addr->ifp), ip_addr);
+		else
+			ndisc_send_unsolicited_na_immediate(IF_BASE_IFP(ip_addr->ifp), ip_addr);
+
+		if (gd->queue_depth)
+			gd->queue_depth--;
+
+		list_del_init(&ip_addr->garp_gna_list);
+		if (--ip_addr->garp_gna_pending)
+			list_add_tail(&ip_addr->garp_gna_list, queue);
+	}
+
+	gratuitous_arp_flush();
+	ndisc_flush();
+
+	if (garp_pacer_idle(gd)) {
+		gd->queue_depth = 0;
+		timersub(&time_now, &gd->drain_start, &drain_time);
+		gd->last_drain_time = timer_long(drain_time);
+		if (gd->last_drain_time > gd->max_drain_time)
+			gd->max_drain_time = gd->last_drain_time;
+		return;
+	}
+
+	gd->pacer_thread = thread_add_timer(master, vrrp_garp_pacer_thread, gd,
+					    garp_pacer_wait(gd));
+}
+
 #ifdef _WITH_DUMP_THREADS_
 void
 dump_threads(void)
@@ -1523,6 +1827,7 @@ register_vrrp_scheduler_addresses(void)
 {
 	register_thread_address("vrrp_arp_thread", vrrp_arp_thread);
 	register_thread_address("vrrp_gna_thread", vrrp_gna_thread);
+	register_thread_address("vrrp_garp_pacer_thread", vrrp_garp_pacer_thread);
 	register_thread_address("vrrp_dispatcher_init", vrrp_dispatcher_init);
 	register_thread_address("vrrp_gratuitous_arp_thread", vrrp_gratuitous_arp_thread);
 	register_thread_address("vrrp_lower_prio_gratuitous_arp_thread", vrrp_lower_prio_gratuitous_arp_thread);
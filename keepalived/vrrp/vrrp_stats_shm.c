@@ -0,0 +1,145 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        VRRP live statistics in shared memory.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "vrrp_stats_shm.h"
+#include "vrrp_data.h"
+#include "global_data.h"
+#include "main.h"
+#include "scheduler.h"
+#include "list_head.h"
+#include "utils.h"
+
+static stats_shm_t *vrrp_shm;
+
+/* Copy the instance's current state and stats to its record. This is
+ * called from the refresh timer, whenever the instance changes state and
+ * from vrrp_set_effective_priority(). */
+void
+vrrp_stats_shm_update(vrrp_t *vrrp)
+{
+	vrrp_shm_rec_t *rec = vrrp->shm_rec;
+	const vrrp_stats *stats = vrrp->stats;
+	unsigned i;
+
+	if (!rec)
+		return;
+
+	stats_shm_write_begin(&rec->seq);
+
+	rec->state = vrrp->state;
+	rec->wantstate = vrrp->wantstate;
+	rec->effective_priority = vrrp->effective_priority;
+	rec->last_transition = stats_shm_timeval(&vrrp->last_transition);
+
+	rec->advert_rcvd = stats->advert_rcvd;
+	rec->advert_sent = stats->advert_sent;
+	rec->become_master = stats->become_master;
+	rec->release_master = stats->release_master;
+	rec->packet_len_err = stats->packet_len_err;
+	rec->advert_interval_err = stats->advert_interval_err;
+	rec->ip_ttl_err = stats->ip_ttl_err;
+	rec->invalid_type_rcvd = stats->invalid_type_rcvd;
+	rec->addr_list_err = stats->addr_list_err;
+	rec->invalid_authtype = stats->invalid_authtype;
+#ifdef _WITH_VRRP_AUTH_
+	rec->authtype_mismatch = stats->authtype_mismatch;
+	rec->auth_failure = stats->auth_failure;
+#endif
+	rec->pri_zero_rcvd = stats->pri_zero_rcvd;
+	rec->pri_zero_sent = stats->pri_zero_sent;
+	rec->na_sent = stats->na_sent;
+	for (i = 0; i < VRRP_RX_INTERVAL_BUCKETS; i++)
+		rec->rx_interval_hist[i] = stats->rx_interval_hist[i];
+	rec->rx_interval_max = stats->rx_interval_max;
+
+	stats_shm_write_end(&rec->seq);
+}
+
+static void
+vrrp_stats_shm_thread(__attribute__((unused)) thread_ref_t thread)
+{
+	vrrp_t *vrrp;
+
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list)
+		vrrp_stats_shm_update(vrrp);
+
+	stats_shm_set_update_time(vrrp_shm);
+
+	thread_add_timer(master, vrrp_stats_shm_thread, NULL, global_data->stats_shm_refresh);
+}
+
+/* Called after the configuration has been read, and after each reload */
+void
+vrrp_stats_shm_init(void)
+{
+	vrrp_t *vrrp;
+	vrrp_shm_rec_t *rec;
+	unsigned num_recs = 0;
+
+	/* Old instances must not write to the segment being replaced */
+	if (old_vrrp_data) {
+		list_for_each_entry(vrrp, &old_vrrp_data->vrrp, e_list)
+			vrrp->shm_rec = NULL;
+	}
+
+	if (vrrp_shm)
+		stats_shm_close(&vrrp_shm, !global_data->vrrp_stats_shm || strcmp(global_data->vrrp_stats_shm, vrrp_shm->file_name));
+
+	if (!global_data->vrrp_stats_shm)
+		return;
+
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list)
+		num_recs++;
+
+	if (!(vrrp_shm = stats_shm_create(global_data->vrrp_stats_shm, STATS_SHM_VRRP, sizeof(vrrp_shm_rec_t), num_recs)))
+		return;
+
+	num_recs = 0;
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list) {
+		rec = vrrp->shm_rec = stats_shm_rec(vrrp_shm, num_recs++);
+
+		/* These don't change until the next reload */
+		strcpy_safe(rec->iname, vrrp->iname);
+		if (vrrp->ifp)
+			strcpy_safe(rec->ifname, vrrp->ifp->ifname);
+		rec->vrid = vrrp->vrid;
+		rec->version = (uint8_t)vrrp->version;
+		rec->family = vrrp->family;
+		rec->base_priority = vrrp->base_priority;
+
+		vrrp_stats_shm_update(vrrp);
+	}
+
+	stats_shm_set_update_time(vrrp_shm);
+
+	thread_add_timer(master, vrrp_stats_shm_thread, NULL, global_data->stats_shm_refresh);
+}
+
+void
+vrrp_stats_shm_close(void)
+{
+	stats_shm_close(&vrrp_shm, true);
+}
@@ -45,6 +45,7 @@
 #include "parser.h"
 #include "utils.h"
 #include "vrrp_notify.h"
+#include "vrrp_stats_shm.h"
 #include "bitops.h"
 #include "track_file.h"
 #include "main.h"
@@ -615,6 +616,8 @@ vrrp_set_effective_priority(vrrp_t *vrrp)
 		vrrp_thread_requeue_read(vrrp);
 	}
 
+	vrrp_stats_shm_update(vrrp);
+
 	if (vrrp->notify_priority_changes)
 		send_instance_priority_notifies(vrrp);
 }
@@ -0,0 +1,487 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Persistent scripts, run once and sent a request per check.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "coprocess.h"
+#include "logger.h"
+#include "memory.h"
+#include "utils.h"
+
+static LIST_HEAD_INITIALIZE(coprocesses);
+
+static void coprocess_read_thread(thread_ref_t);
+static void coprocess_write_thread(thread_ref_t);
+static void coprocess_child_thread(thread_ref_t);
+static void coprocess_timeout_thread(thread_ref_t);
+
+static inline const char *
+coprocess_path(const notify_script_t *script)
+{
+	return script->path ? script->path : script->args[0];
+}
+
+/* The request line cannot carry parameters with embedded newlines */
+bool __attribute__ ((pure))
+coprocess_script_valid(const notify_script_t *script)
+{
+	int i;
+
+	for (i = 1; i < script->num_args; i++) {
+		if (strchr(script->args[i], '\n'))
+			return false;
+	}
+
+	return true;
+}
+
+static coprocess_t * __attribute__ ((pure))
+find_coprocess(const notify_script_t *script)
+{
+	coprocess_t *cp;
+
+	list_for_each_entry(cp, &coprocesses, e_list) {
+		if (cp->script->uid == script->uid &&
+		    cp->script->gid == script->gid &&
+		    !strcmp(coprocess_path(cp->script), coprocess_path(script)))
+			return cp;
+	}
+
+	return NULL;
+}
+
+static void
+coprocess_close(coprocess_t *cp)
+{
+	thread_cancel(cp->read_thread);
+	cp->read_thread = NULL;
+	thread_cancel(cp->write_thread);
+	cp->write_thread = NULL;
+
+	if (cp->fd != -1) {
+		close(cp->fd);
+		cp->fd = -1;
+	}
+
+	cp->wbuf_len = 0;
+	cp->rbuf_len = 0;
+}
+
+/* The outstanding requests are resent when the helper has been reaped */
+static void
+coprocess_kill(coprocess_t *cp)
+{
+	kill(-cp->pid, SIGKILL);
+	cp->killed = true;
+	coprocess_close(cp);
+}
+
+/* Called from the read thread when the helper can no longer reply */
+static void
+coprocess_lost(thread_ref_t thread, coprocess_t *cp)
+{
+	/* A pending write thread shares the fd's event with the read thread,
+	 * and thread_close_fd() frees the event, so cancel the write first. */
+	thread_cancel(cp->write_thread);
+	cp->write_thread = NULL;
+
+	thread_close_fd(thread);
+	cp->fd = -1;
+
+	coprocess_kill(cp);
+}
+
+static void
+coprocess_complete(coprocess_req_t *req, int status, bool timed_out)
+{
+	list_del_init(&req->e_list);
+	thread_cancel(req->timer_thread);
+	req->timer_thread = NULL;
+	req->cp = NULL;
+
+	(*req->func)(req->arg, status, timed_out);
+}
+
+static void
+coprocess_fail_all(coprocess_t *cp, int status)
+{
+	coprocess_req_t *req, *req_tmp;
+	LIST_HEAD_INITIALIZE(reqs);
+
+	/* The callbacks may issue new requests */
+	list_splice_init(&cp->requests, &reqs);
+
+	list_for_each_entry_safe(req, req_tmp, &reqs, e_list)
+		coprocess_complete(req, status, false);
+}
+
+static void
+coprocess_flush(coprocess_t *cp)
+{
+	ssize_t len;
+
+	while (cp->wbuf_len) {
+		len = send(cp->fd, cp->wbuf, cp->wbuf_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				cp->write_thread = thread_add_write(cp->master, coprocess_write_thread, cp, cp->fd, TIMER_NEVER, 0);
+				return;
+			}
+
+			/* The helper has gone away. We will find out why when
+			 * it is reaped, and the requests will be failed then. */
+			log_message(LOG_INFO, "Persistent script %s (pid %d) write error %d - %m", cp->script->args[0], cp->pid, errno);
+			cp->wbuf_len = 0;
+			return;
+		}
+
+		cp->wbuf_len -= (size_t)len;
+		memmove(cp->wbuf, cp->wbuf + len, cp->wbuf_len);
+	}
+}
+
+static void
+coprocess_send(coprocess_t *cp, coprocess_req_t *req)
+{
+	char id_str[12];
+	size_t len, id_len;
+	char *p;
+	int i;
+
+	id_len = (size_t)snprintf(id_str, sizeof(id_str), "%u", req->id);
+	len = id_len + 1;
+	for (i = 1; i < req->script->num_args; i++)
+		len += strlen(req->script->args[i]) + 1;
+
+	if (cp->wbuf_len + len > cp->wbuf_size) {
+		cp->wbuf_size = cp->wbuf_len + len + 256;
+		if (cp->wbuf)
+			cp->wbuf = REALLOC(cp->wbuf, cp->wbuf_size);
+		else
+			cp->wbuf = MALLOC(cp->wbuf_size);
+	}
+
+	p = cp->wbuf + cp->wbuf_len;
+	memcpy(p, id_str, id_len);
+	p += id_len;
+	for (i = 1; i < req->script->num_args; i++) {
+		*p++ = ' ';
+		strcpy(p, req->script->args[i]);
+		p += strlen(p);
+	}
+	*p = '\n';
+	cp->wbuf_len += len;
+
+	req->sent = true;
+	req->sent_time = time_now;
+
+	if (!cp->write_thread)
+		coprocess_flush(cp);
+}
+
+static bool
+coprocess_start(coprocess_t *cp)
+{
+	coprocess_req_t *req;
+	int sv[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv)) {
+		log_message(LOG_INFO, "Unable to create socket pair for persistent script %s - errno %d (%m)", cp->script->args[0], errno);
+		return false;
+	}
+
+	/* Only our end is non-blocking, the helper can use simple blocking I/O */
+	if (fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK) == -1 ||
+	    (pid = system_call_coprocess(cp->script, sv[1])) == -1) {
+		close(sv[0]);
+		close(sv[1]);
+		return false;
+	}
+	close(sv[1]);
+
+	cp->pid = pid;
+	cp->fd = sv[0];
+	cp->starts++;
+
+	thread_add_child(cp->master, coprocess_child_thread, cp, pid, TIMER_NEVER);
+	cp->read_thread = thread_add_read(cp->master, coprocess_read_thread, cp, cp->fd, TIMER_NEVER, 0);
+
+	if (cp->starts > 1)
+		log_message(LOG_INFO, "Persistent script %s restarted with pid %d", cp->script->args[0], pid);
+
+	/* Send any requests queued while the helper was being restarted */
+	list_for_each_entry(req, &cp->requests, e_list)
+		coprocess_send(cp, req);
+
+	return true;
+}
+
+static void
+coprocess_reply(coprocess_t *cp, const char *line)
+{
+	coprocess_req_t *req;
+	unsigned id, code;
+	const char *p;
+	char *endptr;
+
+	id = (unsigned)strtoul(line, &endptr, 10);
+	if (endptr == line || *endptr != ' ')
+		goto bad_reply;
+	p = endptr + 1;
+	code = (unsigned)strtoul(p, &endptr, 10);
+	if (endptr == p || *endptr || code > 255)
+		goto bad_reply;
+
+	cp->last_reply = time_now;
+
+	list_for_each_entry(req, &cp->requests, e_list) {
+		if (req->id == id) {
+			coprocess_complete(req, W_EXITCODE(code, 0), false);
+			return;
+		}
+	}
+
+	log_message(LOG_INFO, "Persistent script %s replied to unknown request %u", cp->script->args[0], id);
+	return;
+
+  bad_reply:
+	log_message(LOG_INFO, "Persistent script %s sent invalid reply '%s'", cp->script->args[0], line);
+}
+
+static void
+coprocess_read_thread(thread_ref_t thread)
+{
+	coprocess_t *cp = THREAD_ARG(thread);
+	char *line, *nl;
+	ssize_t len;
+
+	cp->read_thread = NULL;
+
+	if (thread->type == THREAD_READ_ERROR) {
+		log_message(LOG_INFO, "Persistent script %s (pid %d) closed its connection", cp->script->args[0], cp->pid);
+		coprocess_lost(thread, cp);
+		return;
+	}
+
+	len = read(cp->fd, cp->rbuf + cp->rbuf_len, sizeof(cp->rbuf) - cp->rbuf_len - 1);
+	if (len == -1 && (errno == EAGAIN || errno == EINTR)) {
+		cp->read_thread = thread_add_read(thread->master, coprocess_read_thread, cp, cp->fd, TIMER_NEVER, 0);
+		return;
+	}
+
+	if (len <= 0) {
+		/* The helper has closed its stdout, or the socket has failed. If it
+		 * is still running it can no longer reply, so restart it. If it is
+		 * exiting anyway, the kill is harmless. */
+		if (len == -1)
+			log_message(LOG_INFO, "Persistent script %s (pid %d) read error %d - %m", cp->script->args[0], cp->pid, errno);
+		else
+			log_message(LOG_INFO, "Persistent script %s (pid %d) closed its connection", cp->script->args[0], cp->pid);
+		coprocess_lost(thread, cp);
+		return;
+	}
+
+	cp->rbuf_len += (size_t)len;
+	cp->rbuf[cp->rbuf_len] = '\0';
+
+	line = cp->rbuf;
+	while ((nl = strchr(line, '\n'))) {
+		*nl = '\0';
+		coprocess_reply(cp, line);
+		line = nl + 1;
+	}
+
+	cp->rbuf_len -= (size_t)(line - cp->rbuf);
+	if (cp->rbuf_len == sizeof(cp->rbuf) - 1) {
+		log_message(LOG_INFO, "Persistent script %s reply too long - discarding", cp->script->args[0]);
+		cp->rbuf_len = 0;
+	} else
+		memmove(cp->rbuf, line, cp->rbuf_len);
+
+	cp->read_thread = thread_add_read(thread->master, coprocess_read_thread, cp, cp->fd, TIMER_NEVER, 0);
+}
+
+static void
+coprocess_write_thread(thread_ref_t thread)
+{
+	coprocess_t *cp = THREAD_ARG(thread);
+
+	cp->write_thread = NULL;
+
+	if (thread->type == THREAD_WRITE_ERROR) {
+		cp->wbuf_len = 0;
+		return;
+	}
+
+	coprocess_flush(cp);
+}
+
+static void
+coprocess_child_thread(thread_ref_t thread)
+{
+	coprocess_t *cp = THREAD_ARG(thread);
+	int status = THREAD_CHILD_STATUS(thread);
+	coprocess_req_t *req;
+
+	cp->pid = 0;
+	coprocess_close(cp);
+
+	list_for_each_entry(req, &cp->requests, e_list)
+		req->sent = false;
+
+	if (cp->killed && WIFSIGNALED(status)) {
+		/* We killed it after a timeout or losing its stdout (it may die
+		 * of SIGPIPE first). Give the other requests a new helper. If it
+		 * exited by itself before the kill took effect, that is reported
+		 * below instead. */
+		cp->killed = false;
+		if (list_empty(&cp->requests) || coprocess_start(cp))
+			return;
+
+		status = W_EXITCODE(1, 0);
+	} else {
+		cp->killed = false;
+
+		if (WIFSIGNALED(status))
+			log_message(LOG_INFO, "Persistent script %s (pid %d) terminated by signal %d", cp->script->args[0], THREAD_CHILD_PID(thread), WTERMSIG(status));
+		else
+			log_message(LOG_INFO, "Persistent script %s (pid %d) exited with status %d", cp->script->args[0], THREAD_CHILD_PID(thread), WEXITSTATUS(status));
+
+		/* A helper that exits without replying has not passed the check */
+		if (WIFEXITED(status) && !WEXITSTATUS(status))
+			status = W_EXITCODE(1, 0);
+	}
+
+	/* It will be restarted by the next request */
+	coprocess_fail_all(cp, status);
+}
+
+static void
+coprocess_timeout_thread(thread_ref_t thread)
+{
+	coprocess_req_t *req = THREAD_ARG(thread);
+	coprocess_t *cp = req->cp;
+
+	req->timer_thread = NULL;
+
+	/* If the helper is still replying to other requests, only this check fails */
+	if (req->sent && cp->pid && !cp->killed &&
+	    timercmp(&cp->last_reply, &req->sent_time, <)) {
+		log_message(LOG_INFO, "Persistent script %s (pid %d) timed out - restarting", cp->script->args[0], cp->pid);
+
+		coprocess_kill(cp);
+	}
+
+	coprocess_complete(req, W_EXITCODE(0, SIGKILL), true);
+}
+
+/* Returns false if the helper could not be started, in which case func will not be called */
+bool
+coprocess_request(thread_master_t *m, coprocess_req_t *req, const notify_script_t *script,
+		  unsigned long timeout, coprocess_func_t func, void *arg)
+{
+	coprocess_t *cp;
+
+	if (!(cp = find_coprocess(script))) {
+		PMALLOC(cp);
+		cp->master = m;
+		cp->script = script;
+		cp->fd = -1;
+		INIT_LIST_HEAD(&cp->requests);
+		list_add_tail(&cp->e_list, &coprocesses);
+	}
+
+	if (!cp->pid && !coprocess_start(cp))
+		return false;
+
+	req->cp = cp;
+	req->script = script;
+	req->id = cp->next_id++;
+	req->sent = false;
+	req->func = func;
+	req->arg = arg;
+	list_add_tail(&req->e_list, &cp->requests);
+	req->timer_thread = thread_add_timer(m, coprocess_timeout_thread, req, timeout);
+
+	/* If the helper is being restarted the request will be sent when it has started */
+	if (cp->fd != -1)
+		coprocess_send(cp, req);
+
+	return true;
+}
+
+void
+dump_coprocess_req(FILE *fp, const coprocess_req_t *req)
+{
+	const coprocess_t *cp;
+
+	if (!req->script || !(cp = find_coprocess(req->script)))
+		return;
+
+	conf_write(fp, "   Persistent script pid = %d, started %u time%s", cp->pid, cp->starts, cp->starts == 1 ? "" : "s");
+}
+
+/* Called on reload and termination, after script_killall() has signalled the helpers */
+void
+coprocess_release(void)
+{
+	coprocess_t *cp, *cp_tmp;
+	coprocess_req_t *req, *req_tmp;
+
+	list_for_each_entry_safe(cp, cp_tmp, &coprocesses, e_list) {
+		coprocess_close(cp);
+
+		list_for_each_entry_safe(req, req_tmp, &cp->requests, e_list) {
+			thread_cancel(req->timer_thread);
+			req->timer_thread = NULL;
+			req->cp = NULL;
+			list_del_init(&req->e_list);
+		}
+
+		list_del_init(&cp->e_list);
+		FREE_PTR(cp->wbuf);
+		FREE(cp);
+	}
+}
+
+#ifdef THREAD_DUMP
+void
+register_coprocess_addresses(void)
+{
+	register_thread_address("coprocess_read_thread", coprocess_read_thread);
+	register_thread_address("coprocess_write_thread", coprocess_write_thread);
+	register_thread_address("coprocess_child_thread", coprocess_child_thread);
+	register_thread_address("coprocess_timeout_thread", coprocess_timeout_thread);
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        coprocess.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2024 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _COPROCESS_H
+#define _COPROCESS_H
+
+/* system includes */
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* application includes */
+#include "scheduler.h"
+#include "notify.h"
+#include "list_head.h"
+#include "timer.h"
+
+/*
+ * A persistent script is started once and then sent one line per check on
+ * its stdin:
+ *	<id>[ <param>...]
+ * where the params are the script's configured parameters separated by single
+ * spaces. It replies on its stdout with one line per request:
+ *	<id> <exit code>
+ * Replies may be sent in any order. All scripts with the same executable,
+ * uid and gid share one helper process. If a request times out the check
+ * fails, and if the helper has not replied to anything since the request
+ * was sent, it is killed and restarted.
+ */
+#define COPROCESS_LINE_MAX	64	/* Longest reply line accepted */
+
+/* The result is passed as a wait(2) status. timed_out is set if no reply
+ * was received within the request's timeout. */
+typedef void (*coprocess_func_t)(void *, int, bool);
+
+typedef struct _coprocess {
+	thread_master_t		*master;
+	const notify_script_t	*script;	/* Executable, uid and gid of the helper */
+	pid_t			pid;		/* 0 if the helper is not running */
+	int			fd;		/* Our end of the helper's stdin/stdout */
+	bool			killed;		/* We killed the helper so it can be restarted */
+	thread_ref_t		read_thread;
+	thread_ref_t		write_thread;
+	char			*wbuf;		/* Requests not yet written */
+	size_t			wbuf_len;
+	size_t			wbuf_size;
+	char			rbuf[COPROCESS_LINE_MAX];
+	size_t			rbuf_len;
+	unsigned		next_id;
+	unsigned		starts;
+	timeval_t		last_reply;
+	list_head_t		requests;	/* coprocess_req_t - outstanding requests */
+
+	/* linked list member */
+	list_head_t		e_list;
+} coprocess_t;
+
+typedef struct _coprocess_req {
+	coprocess_t		*cp;		/* NULL unless the request is outstanding */
+	const notify_script_t	*script;
+	unsigned		id;
+	bool			sent;		/* Written to the current helper */
+	timeval_t		sent_time;
+	thread_ref_t		timer_thread;
+	coprocess_func_t	func;
+	void			*arg;
+
+	/* linked list member */
+	list_head_t		e_list;
+} coprocess_req_t;
+
+/* Prototypes */
+extern bool coprocess_script_valid(const notify_script_t *) __attribute__ ((pure));
+extern bool coprocess_request(thread_master_t *, coprocess_req_t *, const notify_script_t *, unsigned long, coprocess_func_t, void *);
+extern void dump_coprocess_req(FILE *, const coprocess_req_t *);
+extern void coprocess_release(void);
+#ifdef THREAD_DUMP
+extern void register_coprocess_addresses(void);
+#endif
+
+#endif
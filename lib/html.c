@@ -25,6 +25,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <strings.h>
 
 #include "html.h"
 #include "memory.h"
@@ -90,3 +91,60 @@ extract_html(const char *buffer, size_t size_buffer)
 			return cur + 4;
 	return NULL;
 }
+
+/*
+ * Return a pointer to the value of the named header, with its length in
+ * val_len. buffer must point to the status line, and size must not extend
+ * beyond the empty line ending the headers. Header names are not case
+ * sensitive (rfc7230.3.2).
+ */
+const char *
+extract_header(const char *buffer, size_t size, const char *name, size_t *val_len)
+{
+	const char *end = buffer + size;
+	size_t name_len = strlen(name);
+	const char *line;
+	const char *eol;
+	const char *val;
+
+	/* Skip the status line */
+	for (line = buffer; (eol = memmem(line, (size_t)(end - line), "\r\n", 2)) && eol != line; line = eol + 2) {
+		if (line == buffer ||
+		    (size_t)(eol - line) <= name_len ||
+		    line[name_len] != ':' ||
+		    strncasecmp(line, name, name_len))
+			continue;
+
+		for (val = line + name_len + 1; val < eol && (*val == ' ' || *val == '\t'); val++);
+		while (eol > val && (eol[-1] == ' ' || eol[-1] == '\t'))
+			eol--;
+		*val_len = (size_t)(eol - val);
+
+		return val;
+	}
+
+	return NULL;
+}
+
+/* Check if a comma separated header value includes token */
+bool
+header_has_token(const char *val, size_t val_len, const char *token)
+{
+	const char *end = val + val_len;
+	size_t token_len = strlen(token);
+	const char *tok_end;
+
+	while (val < end) {
+		while (val < end && (*val == ' ' || *val == '\t' || *val == ','))
+			val++;
+		for (tok_end = val; tok_end < end && *tok_end != ','; tok_end++);
+		val_len = (size_t)(tok_end - val);
+		while (val_len && (val[val_len - 1] == ' ' || val[val_len - 1] == '\t'))
+			val_len--;
+		if (val_len == token_len && !strncasecmp(val, token, token_len))
+			return true;
+		val = tok_end;
+	}
+
+	return false;
+}
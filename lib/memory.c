@@ -885,3 +885,112 @@ openssl_mem_log_init(const char* prog_name, const char *banner)
 	atexit(openssl_free_final);
 }
 #endif
+
+/* Region (arena) allocator.
+ *
+ * The blocks of an arena form a list, newest first. Allocations are
+ * carved sequentially from the newest block, and a mark records the
+ * position in the arena so that everything allocated after it can be
+ * released in one go. The oldest block is retained on release so that
+ * an arena that is repeatedly used and released (e.g. per line of
+ * configuration) does not keep going back to malloc().
+ */
+struct _mem_arena_block {
+	mem_arena_block_t	*prev;		/* Next older block */
+	size_t			size;		/* Size of data[] */
+	size_t			used;
+	max_align_t		data[];
+};
+
+#define ARENA_ALIGN(n)	(((n) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+#ifdef _MEM_CHECK_
+void *
+arena_alloc_r(mem_arena_t *arena, size_t size, const char *file, const char *function, int line)
+#else
+void *
+arena_alloc_r(mem_arena_t *arena, size_t size)
+#endif
+{
+	mem_arena_block_t *block = arena->block;
+	size_t block_size;
+	void *ptr;
+
+	size = ARENA_ALIGN(size);
+
+	if (!block || block->size - block->used < size) {
+		/* Oversize requests get a block of their own */
+		block_size = size > arena->block_size ? size : arena->block_size;
+#ifdef _MEM_CHECK_
+		block = keepalived_malloc(sizeof(*block) + block_size, file, function, line);
+#else
+		block = MALLOC(sizeof(*block) + block_size);
+#endif
+		block->size = block_size;
+		block->prev = arena->block;
+		arena->block = block;
+	}
+
+	ptr = (char *)block->data + block->used;
+	block->used += size;
+
+	/* Match MALLOC, which always returns zeroed memory */
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+#ifdef _MEM_CHECK_
+char *
+arena_strndup_r(mem_arena_t *arena, const char *str, size_t size, const char *file, const char *function, int line)
+{
+	char *str_p = arena_alloc_r(arena, size + 1, file, function, line);
+#else
+char *
+arena_strndup_r(mem_arena_t *arena, const char *str, size_t size)
+{
+	char *str_p = arena_alloc_r(arena, size + 1);
+#endif
+
+	/* The allocated memory is zeroed, so the string will be terminated */
+	return strncpy(str_p, str, size);
+}
+
+mem_arena_mark_t
+arena_mark(const mem_arena_t *arena)
+{
+	mem_arena_mark_t mark = { .block = arena->block, .used = arena->block ? arena->block->used : 0 };
+
+	return mark;
+}
+
+void
+arena_release(mem_arena_t *arena, mem_arena_mark_t mark)
+{
+	mem_arena_block_t *block;
+
+	while ((block = arena->block) != mark.block) {
+		/* An empty mark keeps the oldest block for reuse */
+		if (!mark.block && !block->prev) {
+			block->used = 0;
+			return;
+		}
+
+		arena->block = block->prev;
+		FREE(block);
+	}
+
+	if (block)
+		block->used = mark.used;
+}
+
+void
+arena_free(mem_arena_t *arena)
+{
+	mem_arena_block_t *block;
+
+	while ((block = arena->block)) {
+		arena->block = block->prev;
+		FREE(block);
+	}
+}
@@ -150,6 +150,49 @@ extern void *zalloc(unsigned long size);
 
 #endif
 
+/* Region (arena) allocator. Many small allocations are carved out of
+ * larger blocks, and are released together, either back to a mark or
+ * all at once. Blocks are obtained via MALLOC, so are included in the
+ * MEM_CHECK accounting, attributed to the caller of ARENA_ALLOC. */
+typedef struct _mem_arena_block mem_arena_block_t;
+
+typedef struct _mem_arena {
+	mem_arena_block_t	*block;		/* Most recently allocated block */
+	size_t			block_size;	/* Size of data area of new blocks */
+} mem_arena_t;
+
+typedef struct _mem_arena_mark {
+	mem_arena_block_t	*block;
+	size_t			used;
+} mem_arena_mark_t;
+
+#define MEM_ARENA_INIT(size)	{ .block = NULL, .block_size = (size) }
+
+#ifdef _MEM_CHECK_
+#define ARENA_ALLOC(a,n)	(arena_alloc_r((a), (n), \
+				 (__FILE__), (__func__), (__LINE__)) )
+#define ARENA_STRNDUP(a,p,n)	(arena_strndup_r((a), (p), (n), \
+				 (__FILE__), (__func__), (__LINE__)) )
+#else
+#define ARENA_ALLOC(a,n)	(arena_alloc_r((a), (n)))
+#define ARENA_STRNDUP(a,p,n)	(arena_strndup_r((a), (p), (n)))
+#endif
+
+#ifdef _MEM_CHECK_
+extern void *arena_alloc_r(mem_arena_t *, size_t, const char *, const char *, int)
+		__attribute__((alloc_size(2))) __attribute__((malloc));
+extern char *arena_strndup_r(mem_arena_t *, const char *, size_t, const char *, const char *, int)
+		__attribute__((malloc)) __attribute__((nonnull (2)));
+#else
+extern void *arena_alloc_r(mem_arena_t *, size_t)
+		__attribute__((alloc_size(2))) __attribute__((malloc));
+extern char *arena_strndup_r(mem_arena_t *, const char *, size_t)
+		__attribute__((malloc)) __attribute__((nonnull (2)));
+#endif
+extern mem_arena_mark_t arena_mark(const mem_arena_t *) __attribute__((pure));
+extern void arena_release(mem_arena_t *, mem_arena_mark_t);
+extern void arena_free(mem_arena_t *);
+
 /* Common defines */
 typedef union _ptr_hack {
 	void *p;
@@ -163,6 +163,35 @@ cmd_str(const notify_script_t *script)
 	return cmd_str_r(script, cmd_str_buf, sizeof cmd_str_buf);
 }
 
+/* Common initialisation of a forked child that is to run a script */
+static void
+script_child_init(void)
+{
+	reset_process_priorities();
+
+#ifdef _MEM_CHECK_
+	skip_mem_dump();
+#endif
+}
+
+static void
+script_child_close_fds(void)
+{
+#ifdef HAVE_CLOSE_RANGE
+	 /* We don't want anything past stderr here. This is belt
+	  * and braces really, since all file desriptors should
+	  * have FD_CLOEXEC set. CLOSE_RANGE_CLOEXEC uses fewer
+	  * kernel resources that CLOSE_RANGE_UNSHARE. */
+	close_range(STDERR_FILENO + 1, ~0U,
+#if HAVE_DECL_CLOSE_RANGE_CLOEXEC
+			    CLOSE_RANGE_CLOEXEC
+#else
+			    CLOSE_RANGE_UNSHARE
+#endif
+					       );
+#endif
+}
+
 int
 system_call_script(thread_master_t *m, thread_func_t func, void * arg, unsigned long timer, const notify_script_t* script)
 {
@@ -199,25 +228,8 @@ system_call_script(thread_master_t *m, thread_func_t func, void * arg, unsigned
 	}
 
 	/* Child process */
-	reset_process_priorities();
-
-#ifdef _MEM_CHECK_
-	skip_mem_dump();
-#endif
-
-#ifdef HAVE_CLOSE_RANGE
-	 /* We don't want anything past stderr here. This is belt
-	  * and braces really, since all file desriptors should
-	  * have FD_CLOEXEC set. CLOSE_RANGE_CLOEXEC uses fewer
-	  * kernel resources that CLOSE_RANGE_UNSHARE. */
-	close_range(STDERR_FILENO + 1, ~0U,
-#if HAVE_DECL_CLOSE_RANGE_CLOEXEC
-			    CLOSE_RANGE_CLOEXEC
-#else
-			    CLOSE_RANGE_UNSHARE
-#endif
-					       );
-#endif
+	script_child_init();
+	script_child_close_fds();
 
 	if (set_script_env(script->uid, script->gid))
 		exit(0);
@@ -272,6 +284,62 @@ notify_exec(const notify_script_t *script)
 	return system_call_script(NULL, NULL, NULL, 0, script);
 }
 
+/* Start a persistent helper with its stdin and stdout connected to fd.
+ * The helper is run without the script's parameters, since they are
+ * sent to it with each request. Returns the pid of the helper, or -1. */
+pid_t
+system_call_coprocess(const notify_script_t *script, int fd)
+{
+	pid_t pid;
+	const char *argv[2];
+	union non_const_args args;
+
+#ifdef ENABLE_LOG_TO_FILE
+	if (log_file_name)
+		flush_log_file();
+#endif
+
+	pid = fork();
+
+	if (pid < 0) {
+		log_message(LOG_INFO, "Failed fork process");
+		return -1;
+	}
+
+	if (pid)
+		return pid;
+
+	/* Child process */
+	script_child_init();
+
+	if (set_script_env(script->uid, script->gid))
+		exit(127);
+
+	/* set_script_env() may have pointed stdin and stdout at /dev/null */
+	if (dup2(fd, STDIN_FILENO) == -1 || dup2(fd, STDOUT_FILENO) == -1) {
+		log_message(LOG_ALERT, "Unable to set up pipe for persistent script %s, error %d: %m", script->args[0], errno);
+		exit(127);
+	}
+
+	/* Only after the dup2()s, since without CLOSE_RANGE_CLOEXEC this
+	 * really closes fd */
+	script_child_close_fds();
+
+	setpgid(0, 0);
+
+	/* If keepalived dies, we want the helper to die */
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+	argv[0] = script->args[0];
+	argv[1] = NULL;
+	args.args = argv;
+	execve(script->path ? script->path : script->args[0], args.execve_args, environ);
+
+	log_message(LOG_ALERT, "Error exec-ing persistent script '%s', error %d: %m", script->path ? script->path : script->args[0], errno);
+
+	exit(127);
+}
+
 static void
 fifo_open(notify_fifo_t* fifo, thread_func_t script_exit, const char *type)
 {
@@ -98,6 +98,7 @@ extern void notify_fifo_open(notify_fifo_t*, notify_fifo_t*, thread_func_t, cons
 extern void notify_fifo_close(notify_fifo_t*, notify_fifo_t*);
 extern int system_call_script(thread_master_t *, thread_func_t, void *, unsigned long, const notify_script_t *);
 extern int notify_exec(const notify_script_t *);
+extern pid_t system_call_coprocess(const notify_script_t *, int);
 extern void child_killed_thread(thread_ref_t);
 extern void script_killall(thread_master_t *, int, bool);
 extern unsigned check_script_secure(notify_script_t *, magic_t);
@@ -233,6 +233,11 @@ static FILE *conf_copy;
 static bool write_conf_copy;
 static bool read_conf_copy;
 
+/* The strvecs for each line of the configuration are allocated from
+ * strvec_arena, which is released back to a mark after each line. */
+#define STRVEC_ARENA_SLOTS	8
+static mem_arena_t strvec_arena = MEM_ARENA_INIT(4 * MAXBUF);
+
 /* Parameter definitions */
 static LIST_HEAD_INITIALIZE(defs); /* def_t */
 
@@ -1219,8 +1224,42 @@ alloc_strvec_quoted(const char *src)
 	return alloc_strvec_quoted_escaped_common(src, false);
 }
 
-vector_t *
-alloc_strvec_r(const char *string, const vector_t *keywords_vec)
+/* Add a string to a strvec allocated from strvec_arena. The slot array
+ * cannot be REALLOC'd, so it is allocated in powers of 2 (minimum
+ * STRVEC_ARENA_SLOTS) and copied when it is full. */
+static void
+strvec_arena_add_slot(vector_t *strvec, char *str)
+{
+	void **slot;
+
+	if (!strvec->allocated ||
+	    (strvec->allocated >= STRVEC_ARENA_SLOTS && !(strvec->allocated & (strvec->allocated - 1)))) {
+		slot = ARENA_ALLOC(&strvec_arena, sizeof(void *) * (strvec->allocated ? strvec->allocated * 2 : STRVEC_ARENA_SLOTS));
+		if (strvec->allocated)
+			memcpy(slot, strvec->slot, sizeof(void *) * strvec->allocated);
+		strvec->slot = slot;
+	}
+
+	strvec->slot[strvec->allocated++] = str;
+	strvec->active = strvec->allocated;
+}
+
+/* Remove a slot from a strvec allocated from strvec_arena. The strvec
+ * has no empty slots, so it just needs closing up. */
+static void
+strvec_arena_remove_slot(vector_t *strvec, unsigned slot)
+{
+	if (slot >= strvec->allocated)
+		return;
+
+	memmove(&strvec->slot[slot], &strvec->slot[slot + 1], sizeof(void *) * (strvec->allocated - slot - 1));
+	strvec->active = --strvec->allocated;
+}
+
+/* The returned strvec is only valid until strvec_arena is released to a
+ * mark taken before the call. */
+static vector_t *
+alloc_strvec_arena(const char *string, const vector_t *keywords_vec)
 {
 	const char *cp, *start;
 	size_t str_len;
@@ -1234,7 +1273,7 @@ alloc_strvec_r(const char *string, const vector_t *keywords_vec)
 		return NULL;
 
 	/* Create a vector and alloc each command piece */
-	strvec = vector_alloc();
+	strvec = ARENA_ALLOC(&strvec_arena, sizeof(*strvec));
 
 	cp = string;
 	while (true) {
@@ -1278,14 +1317,11 @@ alloc_strvec_r(const char *string, const vector_t *keywords_vec)
 		}
 
 		/* Alloc & set the slot */
-		vector_alloc_slot(strvec);
-		vector_set_slot(strvec, STRNDUP(start, str_len));
+		strvec_arena_add_slot(strvec, ARENA_STRNDUP(&strvec_arena, start, str_len));
 	}
 
-	if (!vector_size(strvec)) {
-		free_strvec(strvec);
+	if (!vector_size(strvec))
 		return NULL;
-	}
 
 	return strvec;
 }
@@ -2973,6 +3009,7 @@ alloc_value_block(void (*alloc_func) (const vector_t *), const vector_t *strvec)
 	vector_t *first_vec = NULL;
 	bool need_bob = true;
 	bool had_eob = false;
+	mem_arena_mark_t mark = arena_mark(&strvec_arena);
 
 	if (vector_active(strvec) > 1) {
 		if (!strcmp(strvec_slot(strvec, 1), BOB)) {
@@ -2994,9 +3031,11 @@ alloc_value_block(void (*alloc_func) (const vector_t *), const vector_t *strvec)
 
 	buf = (char *)MALLOC(MAXBUF);
 	while (first_vec || read_line(buf, MAXBUF)) {
+		arena_release(&strvec_arena, mark);
+
 		if (first_vec)
 			vec = first_vec;
-		else if (!(vec = alloc_strvec(buf, NULL)))
+		else if (!(vec = alloc_strvec_arena(buf, NULL)))
 			continue;
 
 		if (!first_vec) {
@@ -3004,13 +3043,11 @@ alloc_value_block(void (*alloc_func) (const vector_t *), const vector_t *strvec)
 				need_bob = false;
 
 				if (!strcmp(vector_slot(vec, 0), BOB)) {
-					if (vector_size(vec) == 1) {
-						free_strvec(vec);
+					if (vector_size(vec) == 1)
 						continue;
-					}
 
 					/* Remove the BOB */
-					vec = strvec_remove_slot(vec, 0);
+					strvec_arena_remove_slot(vec, 0);
 				} else
 					log_message(LOG_INFO, "'%s' missing from beginning of block %s", BOB, strvec_slot(strvec, 0));
 			}
@@ -3018,13 +3055,11 @@ alloc_value_block(void (*alloc_func) (const vector_t *), const vector_t *strvec)
 			/* Check if line read ends with EOB */
 			str = vector_slot(vec, vector_active(vec) - 1);
 			if (!strcmp(str, EOB)) {
-				if (vector_active(vec) == 1) {
-					free_strvec(vec);
+				if (vector_active(vec) == 1)
 					break;
-				}
 
 				had_eob = true;
-				vec = strvec_remove_slot(vec, vector_active(vec) - 1);
+				strvec_arena_remove_slot(vec, vector_active(vec) - 1);
 			}
 		}
 
@@ -3034,13 +3069,13 @@ alloc_value_block(void (*alloc_func) (const vector_t *), const vector_t *strvec)
 		if (first_vec) {
 			vector_free(first_vec);
 			first_vec = NULL;
-		} else
-			free_strvec(vec);
+		}
 
 		if (had_eob)
 			break;
 	}
 
+	arena_release(&strvec_arena, mark);
 	FREE(buf);
 }
 
@@ -3057,10 +3092,15 @@ process_stream(vector_t *keywords_vec, int need_bob)
 	int bob_needed = 0;
 	bool ret_err = false;
 	bool ret;
+	mem_arena_mark_t mark = arena_mark(&strvec_arena);
 
 	buf = MALLOC(MAXBUF);
 	while (read_line(buf, MAXBUF)) {
-		strvec = alloc_strvec(buf, keywords_vec);
+		/* Release the previous line's strvec, and anything allocated
+		 * while processing it */
+		arena_release(&strvec_arena, mark);
+
+		strvec = alloc_strvec_arena(buf, keywords_vec);
 
 		if (!strvec)
 			continue;
@@ -3073,7 +3113,6 @@ process_stream(vector_t *keywords_vec, int need_bob)
 				/* We've got the opening '{' now */
 				skip_sublevel = 1;
 				need_bob = 0;
-				free_strvec(strvec);
 				continue;
 			}
 
@@ -3096,18 +3135,15 @@ process_stream(vector_t *keywords_vec, int need_bob)
 			 * next level up of keywords. */
 			if (!strcmp(str, EOB) && skip_sublevel == 0 && kw_level > 0) {
 				ret_err = true;
-				free_strvec(strvec);
 				break;
 			}
 
-			free_strvec(strvec);
 			continue;
 		}
 
 		if (need_bob) {
 			need_bob = 0;
 			if (!strcmp(str, BOB) && kw_level > 0) {
-				free_strvec(strvec);
 				continue;
 			}
 			else
@@ -3115,14 +3151,11 @@ process_stream(vector_t *keywords_vec, int need_bob)
 		}
 		else if (!strcmp(str, BOB)) {
 			report_config_error(CONFIG_UNEXPECTED_BOB, "Unexpected '%s' - ignoring", BOB);
-			free_strvec(strvec);
 			continue;
 		}
 
-		if (!strcmp(str, EOB) && kw_level > 0) {
-			free_strvec(strvec);
+		if (!strcmp(str, EOB) && kw_level > 0)
 			break;
-		}
 
 		for (i = 0; i < vector_size(keywords_vec); i++) {
 			keyword_vec = vector_slot(keywords_vec, i);
@@ -3147,10 +3180,8 @@ process_stream(vector_t *keywords_vec, int need_bob)
 				 * does not have sub levels, but needs a '{' */
 				if (keyword_vec->sub) {
 					/* Remove a trailing '{' */
-					char *bob = vector_slot(strvec, vector_size(strvec)-1) ;
-					if (!strcmp(bob, BOB)) {
+					if (!strcmp(vector_slot(strvec, vector_size(strvec)-1), BOB)) {
 						vector_unset(strvec, vector_size(strvec)-1);
-						FREE(bob);
 						bob_needed = 0;
 					}
 					else
@@ -3186,10 +3217,9 @@ process_stream(vector_t *keywords_vec, int need_bob)
 
 		if (i >= vector_size(keywords_vec))
 			report_config_error(CONFIG_UNKNOWN_KEYWORD, "Unknown keyword '%s'", str);
-
-		free_strvec(strvec);
 	}
 
+	arena_release(&strvec_arena, mark);
 	current_keywords = prev_keywords;
 	FREE(buf);
 	return ret_err;
@@ -3345,6 +3375,7 @@ init_data(const char *conf_file, const vector_t * (*init_keywords) (void), bool
 
 	free_keywords(keywords);
 	free_parser_data();
+	arena_free(&strvec_arena);
 
 	notify_resource_release();
 }
@@ -112,13 +112,9 @@ set_value_r(const vector_t *strvec)
 }
 
 #ifdef _MEM_CHECK_
-#define alloc_strvec(str, keyw)	(memcheck_log("alloc_strvec", str, (__FILE__), (__func__), (__LINE__)), \
-				 alloc_strvec_r(str, keyw))
-
 #define set_value(str)		(memcheck_log("set_value", strvec_slot(str,1), (__FILE__), (__func__), (__LINE__)), \
 				 set_value_r(str))
 #else
-#define alloc_strvec(str, keyw)	(alloc_strvec_r(str, keyw))
 #define set_value(str)		(set_value_r(str))
 #endif
 
@@ -148,7 +144,6 @@ extern void install_keyword(const char *, void (*handler) (const vector_t *));
 extern void install_keyword_quoted(const char *, void (*handler) (const vector_t *));
 extern const vector_t *alloc_strvec_quoted_escaped(const char *);
 extern const vector_t *alloc_strvec_quoted(const char *);
-extern vector_t *alloc_strvec_r(const char *, const vector_t *);
 extern bool check_conf_file(const char*);
 extern const vector_t *read_value_block(const vector_t *);
 extern void alloc_value_block(void (*alloc_func) (const vector_t *), const vector_t *);
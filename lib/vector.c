@@ -372,18 +372,6 @@ free_strvec(const vector_t *strvec)
 	vector_free(strvec);
 }
 
-vector_t *
-strvec_remove_slot(vector_t *strvec, unsigned slot)
-{
-	if (slot > strvec->allocated || !strvec->slot[slot])
-		return strvec;
-
-	FREE(strvec->slot[slot]);
-	vector_unset(strvec, slot);
-
-	return vector_compact_r(strvec);
-}
-
 #ifdef _INCLUDE_UNUSED_CODE_
 /* dump vector slots */
 void
@@ -83,6 +83,5 @@ extern void vector_dump(FILE *, const vector_t *);
 #endif
 extern char *make_strvec_str(const vector_t *, unsigned);
 extern void free_strvec(const vector_t *);
-extern vector_t *strvec_remove_slot(vector_t *, unsigned);
 
 #endif